@@ -0,0 +1,91 @@
+/*
+    指标的开销
+
+    1. 单次操作：计数器加一、直方图记录、MetricTimer（两次读时钟 + 记录）的耗时；
+    2. 请求路径：解析一个 GET 请求并生成静态文件的响应头，分别在指标开启和关闭时测量，计算相对开销。
+    用法：在项目根目录运行 ./bin/metricsbench [循环次数]（需要 resources 目录）
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <chrono>
+
+#include "../metrics/metrics.h"
+#include "../http/httprequest.h"
+#include "../http/httpresponse.h"
+
+using namespace std;
+
+static double nsPerOp(chrono::steady_clock::time_point start, size_t n)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+}
+
+// 解析 + 生成响应，模拟一次静态资源请求（不包括网络读写）
+static double requestPath(const string& srcDir, size_t n)
+{
+    const string raw = "GET /index.html HTTP/1.1\r\nHost: localhost:8081\r\n"
+                       "User-Agent: bench\r\nAccept: */*\r\nConnection: keep-alive\r\n\r\n";
+    HttpRequest request;
+    HttpResponse response;
+    Buffer readBuffer, writeBuffer;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i ++)
+    {
+        readBuffer.append(raw);
+        request.init();
+        {
+            MetricTimer timer(HIST_PARSE);
+            request.parse(readBuffer);
+        }
+        Metrics::add(CNT_REQUEST);
+        response.init(srcDir.c_str(), request.getPath(), request.isKeepAlive(), 200);
+        response.makeResponse(writeBuffer);
+        Metrics::add(CNT_BYTES_WRITTEN, writeBuffer.readableBytes() + response.getFileLen());
+        writeBuffer.retrieveAll();
+        response.unmapFile();
+    }
+    return nsPerOp(start, n);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 20000;
+    const size_t OPS = 10000000;
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < OPS; i ++) Metrics::add(CNT_REQUEST);
+    printf("counter add:      %6.1f ns/op\n", nsPerOp(start, OPS));
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < OPS; i ++) Metrics::record(HIST_PARSE, i & 0xfffff);
+    printf("histogram record: %6.1f ns/op\n", nsPerOp(start, OPS));
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < OPS; i ++) { MetricTimer timer(HIST_WRITE); }
+    printf("metric timer:     %6.1f ns/op\n", nsPerOp(start, OPS));
+
+    char cwd[256];
+    if (!getcwd(cwd, sizeof(cwd))) return 1;
+    string srcDir = string(cwd) + "/resources/";
+    if (access((srcDir + "index.html").c_str(), R_OK) < 0)
+    {
+        printf("resources/index.html not found, run from the project root\n");
+        return 1;
+    }
+
+    // 预热一轮，之后交替测量，各取最小值，减小频率变化和调度的影响
+    requestPath(srcDir, n);
+    double on = 1e18, off = 1e18;
+    for (int round = 0; round < 5; round ++)
+    {
+        Metrics::enabled = false;
+        off = min(off, requestPath(srcDir, n));
+        Metrics::enabled = true;
+        on = min(on, requestPath(srcDir, n));
+    }
+    printf("request path: metrics on %.0f ns/op, off %.0f ns/op, overhead %.2f%%\n",
+           on, off, (on - off) / off * 100);
+    return 0;
+}
@@ -0,0 +1,517 @@
+/*
+    热点路径的微基准测试
+
+    覆盖 Buffer（append / readFd / makeSpace）、HttpRequest::parse、HttpResponse::makeResponse、
+    ConnTable（普通页与透明大页的随机访问）、HeapTimer（add / adjust / tick）、
+    BlockQueue（多生产者竞争）、ThreadPool（addTask 的分发延迟），以及 locker.h 的锁
+    （与直接使用 pthread 对比：无竞争加锁、多线程竞争、按连接池的方式取还连接）。
+
+    每项先预热一轮，再测量 5 轮取最快的一轮，输出每次操作的耗时（ns/op）和内存分配次数、字节数
+    （allocs/op、bytes/op）。分配次数通过替换全局 operator new 统计，包括其他线程的分配，
+    多线程的测试项也能看到队列、任务对象的分配。
+
+    用法：./bin/microbench [名称过滤]，只运行名称中包含过滤字符串的测试项，例如 ./bin/microbench timer
+    配合 perf stat 查看 dTLB 缺失：perf stat -e dTLB-loads,dTLB-load-misses ./bin/microbench "conntable/random (4K"
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <deque>
+#include <pthread.h>
+
+#include "../buffer/buffer.h"
+#include "../http/httprequest.h"
+#include "../http/httpresponse.h"
+#include "../server/conntable.h"
+#include "../timer/heaptimer.h"
+#include "../log/blockqueue.h"
+#include "../threadPool/threadpool.h"
+
+using namespace std;
+
+// 全局分配计数（所有线程）
+// 替换的 operator new/delete 本身就是 malloc/free，内联后 GCC 会误报不匹配
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+static atomic<uint64_t> allocCount(0);
+static atomic<uint64_t> allocBytes(0);
+
+void* operator new(size_t size)
+{
+    allocCount.fetch_add(1, memory_order_relaxed);
+    allocBytes.fetch_add(size, memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static uint64_t nowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 测试项：run(n) 执行 n 次操作，返回 false 表示出错
+struct Bench
+{
+    const char* name;
+    size_t ops;
+    function<bool(size_t)> run;
+};
+
+static void runBench(const Bench& bench)
+{
+    if (!bench.run(bench.ops / 10 + 1))
+    {
+        printf("%-36s failed\n", bench.name);
+        return;
+    }
+    double best = 1e18, allocs = 0, bytes = 0;
+    for (int round = 0; round < 5; round ++)
+    {
+        uint64_t count = allocCount.load(), size = allocBytes.load();
+        uint64_t start = nowNs();
+        bench.run(bench.ops);
+        double ns = (double)(nowNs() - start) / bench.ops;
+        if (ns < best)
+        {
+            best = ns;
+            allocs = (double)(allocCount.load() - count) / bench.ops;
+            bytes = (double)(allocBytes.load() - size) / bench.ops;
+        }
+    }
+    printf("%-36s %10.1f %10.2f %10.1f\n", bench.name, best, allocs, bytes);
+    fflush(stdout);
+}
+
+/* ---------------- Buffer ---------------- */
+
+// 追加 64 字节，每 64 次读空一次：常见的小块写入，不触发扩容
+static bool bufferAppend(size_t n)
+{
+    static const string chunk(64, 'x');
+    Buffer buffer;
+    for (size_t i = 0; i < n; i ++)
+    {
+        buffer.append(chunk);
+        if ((i & 63) == 63) buffer.retrieveAll();
+    }
+    return true;
+}
+
+// 从 1KB 的新缓冲区追加到 64KB：makeSpace 的扩容路径
+static bool bufferGrow(size_t n)
+{
+    static const string chunk(1024, 'x');
+    for (size_t i = 0; i < n; i ++)
+    {
+        Buffer buffer;
+        for (int k = 0; k < 64; k ++) buffer.append(chunk);
+    }
+    return true;
+}
+
+// 读走一部分后再追加：makeSpace 把未读数据移到头部，不扩容
+static bool bufferCompact(size_t n)
+{
+    static const string chunk(384, 'x');
+    Buffer buffer(1024);
+    buffer.append(chunk);
+    for (size_t i = 0; i < n; i ++)
+    {
+        buffer.append(chunk);
+        buffer.retrieve(chunk.size());
+    }
+    return true;
+}
+
+// 从管道读 4KB（包括向管道写入的一次 write）
+static bool bufferReadFd(size_t n)
+{
+    int fds[2];
+    if (pipe(fds) < 0) return false;
+    char data[4096];
+    memset(data, 'x', sizeof(data));
+    Buffer buffer;
+    bool ok = true;
+    for (size_t i = 0; i < n && ok; i ++)
+    {
+        int err = 0;
+        ok = write(fds[1], data, sizeof(data)) == (ssize_t)sizeof(data) &&
+             buffer.readFd(fds[0], &err) == (ssize_t)sizeof(data);
+        buffer.retrieveAll();
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return ok;
+}
+
+/* ---------------- HttpRequest ---------------- */
+
+static const string GET_SIMPLE =
+    "GET /index.html HTTP/1.1\r\nHost: localhost:8081\r\nConnection: keep-alive\r\n\r\n";
+
+static const string GET_BROWSER =
+    "GET /images/profile-image.jpg HTTP/1.1\r\n"
+    "Host: localhost:8081\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Referer: http://localhost:8081/picture.html\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Pragma: no-cache\r\n"
+    "Sec-Fetch-Dest: image\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n\r\n";
+
+static const string POST_LOGIN =
+    "POST /login HTTP/1.1\r\nHost: localhost:8081\r\nConnection: keep-alive\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: 33\r\n\r\n"
+    "username=someone&password=secret1";
+
+static bool parseRequest(const string& raw, size_t n)
+{
+    HttpRequest request;
+    Buffer buffer;
+    bool ok = true;
+    for (size_t i = 0; i < n; i ++)
+    {
+        buffer.append(raw);
+        request.init();
+        ok &= request.parse(buffer) == GET_REQUEST;
+        buffer.retrieveAll();
+    }
+    return ok;
+}
+
+// 解析 + 生成静态文件的响应头（资源目录为当前目录下的 resources，不存在时生成 404 响应）
+static bool respondRequest(const string& raw, size_t n)
+{
+    static char srcDir[256];
+    if (!srcDir[0] && getcwd(srcDir, sizeof(srcDir) - 16)) strcat(srcDir, "/resources/");
+    HttpRequest request;
+    HttpResponse response;
+    Buffer readBuffer, writeBuffer;
+    bool ok = true;
+    for (size_t i = 0; i < n; i ++)
+    {
+        readBuffer.append(raw);
+        request.init();
+        ok &= request.parse(readBuffer) == GET_REQUEST;
+        response.init(srcDir, request.getPath(), request.isKeepAlive(), 200);
+        response.makeResponse(writeBuffer);
+        writeBuffer.retrieveAll();
+        response.unmapFile();
+    }
+    return ok;
+}
+
+/* ---------------- ConnTable ---------------- */
+
+static const int TABLE_CONNS = 32768;
+
+// 主线程按事件随机访问大量连接：每次读取一个连接的描述符、长连接标志和待写字节数
+static bool connTableRandom(HUGE_PAGE_MODE mode, size_t n)
+{
+    // 每种页只构造一次（约 30MB 连接表），之后各轮只计时访问
+    static ConnTable tables[3];
+    static bool ready[3];
+    ConnTable& table = tables[mode];
+    if (!ready[mode])
+    {
+        HUGE_PAGE_MODE used = mode;
+        if (!table.init(TABLE_CONNS, used, false) || used != mode) return false;
+        for (int fd = 0; fd < TABLE_CONNS; fd ++) table[fd];
+        ready[mode] = true;
+    }
+    // 下一个连接依赖这次读到的值，访问不能重叠，测到的是每次访问的延迟（含 dTLB 缺失）
+    uint32_t x = 12345;
+    for (size_t i = 0; i < n; i ++)
+    {
+        HttpConnect& conn = table[x % TABLE_CONNS];
+        x = x * 1664525 + 1013904223 + conn.getFd() + conn.isKeepAlive() + conn.toWriteBytes();
+    }
+    return x != 1;
+}
+
+/* ---------------- HeapTimer ---------------- */
+
+static const int TIMER_NUM = 100000;
+
+// 向空堆加入 10 万个随机到期时间的定时器，计时包括 clear
+static bool timerAdd(size_t n)
+{
+    mt19937 rng(1);
+    HeapTimer timer;
+    for (size_t i = 0; i < n; i ++)
+    {
+        if (i % TIMER_NUM == 0) timer.clear();
+        timer.add(i % TIMER_NUM, 60000 + rng() % 60000, [] {});
+    }
+    return true;
+}
+
+// 10 万个定时器中随机调整一个（连接收到请求后延长超时）
+static bool timerAdjust(size_t n)
+{
+    mt19937 rng(2);
+    HeapTimer timer;
+    for (int i = 0; i < TIMER_NUM; i ++) timer.add(i, 60000 + rng() % 60000, [] {});
+    for (size_t i = 0; i < n; i ++)
+    {
+        timer.adjust(rng() % TIMER_NUM, 60000 + rng() % 60000);
+    }
+    return timer.size() == (size_t)TIMER_NUM;
+}
+
+// 到期处理：加入已经到期的定时器，tick 逐个弹出并执行回调，每次操作是一个到期的定时器
+static bool timerTick(size_t n)
+{
+    HeapTimer timer;
+    size_t fired = 0;
+    for (size_t done = 0; done < n; )
+    {
+        size_t batch = min<size_t>(TIMER_NUM, n - done);
+        for (size_t i = 0; i < batch; i ++) timer.add(i, 0, [&fired] { fired ++; });
+        timer.tick();
+        done += batch;
+    }
+    return fired == n && timer.size() == 0;
+}
+
+/* ---------------- BlockQueue ---------------- */
+
+// producers 个线程写入，一个线程读出，每次操作是一个元素从写入到读出
+static bool blockQueue(int producers, size_t n)
+{
+    BlockQueue<string> queue(1024);
+    const string item(64, 'x');
+    size_t perProducer = n / producers;
+    vector<thread> threads;
+    for (int p = 0; p < producers; p ++)
+    {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < perProducer; i ++) queue.push(item);
+        });
+    }
+    string out;
+    size_t received = 0;
+    for (size_t total = perProducer * producers; received < total && queue.pop(out); received ++) {}
+    for (thread& t : threads) t.join();
+    return received == perProducer * producers;
+}
+
+/* ---------------- ThreadPool ---------------- */
+
+static ThreadPool* benchPool()
+{
+    static ThreadPool pool;
+    static bool inited = false;
+    if (!inited)
+    {
+        pool.init(4, 1 << 20);
+        inited = true;
+    }
+    return &pool;
+}
+
+// 吞吐：连续提交 n 个空任务，等全部执行完
+static bool poolThroughput(size_t n)
+{
+    ThreadPool* pool = benchPool();
+    atomic<size_t> done(0);
+    for (size_t i = 0; i < n; i ++)
+    {
+        pool->addTask([&done] { done.fetch_add(1, memory_order_release); });
+    }
+    while (done.load(memory_order_acquire) < n) this_thread::yield();
+    return true;
+}
+
+// 分发延迟：每次提交一个任务，等它开始执行后再提交下一个，记录提交到开始执行的时间
+static vector<uint64_t> dispatchLatency;
+
+static bool poolDispatch(size_t n)
+{
+    ThreadPool* pool = benchPool();
+    dispatchLatency.resize(n);
+    for (size_t i = 0; i < n; i ++)
+    {
+        atomic<bool> started(false);
+        uint64_t submit = nowNs();
+        pool->addTask([&started, &i, submit] {
+            dispatchLatency[i] = nowNs() - submit;
+            started.store(true, memory_order_release);
+        });
+        while (!started.load(memory_order_acquire)) this_thread::yield();
+    }
+    return true;
+}
+
+static void printDispatchPercentiles()
+{
+    if (dispatchLatency.empty()) return;
+    vector<uint64_t> sorted = dispatchLatency;
+    sort(sorted.begin(), sorted.end());
+    auto at = [&](double p) { return sorted[min(sorted.size() - 1, (size_t)(p * sorted.size()))] / 1000.0; };
+    printf("%-36s p50 %.1f us, p99 %.1f us, p99.9 %.1f us\n", "  threadpool dispatch latency",
+           at(0.5), at(0.99), at(0.999));
+}
+
+/* ---------------- 锁 ---------------- */
+
+// 对照组：直接使用 pthread，接口与 locker.h 相同
+class PthreadMutex
+{
+public:
+    PthreadMutex() { pthread_mutex_init(&m, nullptr); }
+    ~PthreadMutex() { pthread_mutex_destroy(&m); }
+    bool lock() { return pthread_mutex_lock(&m) == 0; }
+    bool unlock() { return pthread_mutex_unlock(&m) == 0; }
+    pthread_mutex_t m;
+};
+
+class PthreadCond
+{
+public:
+    PthreadCond() { pthread_cond_init(&c, nullptr); }
+    ~PthreadCond() { pthread_cond_destroy(&c); }
+    bool wait(PthreadMutex& m) { return pthread_cond_wait(&c, &m.m) == 0; }
+    bool signal() { return pthread_cond_signal(&c) == 0; }
+    pthread_cond_t c;
+};
+
+template<typename Mutex>
+static bool mutexUncontended(size_t n)
+{
+    // 进程中没有创建过线程时 glibc 的 pthread 锁省掉原子操作，与服务器的情况不符
+    thread([] {}).join();
+    static Mutex m;
+    static volatile size_t counter = 0;
+    for (size_t i = 0; i < n; i ++)
+    {
+        m.lock();
+        counter = counter + 1;
+        m.unlock();
+    }
+    return true;
+}
+
+// threads 个线程竞争同一个锁，临界区很短
+template<typename Mutex>
+static bool mutexContended(int threads, size_t n)
+{
+    static Mutex m;
+    static size_t counter = 0;
+    counter = 0;
+    vector<thread> workers;
+    for (int t = 0; t < threads; t ++)
+    {
+        workers.emplace_back([n, threads] {
+            for (size_t i = 0; i < n / threads; i ++)
+            {
+                m.lock();
+                counter ++;
+                m.unlock();
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    return counter == n / threads * threads;
+}
+
+// 与 SqlConnPool 相同的取还方式：互斥锁保护空闲队列，没有空闲连接时在条件变量上等待，归还后通知
+template<typename Mutex, typename Cond>
+static bool poolCheckout(int threads, int conns, size_t n)
+{
+    static Mutex m;
+    static Cond condFree;
+    static deque<int> freeConns;
+    freeConns.clear();
+    for (int i = 0; i < conns; i ++) freeConns.push_back(i);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t ++)
+    {
+        workers.emplace_back([n, threads] {
+            for (size_t i = 0; i < n / threads; i ++)
+            {
+                m.lock();
+                while (freeConns.empty()) condFree.wait(m);
+                int conn = freeConns.back();
+                freeConns.pop_back();
+                m.unlock();
+
+                m.lock();
+                freeConns.push_back(conn);
+                m.unlock();
+                condFree.signal();
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    return (int)freeConns.size() == conns;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+
+    vector<Bench> benches = {
+        {"buffer/append 64B",               2000000, bufferAppend},
+        {"buffer/grow 1KB->64KB",              5000, bufferGrow},
+        {"buffer/compact (makeSpace)",      2000000, bufferCompact},
+        {"buffer/readFd 4KB (incl. write)",  100000, bufferReadFd},
+        {"http/parse GET",                    10000, [](size_t n) { return parseRequest(GET_SIMPLE, n); }},
+        {"http/parse GET 12 headers",          5000, [](size_t n) { return parseRequest(GET_BROWSER, n); }},
+        {"http/parse POST login",             10000, [](size_t n) { return parseRequest(POST_LOGIN, n); }},
+        {"http/respond GET",                  10000, [](size_t n) { return respondRequest(GET_SIMPLE, n); }},
+        {"conntable/random (4K pages)",     2000000, [](size_t n) { return connTableRandom(HUGE_PAGE_OFF, n); }},
+        {"conntable/random (THP)",          2000000, [](size_t n) { return connTableRandom(HUGE_PAGE_THP, n); }},
+        {"timer/add (100k timers)",          500000, timerAdd},
+        {"timer/adjust (100k timers)",       500000, timerAdjust},
+        {"timer/tick (expire)",              500000, timerTick},
+        {"blockqueue/1 producer",            500000, [](size_t n) { return blockQueue(1, n); }},
+        {"blockqueue/4 producers",           500000, [](size_t n) { return blockQueue(4, n); }},
+        {"threadpool/addTask throughput",    500000, poolThroughput},
+        {"threadpool/dispatch (one by one)",  20000, poolDispatch},
+        {"locker/mutex uncontended",        5000000, mutexUncontended<mtx>},
+        {"locker/mutex uncontended (pthread)", 5000000, mutexUncontended<PthreadMutex>},
+        {"locker/mutex 4 threads",          2000000, [](size_t n) { return mutexContended<mtx>(4, n); }},
+        {"locker/mutex 4 threads (pthread)", 2000000, [](size_t n) { return mutexContended<PthreadMutex>(4, n); }},
+        {"locker/checkout 8 thr 4 conns",    500000, [](size_t n) { return poolCheckout<mtx, cond>(8, 4, n); }},
+        {"locker/checkout 8 thr 4 conns (pthread)", 500000,
+            [](size_t n) { return poolCheckout<PthreadMutex, PthreadCond>(8, 4, n); }},
+    };
+
+    printf("%-36s %10s %10s %10s\n", "benchmark", "ns/op", "allocs/op", "bytes/op");
+    for (const Bench& bench : benches)
+    {
+        if (!strstr(bench.name, filter)) continue;
+        runBench(bench);
+        if (strncmp(bench.name, "threadpool/dispatch", 19) == 0)
+        {
+            printDispatchPercentiles();
+        }
+    }
+    return 0;
+}
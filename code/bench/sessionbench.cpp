@@ -0,0 +1,70 @@
+/*
+    会话查找的吞吐量
+
+    创建 100 万个会话，然后用 1、2、4、8 个线程随机查找，输出每秒查找次数和平均耗时。
+    用法：./sessionbench [会话数] [每个线程的查找次数]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <random>
+
+#include "../session/sessionstore.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    size_t sessionCnt = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t lookupCnt = argc > 2 ? atol(argv[2]) : 2000000;
+
+    SessionStore* store = SessionStore::instance();
+    store->init(3600 * 1000, sessionCnt * 2);
+
+    auto start = chrono::steady_clock::now();
+    vector<string> sids(sessionCnt);
+    for (size_t i = 0; i < sessionCnt; i ++)
+    {
+        sids[i] = store->create("user" + to_string(i));
+    }
+    double createMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("create %zu sessions: %.0f ms (%.0f ns/op), live %zu\n",
+           sessionCnt, createMs, createMs * 1e6 / sessionCnt, store->size());
+
+    int maxThreads = thread::hardware_concurrency();
+    for (int threadCnt = 1; threadCnt <= 8; threadCnt *= 2)
+    {
+        if (threadCnt > 1 && threadCnt > maxThreads) break;
+        vector<thread> threads;
+        vector<size_t> hits(threadCnt);
+        start = chrono::steady_clock::now();
+        for (int t = 0; t < threadCnt; t ++)
+        {
+            threads.emplace_back([&, t] {
+                mt19937_64 rng(t + 1);
+                string user;
+                size_t hit = 0;
+                for (size_t i = 0; i < lookupCnt; i ++)
+                {
+                    hit += store->lookup(sids[rng() % sessionCnt], user);
+                }
+                hits[t] = hit;
+            });
+        }
+        for (thread& th : threads) th.join();
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        size_t total = lookupCnt * threadCnt, hit = 0;
+        for (size_t h : hits) hit += h;
+        printf("lookup threads %d: %.2f Mops/s, %.0f ns/op per thread, hit %zu/%zu\n",
+               threadCnt, total / sec / 1e6, sec * 1e9 / lookupCnt, hit, total);
+    }
+
+    start = chrono::steady_clock::now();
+    size_t expired = store->expire();
+    printf("expire sweep with no expired sessions: %.3f ms (%zu removed)\n",
+           chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(), expired);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+    用户存储后端的对比：LocalUserStore 与 MysqlUserStore
+
+    每个后端依次注册 N 个新用户、用正确的密码登录 N 次、用错误的密码登录 N 次，
+    多个线程平分请求，输出每秒操作数和单次操作的 p50/p99 延迟。
+    本地存储分别测试每次注册后落盘（fdatasync）和不落盘两种配置；
+    MySQL 存储只在传入数据库参数时测试（与服务器默认配置相同：布隆过滤器 + 合并插入），
+    注册的用户名带有进程号和时间戳，会留在 user 表中。
+
+    用法：./userstorebench [用户数] [线程数] [MySQL 主机 端口 用户名 密码 库名]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+
+#include "../userStore/localuserstore.h"
+#include "../userStore/mysqluserstore.h"
+
+using namespace std;
+
+// 多个线程平分 count 次操作，op(i) 返回是否得到预期的结果
+static void runPhase(const char* backend, const char* phase, size_t count, int threadCnt,
+                     const function<bool(size_t)>& op)
+{
+    vector<thread> threads;
+    vector<vector<double>> latencies(threadCnt);
+    vector<size_t> unexpected(threadCnt, 0);
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threadCnt; t ++)
+    {
+        threads.emplace_back([&, t] {
+            latencies[t].reserve(count / threadCnt + 1);
+            for (size_t i = t; i < count; i += threadCnt)
+            {
+                auto opStart = chrono::steady_clock::now();
+                if (!op(i)) unexpected[t] ++;
+                latencies[t].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - opStart).count());
+            }
+        });
+    }
+    for (thread& th : threads) th.join();
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> all;
+    size_t bad = 0;
+    for (int t = 0; t < threadCnt; t ++)
+    {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        bad += unexpected[t];
+    }
+    sort(all.begin(), all.end());
+    printf("%-18s %-14s %10.0f ops/s  p50 %8.1f us  p99 %8.1f us  unexpected %zu\n",
+           backend, phase, count / sec, all[all.size() / 2], all[all.size() * 99 / 100], bad);
+}
+
+static void runBackend(const char* backend, UserStore* store, const string& prefix, size_t userCnt, int threadCnt)
+{
+    auto name = [&](size_t i) { return prefix + to_string(i); };
+    runPhase(backend, "register", userCnt, threadCnt, [&](size_t i) {
+        return store->registerUser(name(i), "pwd" + to_string(i)) == VERIFY_SUCCESS;
+    });
+    // 随机顺序登录已注册的用户
+    runPhase(backend, "login", userCnt, threadCnt, [&](size_t i) {
+        size_t id = (i * 2654435761u) % userCnt;
+        return store->login(name(id), "pwd" + to_string(id)) == VERIFY_SUCCESS;
+    });
+    runPhase(backend, "login (wrong)", userCnt, threadCnt, [&](size_t i) {
+        size_t id = (i * 2654435761u) % userCnt;
+        return store->login(name(id), "wrong") == VERIFY_FAILED;
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    size_t userCnt = argc > 1 ? atol(argv[1]) : 20000;
+    int threadCnt = argc > 2 ? atoi(argv[2]) : 4;
+    if (userCnt == 0 || threadCnt <= 0)
+    {
+        fprintf(stderr, "usage: %s [users] [threads] [mysql_host port user password db]\n", argv[0]);
+        return 1;
+    }
+    string prefix = "bench_" + to_string(getpid()) + "_" + to_string(time(nullptr)) + "_";
+
+    for (bool sync : {true, false})
+    {
+        string path = "/tmp/userstorebench_" + to_string(getpid()) + ".db";
+        LocalUserStore store;
+        if (!store.open(path, sync))
+        {
+            fprintf(stderr, "cannot open %s\n", path.c_str());
+            return 1;
+        }
+        runBackend(sync ? "local (fdatasync)" : "local (no sync)", &store, prefix, userCnt, threadCnt);
+        store.close();
+        unlink(path.c_str());
+    }
+
+    if (argc > 7)
+    {
+        // 与服务器相同：每个线程一个连接，布隆过滤器，每批最多 32 行、最多等待 2ms 的合并插入
+        SqlConnPool::instance()->init(argv[3], atoi(argv[4]), argv[5], argv[6], argv[7], threadCnt);
+        SqlRouter::instance()->setPrimary("primary", SqlConnPool::instance());
+        {
+            MysqlUserStore store;
+            store.init(true, 32, 2);
+            runBackend("mysql", &store, prefix, userCnt, threadCnt);
+        }
+        SqlRouter::instance()->destroy();
+    }
+    else
+    {
+        printf("mysql: skipped (pass host port user password db to compare)\n");
+    }
+    return 0;
+}
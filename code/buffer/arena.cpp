@@ -0,0 +1,76 @@
+#include "arena.h"
+
+#include <new>
+
+using namespace std;
+
+Arena::Arena(size_t blockSize, size_t maxRetain):
+    head(nullptr), current(nullptr), cur(0), end(0),
+    blockSize(blockSize), maxRetain(maxRetain), totalSize(0)
+{
+}
+
+Arena::~Arena()
+{
+    while (head)
+    {
+        Block* next = head->next;
+        ::operator delete(head);
+        head = next;
+    }
+}
+
+void Arena::useBlock(Block* block)
+{
+    current = block;
+    cur = (uintptr_t)block->data();
+    end = cur + block->size;
+}
+
+// 当前块不够：依次尝试后面保留的块，都不够时申请新块（接在当前块之后）
+void* Arena::allocateSlow(size_t size, size_t align)
+{
+    while (current && current->next)
+    {
+        useBlock(current->next);
+        uintptr_t p = (cur + align - 1) & ~(uintptr_t)(align - 1);
+        if (p + size <= end)
+        {
+            cur = p + size;
+            return (void*)p;
+        }
+    }
+
+    size_t need = size + align;
+    size_t dataSize = need > blockSize ? need : blockSize;
+    Block* block = (Block*)::operator new(sizeof(Block) + dataSize);
+    block->size = dataSize;
+    block->next = nullptr;
+    totalSize += dataSize;
+    if (current) current->next = block;
+    else head = block;
+    useBlock(block);
+
+    uintptr_t p = (cur + align - 1) & ~(uintptr_t)(align - 1);
+    cur = p + size;
+    return (void*)p;
+}
+
+void Arena::reset()
+{
+    if (!head) return;
+    // 保留的总量超过 maxRetain 时，只保留第一个块（偶尔的大请求不长期占用内存）
+    if (totalSize > maxRetain)
+    {
+        Block* block = head->next;
+        while (block)
+        {
+            Block* next = block->next;
+            totalSize -= block->size;
+            ::operator delete(block);
+            block = next;
+        }
+        head->next = nullptr;
+    }
+    useBlock(head);
+}
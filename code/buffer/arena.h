@@ -0,0 +1,120 @@
+/*
+    单调分配的内存池（arena）
+
+    只分配不单独释放，reset() 时整体回收，用于生命周期相同的一组临时数据，
+    例如一个请求解析出的方法、路径、请求头和表单：请求结束后一起丢弃。
+    内存按块向全局堆申请，reset() 后保留（总量不超过 maxRetain），
+    之后的请求直接复用，稳定后每个请求不再向全局堆申请内存。
+
+    ArenaAllocator 是满足标准库要求的分配器，容器和字符串可以从 arena 分配：
+        ArenaString      字符串
+        ArenaStringMap   字符串到字符串的哈希表
+    分配器没有默认构造函数，必须绑定 arena（避免无意中回到全局堆）。
+
+    注意：reset() 之前，所有从 arena 分配的容器都必须已经析构或交换为空，
+    否则它们会继续引用被复用的内存（见 HttpRequest::init）。
+*/
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <functional>
+
+using namespace std;
+
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = 4096, size_t maxRetain = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(max_align_t))
+    {
+        uintptr_t p = (cur + align - 1) & ~(uintptr_t)(align - 1);
+        if (p + size <= end)
+        {
+            cur = p + size;
+            return (void*)p;
+        }
+        return allocateSlow(size, align);
+    }
+
+    // 回收所有分配，保留的块留给之后使用
+    void reset();
+
+    size_t capacity() const { return totalSize; } // 持有的块的总大小
+
+private:
+    struct Block
+    {
+        Block* next;
+        size_t size; // 可用的大小（不含块头）
+        char* data() { return (char*)(this + 1); }
+    };
+
+    void* allocateSlow(size_t size, size_t align);
+    void useBlock(Block* block);
+
+    Block* head;      // 第一个块
+    Block* current;   // 正在分配的块
+    uintptr_t cur;    // 当前块中下一次分配的位置
+    uintptr_t end;    // 当前块的结尾
+    size_t blockSize;
+    size_t maxRetain;
+    size_t totalSize;
+};
+
+template<typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena* arena) noexcept: arena(arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept: arena(other.arena) {}
+
+    T* allocate(size_t n)
+    {
+        return (T*)arena->allocate(n * sizeof(T), alignof(T));
+    }
+
+    // 单独释放什么也不做，内存在 reset() 时整体回收
+    void deallocate(T*, size_t) noexcept {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+    Arena* arena;
+};
+
+typedef basic_string<char, char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+// FNV-1a
+struct ArenaStringHash
+{
+    size_t operator()(const ArenaString& s) const
+    {
+        size_t h = 14695981039346656037ULL;
+        for (unsigned char ch : s)
+        {
+            h = (h ^ ch) * 1099511628211ULL;
+        }
+        return h;
+    }
+};
+
+typedef unordered_map<ArenaString, ArenaString, ArenaStringHash, equal_to<ArenaString>,
+                      ArenaAllocator<pair<const ArenaString, ArenaString>>> ArenaStringMap;
+
+#endif
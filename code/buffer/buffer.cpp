@@ -1,4 +1,5 @@
 #include "buffer.h"
+#include "../metrics/alloctrack.h"
 
 using namespace std;
 
@@ -90,6 +91,12 @@ void Buffer::append(const string& str)
     append(str.data(), str.length());
 }
 
+void Buffer::append(const char* str)
+{
+    assert(str);
+    append(str, strlen(str));
+}
+
 void Buffer::append(const void* data, size_t len)
 {
     assert(data);
@@ -177,6 +184,7 @@ const char* Buffer::beginPtr() const
 // 容量不够时扩容
 void Buffer::makeSpace(size_t len)
 {
+    ALLOC_SCOPE(ALLOC_BUFFER);
     // 可用空间不足
     if (writableBytes() + prependableBytes() < len)
     {
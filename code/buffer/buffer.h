@@ -9,6 +9,8 @@
 #include <atomic>
 #include <cassert>
 
+#include "bufferpool.h"
+
 using namespace std;
 
 class Buffer
@@ -35,6 +37,7 @@ public:
     char* beginWrite();
 
     void append(const string& str);
+    void append(const char* str); // 以 '\0' 结尾的字符串，不构造临时的 string
     void append(const char* str, size_t len);
     void append(const void* data, size_t len);
     void append(const Buffer& buffer);
@@ -47,7 +50,7 @@ private:
     const char* beginPtr() const; // 获取内存起始位置
     void makeSpace(size_t len);   // 创建空间
 
-    vector<char> buffer;     // 存放数据的vector
+    vector<char, BufferAllocator<char>> buffer; // 存放数据的vector（开启缓冲区池时从池中分配）
     atomic<size_t> readPos;  // 读的位置
     atomic<size_t> writePos; // 写的位置
 };
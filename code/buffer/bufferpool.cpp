@@ -0,0 +1,136 @@
+#include "bufferpool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+atomic<bool> BufferPool::enabled(false);
+
+BufferPool::BufferPool():
+    mode(HUGE_PAGE_OFF), numaLocal(false), regionSize(0), nodeNum(1),
+    regionNum(0), mapped(0), used(0)
+{
+}
+
+BufferPool* BufferPool::instance()
+{
+    static BufferPool pool;
+    return &pool;
+}
+
+void BufferPool::init(HUGE_PAGE_MODE& mode, bool numaLocal, size_t regionSize)
+{
+    if (enabled) return;
+    this->numaLocal = numaLocal;
+    this->regionSize = regionSize < MAX_CHUNK ? MAX_CHUNK : regionSize;
+    nodeNum = numaLocal ? min(PageAlloc::nodeCount(), MAX_NODES) : 1;
+    for (int i = 0; i < nodeNum; i ++)
+    {
+        nodes[i].reset(new Node());
+    }
+
+    // 先映射当前节点的第一个区域，确定实际使用的页的方式（显式大页可能退回透明大页）
+    this->mode = mode;
+    int nodeId = numaLocal ? PageAlloc::currentNode() % nodeNum : 0;
+    Node& node = *nodes[nodeId];
+    lock_guard<mutex> locker(node.mtx);
+    mapRegion(node, nodeId);
+    mode = this->mode;
+    enabled.store(true, memory_order_release);
+}
+
+int BufferPool::classOf(size_t size)
+{
+    int cls = 0;
+    size_t chunk = MIN_CHUNK;
+    while (chunk < size)
+    {
+        chunk <<= 1;
+        cls ++;
+    }
+    return cls;
+}
+
+// 映射一个新区域，作为节点的当前区域（旧区域剩下的不足一块的部分不再使用）
+bool BufferPool::mapRegion(Node& node, int nodeId)
+{
+    lock_guard<mutex> locker(regionMtx);
+    int num = regionNum.load(memory_order_relaxed);
+    if (num >= MAX_REGIONS) return false;
+
+    size_t size = regionSize;
+    char* addr = (char*)PageAlloc::map(size, mode, numaLocal ? nodeId : -1);
+    if (!addr) return false;
+
+    regions[num] = {addr, addr + size, nodeId};
+    regionNum.store(num + 1, memory_order_release);
+    mapped += size;
+    node.cur = addr;
+    node.end = addr + size;
+    return true;
+}
+
+const BufferPool::Region* BufferPool::findRegion(const void* p) const
+{
+    int num = regionNum.load(memory_order_acquire);
+    for (int i = 0; i < num; i ++)
+    {
+        if (p >= regions[i].begin && p < regions[i].end) return &regions[i];
+    }
+    return nullptr;
+}
+
+void* BufferPool::allocateChunk(size_t size)
+{
+    int cls = classOf(size);
+    size_t chunk = MIN_CHUNK << cls;
+    int nodeId = numaLocal ? PageAlloc::currentNode() % nodeNum : 0;
+    Node& node = *nodes[nodeId];
+    {
+        lock_guard<mutex> locker(node.mtx);
+        void* p = node.freeList[cls];
+        if (p)
+        {
+            node.freeList[cls] = *(void**)p;
+        }
+        else if (node.end - node.cur >= (ptrdiff_t)chunk || mapRegion(node, nodeId))
+        {
+            p = node.cur;
+            node.cur += chunk;
+        }
+        if (p)
+        {
+            used += chunk;
+            return p;
+        }
+    }
+    // 区域数用完或映射失败
+    return ::operator new(size);
+}
+
+void BufferPool::deallocateChunk(void* p, size_t size)
+{
+    if (!p) return;
+    const Region* region = findRegion(p);
+    if (!region)
+    {
+        ::operator delete(p); // 开启前或退回全局堆时分配的
+        return;
+    }
+    int cls = classOf(size);
+    Node& node = *nodes[region->node];
+    lock_guard<mutex> locker(node.mtx);
+    *(void**)p = node.freeList[cls];
+    node.freeList[cls] = p;
+    used -= MIN_CHUNK << cls;
+}
+
+size_t BufferPool::mappedBytes() const
+{
+    return mapped;
+}
+
+size_t BufferPool::usedBytes() const
+{
+    return used;
+}
@@ -0,0 +1,118 @@
+/*
+    缓冲区内存池
+
+    Buffer 的存储默认直接使用全局堆。开启后（WebServer 按配置调用 init），1KB ~ 64KB 的存储
+    从 PageAlloc 映射的区域中按 2 的幂大小分配，释放后放回空闲链表复用（不归还给系统）：
+        大页：区域使用透明大页或显式大页，大量连接的读写缓冲区集中在少量大页内，减少 dTLB 缺失；
+        NUMA：每个节点有自己的区域和空闲链表，从当前线程所在节点的区域分配，
+              释放时放回内存所属节点的链表。
+    超过 64KB 的存储、区域数用完或映射失败时退回全局堆；释放时按地址判断是否属于内存池。
+
+    BufferAllocator 是 Buffer 内部 vector 使用的分配器。
+*/
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <new>
+
+#include "pagealloc.h"
+
+using namespace std;
+
+class BufferPool
+{
+public:
+    static const size_t MIN_CHUNK = 1024;
+    static const int CLASS_NUM = 7;                              // 1KB, 2KB, ..., 64KB
+    static const size_t MAX_CHUNK = MIN_CHUNK << (CLASS_NUM - 1);
+    static const int MAX_REGIONS = 256;
+    static const int MAX_NODES = 64;
+
+    static BufferPool* instance();
+
+    // 开启内存池（只能调用一次，在创建连接之前）；mode 返回实际使用的页的方式
+    void init(HUGE_PAGE_MODE& mode, bool numaLocal, size_t regionSize);
+
+    static void* allocate(size_t size)
+    {
+        if (!enabled.load(memory_order_acquire) || size > MAX_CHUNK) return ::operator new(size);
+        return instance()->allocateChunk(size);
+    }
+
+    static void deallocate(void* p, size_t size)
+    {
+        if (!enabled.load(memory_order_acquire) || size > MAX_CHUNK) ::operator delete(p);
+        else instance()->deallocateChunk(p, size);
+    }
+
+    static bool isEnabled() { return enabled.load(memory_order_acquire); }
+    size_t mappedBytes() const; // 已映射的区域大小
+    size_t usedBytes() const;   // 正在使用的存储大小（按分配的块大小计算）
+
+private:
+    BufferPool();
+    ~BufferPool() = default;
+
+    struct Node
+    {
+        mutex mtx;
+        char* cur = nullptr;          // 当前区域中未分配部分的起点
+        char* end = nullptr;
+        void* freeList[CLASS_NUM] = {};
+    };
+
+    struct Region
+    {
+        char* begin;
+        char* end;
+        int node;
+    };
+
+    void* allocateChunk(size_t size);
+    void deallocateChunk(void* p, size_t size);
+    bool mapRegion(Node& node, int nodeId); // 调用者持有 node.mtx
+    const Region* findRegion(const void* p) const;
+
+    static int classOf(size_t size);
+
+    static atomic<bool> enabled;
+
+    HUGE_PAGE_MODE mode;
+    bool numaLocal;
+    size_t regionSize;
+    int nodeNum;
+    unique_ptr<Node> nodes[MAX_NODES];
+
+    mutex regionMtx;
+    Region regions[MAX_REGIONS];
+    atomic<int> regionNum;          // 写入 regions 后再增加，读取时不需要加锁
+    atomic<size_t> mapped;
+    atomic<size_t> used;
+};
+
+template<typename T>
+class BufferAllocator
+{
+public:
+    typedef T value_type;
+
+    BufferAllocator() noexcept {}
+
+    template<typename U>
+    BufferAllocator(const BufferAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return (T*)BufferPool::allocate(n * sizeof(T)); }
+    void deallocate(T* p, size_t n) noexcept { BufferPool::deallocate(p, n * sizeof(T)); }
+
+    template<typename U>
+    bool operator==(const BufferAllocator<U>&) const { return true; }
+
+    template<typename U>
+    bool operator!=(const BufferAllocator<U>&) const { return false; }
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "pagealloc.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+static const int MPOL_PREFERRED_MODE = 1; // <numaif.h> 中的 MPOL_PREFERRED
+
+static size_t roundUp(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+// 优先从 node 节点分配，失败不影响映射本身
+static void bindNode(void* addr, size_t size, int node)
+{
+    if (node < 0 || node >= 64) return;
+    unsigned long mask = 1UL << node;
+    syscall(SYS_mbind, addr, size, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8 + 1, 0);
+}
+
+void* PageAlloc::map(size_t& size, HUGE_PAGE_MODE& mode, int node)
+{
+    if (mode == HUGE_PAGE_EXPLICIT)
+    {
+        size_t hugeSize = roundUp(size, HUGE_PAGE_SIZE);
+        void* addr = mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED)
+        {
+            bindNode(addr, hugeSize, node);
+            size = hugeSize;
+            return addr;
+        }
+        mode = HUGE_PAGE_THP; // 大页预留不足
+    }
+
+    if (mode == HUGE_PAGE_THP)
+    {
+        // 多映射一个大页，截掉首尾，得到 2MB 对齐的区域，内核才能用大页映射
+        size_t hugeSize = roundUp(size, HUGE_PAGE_SIZE);
+        size_t mapSize = hugeSize + HUGE_PAGE_SIZE;
+        char* raw = (char*)mmap(nullptr, mapSize, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return nullptr;
+        char* addr = (char*)roundUp((uintptr_t)raw, HUGE_PAGE_SIZE);
+        if (addr > raw) munmap(raw, addr - raw);
+        if (raw + mapSize > addr + hugeSize) munmap(addr + hugeSize, raw + mapSize - addr - hugeSize);
+        madvise(addr, hugeSize, MADV_HUGEPAGE);
+        bindNode(addr, hugeSize, node);
+        size = hugeSize;
+        return addr;
+    }
+
+    size_t pageSize = roundUp(size, sysconf(_SC_PAGESIZE));
+    void* addr = mmap(nullptr, pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) return nullptr;
+    bindNode(addr, pageSize, node);
+    size = pageSize;
+    return addr;
+}
+
+void PageAlloc::unmap(void* addr, size_t size)
+{
+    if (addr) munmap(addr, size);
+}
+
+int PageAlloc::nodeCount()
+{
+    static int count = [] {
+        int n = 0;
+        DIR* dir = opendir("/sys/devices/system/node");
+        if (!dir) return 1;
+        while (struct dirent* entry = readdir(dir))
+        {
+            int id;
+            if (sscanf(entry->d_name, "node%d", &id) == 1 && id + 1 > n) n = id + 1;
+        }
+        closedir(dir);
+        return n > 0 ? n : 1;
+    }();
+    return count;
+}
+
+int PageAlloc::currentNode()
+{
+    unsigned int cpu = 0, node = 0;
+    if (getcpu(&cpu, &node) < 0) return 0;
+    return (int)node;
+}
+
+size_t PageAlloc::hugePageBytes()
+{
+    FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+    if (!fp) return 0;
+    char line[256];
+    size_t total = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long kb;
+        if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+            sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1 ||
+            sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1)
+        {
+            total += kb << 10;
+        }
+    }
+    fclose(fp);
+    return total;
+}
+
+const char* PageAlloc::modeName(HUGE_PAGE_MODE mode)
+{
+    switch (mode)
+    {
+    case HUGE_PAGE_THP:      return "thp";
+    case HUGE_PAGE_EXPLICIT: return "hugetlb";
+    default:                 return "off";
+    }
+}
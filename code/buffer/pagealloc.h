@@ -0,0 +1,41 @@
+/*
+    大块内存的映射：可选大页，可选绑定 NUMA 节点
+
+    连接表、缓冲区池这类长期存在、随机访问的大块内存，使用 2MB 大页可以显著减少 dTLB 缺失：
+        HUGE_PAGE_THP       透明大页：按 2MB 对齐映射后 madvise(MADV_HUGEPAGE)，由内核在缺页时分配大页，
+                            不需要预留（/sys/kernel/mm/transparent_hugepage/enabled 为 always 或 madvise）
+        HUGE_PAGE_EXPLICIT  显式大页：MAP_HUGETLB，需要预先预留（vm.nr_hugepages），
+                            预留不足时映射失败，退回透明大页
+    绑定节点使用 mbind(MPOL_PREFERRED)：优先从该节点分配，节点内存不足时仍可以使用其他节点。
+    直接使用系统调用，不依赖 libnuma。
+*/
+#ifndef PAGEALLOC_H
+#define PAGEALLOC_H
+
+#include <stddef.h>
+
+enum HUGE_PAGE_MODE
+{
+    HUGE_PAGE_OFF = 0,  // 普通页
+    HUGE_PAGE_THP,      // 透明大页
+    HUGE_PAGE_EXPLICIT  // 显式大页（hugetlbfs）
+};
+
+class PageAlloc
+{
+public:
+    static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    // 映射 size 字节的匿名内存（不小于 size，按页大小向上取整），node < 0 表示不绑定节点。
+    // 显式大页映射失败时退回透明大页，mode 改为实际使用的方式；失败返回 nullptr
+    static void* map(size_t& size, HUGE_PAGE_MODE& mode, int node = -1);
+    static void unmap(void* addr, size_t size);
+
+    static int nodeCount();   // NUMA 节点数，不支持时为 1
+    static int currentNode(); // 当前线程所在的 NUMA 节点
+    static size_t hugePageBytes(); // 进程当前使用的大页内存（透明大页 + 显式大页）
+
+    static const char* modeName(HUGE_PAGE_MODE mode);
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+    并发布隆过滤器
+
+    位数组由 64 位原子整数组成，添加用 fetch_or，查询用 load，多个线程可以同时添加和查询，不需要加锁。
+    只能回答“一定不存在”或“可能存在”：
+        mayContain 返回 false，键一定没有添加过；
+        返回 true，键可能存在，需要再做精确查询。
+
+    位数和哈希函数个数按预期元素数和误判率计算，元素数超出预期时误判率升高，但结果仍然正确。
+    k 个哈希值由两个基础哈希值组合得到（h1 + i * h2）。
+*/
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cmath>
+#include <stdint.h>
+
+class BloomFilter
+{
+public:
+    // 预期元素数，误判率
+    explicit BloomFilter(size_t expectedItems = 1 << 20, double fpRate = 0.01)
+    {
+        if (expectedItems == 0) expectedItems = 1;
+        if (fpRate <= 0 || fpRate >= 1) fpRate = 0.01;
+        // m = -n * ln(p) / (ln2)^2，k = m / n * ln2
+        double bits = -(double)expectedItems * std::log(fpRate) / (std::log(2.0) * std::log(2.0));
+        wordCnt = ((size_t)bits + 63) / 64;
+        bitCnt = wordCnt * 64;
+        hashCnt = (int)std::lround(bits / expectedItems * std::log(2.0));
+        if (hashCnt < 1) hashCnt = 1;
+        words.reset(new std::atomic<uint64_t>[wordCnt]);
+        clear();
+    }
+
+    void add(const std::string& key)
+    {
+        uint64_t h1, h2;
+        hash(key, h1, h2);
+        for (int i = 0; i < hashCnt; i ++)
+        {
+            uint64_t bit = (h1 + i * h2) % bitCnt;
+            words[bit / 64].fetch_or(1ull << (bit % 64), std::memory_order_relaxed);
+        }
+    }
+
+    bool mayContain(const std::string& key) const
+    {
+        uint64_t h1, h2;
+        hash(key, h1, h2);
+        for (int i = 0; i < hashCnt; i ++)
+        {
+            uint64_t bit = (h1 + i * h2) % bitCnt;
+            if (!(words[bit / 64].load(std::memory_order_relaxed) & (1ull << (bit % 64))))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < wordCnt; i ++)
+        {
+            words[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    size_t bitSize() const { return bitCnt; }
+    int hashSize() const { return hashCnt; }
+
+private:
+    // FNV-1a 得到 64 位哈希，再混合出第二个哈希（奇数，保证步长不为 0）
+    static void hash(const std::string& key, uint64_t& h1, uint64_t& h2)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char ch : key)
+        {
+            h = (h ^ ch) * 1099511628211ull;
+        }
+        h1 = h;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h2 = h | 1;
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> words; // 位数组
+    size_t wordCnt;
+    uint64_t bitCnt;
+    int hashCnt; // 哈希函数个数
+};
+
+#endif
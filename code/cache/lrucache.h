@@ -0,0 +1,164 @@
+/*
+    分片的并发 LRU 缓存
+
+    键按哈希值分到多个分片，每个分片一把互斥锁、一个双向链表和一个哈希表：
+        链表按最近使用的顺序保存条目，表头最新，表尾最旧；
+        哈希表保存键到链表结点的迭代器，查找、移动、删除都是 O(1)。
+
+    不同分片的操作互不影响，减少多个线程同时访问时的锁竞争。
+    每个条目带有过期时间（TTL），过期的条目在查找时删除；分片满时淘汰表尾条目。
+*/
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+#include <assert.h>
+
+template<class K, class V, class Hash = std::hash<K>>
+class LruCache
+{
+public:
+    // 最大条目数，条目有效期（毫秒），分片数量
+    explicit LruCache(size_t capacity = 65536, int ttlMs = 60000, size_t shardNum = 16);
+
+    ~LruCache() = default;
+
+    bool get(const K& key, V& value);
+
+    void put(const K& key, const V& value);
+
+    void erase(const K& key);
+
+    void clear();
+
+    size_t size();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        K key;
+        V value;
+        Clock::time_point expires; // 到期时间
+    };
+
+    struct Shard
+    {
+        std::mutex mtx;
+        std::list<Entry> items; // 按使用顺序排列的条目
+        std::unordered_map<K, typename std::list<Entry>::iterator, Hash> index;
+    };
+
+    Shard& shardOf(const K& key);
+
+    size_t shardCapacity;      // 每个分片的最大条目数
+    std::chrono::milliseconds ttl;
+    size_t shardNum;
+    std::unique_ptr<Shard[]> shards;
+    Hash hasher;
+};
+
+
+template<class K, class V, class Hash>
+LruCache<K, V, Hash>::LruCache(size_t capacity, int ttlMs, size_t shardNum)
+    : ttl(ttlMs), shardNum(shardNum), shards(new Shard[shardNum])
+{
+    assert(capacity > 0 && shardNum > 0 && ttlMs > 0);
+    shardCapacity = (capacity + shardNum - 1) / shardNum;
+}
+
+template<class K, class V, class Hash>
+typename LruCache<K, V, Hash>::Shard& LruCache<K, V, Hash>::shardOf(const K& key)
+{
+    return shards[hasher(key) % shardNum];
+}
+
+template<class K, class V, class Hash>
+bool LruCache<K, V, Hash>::get(const K& key, V& value)
+{
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        return false;
+    }
+    // 过期的条目直接删除
+    if (it->second->expires <= Clock::now())
+    {
+        shard.items.erase(it->second);
+        shard.index.erase(it);
+        return false;
+    }
+    // 移到表头
+    shard.items.splice(shard.items.begin(), shard.items, it->second);
+    value = it->second->value;
+    return true;
+}
+
+template<class K, class V, class Hash>
+void LruCache<K, V, Hash>::put(const K& key, const V& value)
+{
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        // 已有条目：更新值和到期时间，移到表头
+        it->second->value = value;
+        it->second->expires = Clock::now() + ttl;
+        shard.items.splice(shard.items.begin(), shard.items, it->second);
+        return;
+    }
+    // 分片已满：淘汰最久未使用的条目
+    if (shard.items.size() >= shardCapacity)
+    {
+        shard.index.erase(shard.items.back().key);
+        shard.items.pop_back();
+    }
+    shard.items.push_front({key, value, Clock::now() + ttl});
+    shard.index[key] = shard.items.begin();
+}
+
+template<class K, class V, class Hash>
+void LruCache<K, V, Hash>::erase(const K& key)
+{
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        shard.items.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+template<class K, class V, class Hash>
+void LruCache<K, V, Hash>::clear()
+{
+    for (size_t i = 0; i < shardNum; i ++)
+    {
+        std::lock_guard<std::mutex> locker(shards[i].mtx);
+        shards[i].index.clear();
+        shards[i].items.clear();
+    }
+}
+
+template<class K, class V, class Hash>
+size_t LruCache<K, V, Hash>::size()
+{
+    size_t total = 0;
+    for (size_t i = 0; i < shardNum; i ++)
+    {
+        std::lock_guard<std::mutex> locker(shards[i].mtx);
+        total += shards[i].items.size();
+    }
+    return total;
+}
+
+#endif
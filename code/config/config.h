@@ -0,0 +1,101 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+#include <vector>
+
+#include "../userStore/userstore.h"
+#include "../buffer/pagealloc.h"
+
+// 只读副本的地址，账号和数据库名与主库相同
+struct SqlReplica
+{
+    std::string name; // 名称，用于日志
+    std::string host;
+    int port;
+};
+
+// 请求的执行方式
+enum EXEC_MODE
+{
+    EXEC_POOL = 0, // 读取、处理、发送都交给请求线程池，每个请求两次跨线程切换
+    EXEC_HYBRID,   // 事件循环直接读取、解析并尝试发送，只把代价高的发送（大文件、文件不在页缓存中）交给线程池
+};
+
+/*
+    服务器的扩展配置
+
+    基本参数（端口、触发模式、数据库账号、线程数等）仍由 WebServer 的构造函数传入，
+    这里是各个模块的可选参数，都有默认值，只需要修改关心的字段。
+*/
+struct Config
+{
+    // 用户存储：USER_STORE_MYSQL 使用下面的数据库配置，USER_STORE_LOCAL 使用本地日志文件
+    USER_STORE_TYPE userStore = USER_STORE_MYSQL;
+    std::string userStorePath = "./users.db"; // 本地存储的日志文件
+    bool userStoreSync = true;                // 本地存储每次注册后落盘
+    bool userBloom = true;                    // MySQL 存储注册时用布隆过滤器跳过查询（需要 username 唯一键）
+    int userInsertBatch = 32;                 // MySQL 存储合并注册插入，每批最多的行数，1 表示不合并
+    int userInsertDelayMs = 2;                // 收集一批注册的最长时间，即注册最多额外等待的时间
+
+    // 内存布局：连接表和读写缓冲区
+    HUGE_PAGE_MODE hugePages = HUGE_PAGE_OFF;  // 使用透明大页（THP）或显式大页（需预留 vm.nr_hugepages），减少 dTLB 缺失
+    bool numaLocal = false;                    // 缓冲区从当前线程所在 NUMA 节点分配，连接表绑定到主线程所在节点
+    size_t bufferRegionSize = 16 << 20;        // 开启大页或 NUMA 时，缓冲区池每次映射的区域大小
+
+    // CPU 绑定：CPU 列表的格式如 "0-3,8"，空表示该角色不绑定（开启自动分散时自动分配）
+    std::string cpuLoop;              // 事件循环（主线程）
+    std::string cpuWorkers;           // 请求线程池，第 i 个线程绑定列表中第 i 个 CPU（线程多于 CPU 时循环使用）
+    std::string cpuSqlWorkers;        // 数据库线程池
+    std::string cpuLog;               // 异步日志的写线程
+    bool cpuAutoSpread = false;       // 未指定列表的角色按物理核依次分配，不与超线程的兄弟核共用
+    std::string irqDevice;            // 网卡名（如 eth0），启动时把它的中断所在的 CPU 写入日志
+    bool cpuAvoidIrq = false;         // 自动分配时避开处理网卡中断的 CPU
+
+    // 请求执行方式
+    EXEC_MODE execMode = EXEC_POOL;
+    size_t inlineWriteBytes = 64 << 10; // 混合模式下事件循环直接发送的响应上限（响应头 + 文件），超过时交给线程池
+
+    // 事件循环忙轮询（降低轻负载时的唤醒延迟，代价是事件循环所在的 CPU 一直忙碌）
+    int busyPollUs = 0;                 // 阻塞等待前先以零超时轮询 epoll 的时长（微秒），0 表示关闭
+    int socketBusyPollUs = 0;           // 连接的 SO_BUSY_POLL（微秒），读取时由内核轮询网卡队列，0 表示不设置
+    bool socketPreferBusyPoll = false;  // 连接的 SO_PREFER_BUSY_POLL（内核 5.11+），忙轮询时推迟网卡中断
+
+    // 日志
+    size_t logSegmentSize = 16 << 20;       // 日志分段大小，写满后切换到下一个分段
+    int logMaxSegments = 0;                 // 日志目录内最多保留的分段数，超过时删除最旧的（包括之前运行留下的），0 表示不删除
+
+    // 运行指标
+    bool metricsEnabled = true;             // 记录计数器和延迟直方图
+    std::string metricsPath = "/metrics";   // Prometheus 文本格式的指标接口
+    int statsIntervalMs = 200;              // 共享内存统计段的更新间隔（webserver-top 读取），0 表示关闭
+    int lockReportMs = 10000;               // 锁竞争分析（make LOCK_PROFILE=1）定期写入日志的间隔，0 表示不写
+    int allocReportMs = 10000;              // 分子系统的内存分配统计（make ALLOC_TRACK=1）写入日志的间隔，0 表示不写
+
+    // 主循环监控
+    bool loopMonitor = true;                // 记录主循环每次迭代的耗时分解和定时器延迟
+    int loopSlowCallbackUs = 5000;          // 单个事件处理或定时器回调超过该时间时告警，0 表示不检查
+    int loopSlowIterationUs = 20000;        // 一次迭代（不含 epoll_wait）超过该时间时告警，0 表示不检查
+
+    // 请求追踪
+    int traceSample = 0;                    // 每 N 个请求采样一个，记录各阶段的时间戳，0 表示关闭
+    size_t traceEvents = 1 << 16;           // 每个线程环形缓冲区保存的事件数
+    std::string tracePath = "/debug/trace.json"; // 导出追踪（Chrome trace 格式）的接口
+    std::string traceDir = "./log";         // 收到 SIGUSR2 时追踪文件的写入目录
+
+    // 会话
+    int sessionTtlMs = 30 * 60 * 1000;  // 会话有效期，每次访问后重新计算（滑动过期）
+    size_t sessionMax = 1 << 20;        // 最多保存的会话数，超过时淘汰最久未访问的会话
+    int sessionSweepMs = 1000;          // 过期会话的清理间隔（由服务器定时器驱动）
+
+    // 数据库连接池
+    std::string sqlHost = "localhost";  // 主库地址，处理注册（写）
+    std::vector<SqlReplica> sqlReplicas; // 只读副本，分担登录查询，出错时自动切换
+    int sqlMinConn = 0;            // 最少保持的连接数，0 表示与连接池数量相同
+    int sqlWaitTimeoutMs = 500;    // 获取连接的最长等待时间，超时返回 503，-1 表示一直等待
+    int sqlIdleTimeoutMs = 60000;  // 超过最少连接数的空闲连接，空闲多久后关闭
+    int sqlPingIntervalMs = 30000; // 空闲连接的健康检查间隔
+    bool sqlThreadAffine = false;  // 线程独占连接：每个数据库线程绑定一个连接，取用和归还不需要同步
+};
+
+#endif
@@ -3,6 +3,8 @@
 using namespace std;
 
 const char* HttpConnect::srcDir;
+string HttpConnect::metricsPath;
+string HttpConnect::tracePath;
 atomic<int> HttpConnect::userCnt;
 bool HttpConnect::isET;
 
@@ -11,6 +13,11 @@ HttpConnect::HttpConnect()
     fd = -1;
     addr = {0};
     isClose = true;
+    traceId = 0;
+    acceptNs = 0;
+    firstRequest = true;
+    placed = false;
+    verifying = false;
 }
 
 HttpConnect::~HttpConnect()
@@ -28,6 +35,11 @@ void HttpConnect::init(int fd, const sockaddr_in& addr)
     writeBuffer.retrieveAll();
     readBuffer.retrieveAll();
     isClose = false;
+    traceId = 0;
+    firstRequest = true;
+    placed = false;
+    verifying = false;
+    acceptNs = Tracer::instance()->isEnabled() ? Metrics::now() : 0;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd, getIP(), getPort(), (int)userCnt);
 }
 
@@ -38,7 +50,10 @@ void HttpConnect::closeConnect()
     if (!isClose)
     {
         isClose = true;
+        verifying = false;
         userCnt --;
+        Metrics::add(CNT_CLOSE);
+        endTrace(TRACE_CLOSE);
         close(fd);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd, getIP(), getPort(), (int)userCnt);
     }
@@ -64,6 +79,21 @@ sockaddr_in HttpConnect::getAddr() const
     return addr; 
 }
 
+// 读缓冲区为空说明是一个新请求的开始，按比例采样；连接的第一个请求被采样时补记接受连接的时间
+void HttpConnect::beginTrace()
+{
+    if (traceId == 0 && readBuffer.readableBytes() == 0)
+    {
+        traceId = Tracer::instance()->sample();
+        if (traceId && firstRequest && acceptNs)
+        {
+            Tracer::record(traceId, TRACE_ACCEPT, fd, acceptNs);
+        }
+        firstRequest = false;
+    }
+    trace(TRACE_EPOLLIN);
+}
+
 /* 
     读方法，ET模式将缓存读空  
     读入数据到读缓冲区
@@ -90,6 +120,7 @@ ssize_t HttpConnect::read(int* saveErrno)
 */
 ssize_t HttpConnect::write(int* saveErrno)
 {
+    MetricTimer timer(HIST_WRITE);
     // 最后一次写入的长度
     ssize_t len = -1;
     do
@@ -100,6 +131,8 @@ ssize_t HttpConnect::write(int* saveErrno)
             *saveErrno = errno;
             break;
         }
+        Metrics::add(CNT_BYTES_WRITTEN, len);
+        trace(TRACE_WRITE, len);
         // 缓存为空，传输完成
         if (iov[0].iov_len + iov[1].iov_len == 0) 
         { 
@@ -144,7 +177,12 @@ bool HttpConnect::process()
         return false;
     }
 
-    HTTP_CODE ret = request.parse(readBuffer);
+    HTTP_CODE ret;
+    {
+        MetricTimer timer(HIST_PARSE);
+        ret = request.parse(readBuffer);
+    }
+    trace(TRACE_PARSE);
     // 请求不完整，继续读
     if (ret == HTTP_CODE::NO_REQUEST)
     {
@@ -153,19 +191,68 @@ bool HttpConnect::process()
     // 请求完整，开始写
     else if (ret == HTTP_CODE::GET_REQUEST)
     {
-        LOG_DEBUG("%s", request.getPathConst().c_str());
+        // 登录、注册交给数据库线程，验证完成后再生成响应（见 verify）
+        Metrics::add(CNT_REQUEST);
+        if (request.isVerifyPending())
+        {
+            return true;
+        }
+        LOG_DEBUG("%s", request.getPath().c_str());
         response.init(srcDir, request.getPath(), request.isKeepAlive(), 200);
+        // 内置的指标接口，先于静态资源处理
+        if (!metricsPath.empty() && metricsPath == request.getPath().c_str())
+        {
+            response.setContent(Metrics::instance()->exposition());
+        }
+        else if (!tracePath.empty() && tracePath == request.getPath().c_str())
+        {
+            response.setContent(Tracer::instance()->exportJson());
+        }
     }
     // 请求行错误
     else if (ret == HTTP_CODE::BAD_REQUEST)
     {
+        Metrics::add(CNT_BAD_REQUEST);
         response.init(srcDir, request.getPath(), false, 400);
     }
 
+    prepareResponse();
+    return true;
+}
+
+// 查询数据库验证用户，再生成响应（在数据库线程中执行）
+void HttpConnect::verify()
+{
+    // 数据库繁忙时返回 503，客户端可以稍后重试
+    int code;
+    {
+        MetricTimer timer(HIST_VERIFY);
+        code = request.verifyUser() ? 200 : 503;
+    }
+    LOG_DEBUG("%s", request.getPath().c_str());
+    response.init(srcDir, request.getPath(), request.isKeepAlive(), code);
+    response.setCookie(request.getSetCookie());
+    prepareResponse();
+}
+
+// 数据库线程池繁忙，不查询数据库，直接返回 503
+void HttpConnect::rejectVerify()
+{
+    request.cancelVerify();
+    response.init(srcDir, request.getPath(), request.isKeepAlive(), 503);
+    prepareResponse();
+}
+
+// 在写缓存中写入响应头，并且获取响应体内容（文件）
+void HttpConnect::prepareResponse()
+{
+    placed = false;
     response.makeResponse(writeBuffer);
+    trace(TRACE_RESPONSE);
     // 响应头
     iov[0].iov_base = (char*)writeBuffer.peek();
     iov[0].iov_len = writeBuffer.readableBytes();
+    iov[1].iov_len = 0;
     iovCnt = 1;
     // 响应体
     if (response.getFileLen() > 0 && response.getFile())
@@ -176,5 +263,4 @@ bool HttpConnect::process()
     }
 
     LOG_DEBUG("filesize:%d, iovcnt:%d, write:%d bytes", response.getFileLen(), iovCnt, toWriteBytes());
-    return true;
 }
@@ -10,6 +10,8 @@
 #include "../log/log.h"
 #include "../sqlConnPool/sqlconnpool.h"
 #include "../buffer/buffer.h"
+#include "../metrics/metrics.h"
+#include "../metrics/tracer.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 
@@ -33,27 +35,79 @@ public:
     sockaddr_in getAddr() const;
 
     bool process();
+    void verify();
+    void rejectVerify();
+
+    // 请求需要等待数据库操作完成后才能生成响应
+    bool isSqlPending() const
+    {
+        return request.isVerifyPending();
+    }
+
+    // 验证已交给数据库线程，直到事件循环重新收到这个连接的写事件（期间不能因超时关闭连接）
+    void setVerifying(bool on) { verifying.store(on, memory_order_release); }
+    bool isVerifying() const { return verifying.load(memory_order_acquire); }
 
     int toWriteBytes()
     {
         return iov[0].iov_len + iov[1].iov_len;
     }
 
+    // 剩下的响应可以直接在事件循环中发送：不超过 maxBytes，且文件内容已在页缓存中
+    bool isCheapWrite(size_t maxBytes) const
+    {
+        return iov[0].iov_len + iov[1].iov_len <= maxBytes && (iov[1].iov_len == 0 || response.isFileCached());
+    }
+
+    // 混合模式下记录响应由事件循环还是请求线程发送，每个响应只计一次（发送被拆成多次时不重复计入）
+    void countPlacement(bool onLoop)
+    {
+        if (placed) return;
+        placed = true;
+        Metrics::add(onLoop ? CNT_INLINE_RESPONSE : CNT_OFFLOAD_RESPONSE);
+    }
+
     bool isKeepAlive() const
     {
         return request.isKeepAlive();
     }
 
+    // 新请求开始时按比例采样（主线程收到 EPOLLIN 时调用）
+    void beginTrace();
+
+    // 记录当前请求的一个阶段，未被采样时直接返回
+    void trace(TRACE_STAGE stage, uint64_t arg = 0)
+    {
+        if (traceId) Tracer::record(traceId, stage, arg);
+    }
+
+    // 请求结束（响应发送完成或连接关闭）
+    void endTrace(TRACE_STAGE stage)
+    {
+        trace(stage);
+        traceId = 0;
+    }
+
     static bool isET;
     static const char* srcDir;  // 资源的目录
     static atomic<int> userCnt; // 当前的客户端的连接数
+    static string metricsPath;  // 指标接口的路径，空表示关闭
+    static string tracePath;    // 追踪导出接口的路径，空表示关闭
 
 private:
+    void prepareResponse();
+
     int fd;
     struct sockaddr_in addr;
 
     bool isClose;
 
+    uint32_t traceId;   // 当前请求的追踪编号，0 表示未被采样
+    uint64_t acceptNs;  // 接受连接的时间（开启追踪时记录）
+    bool firstRequest;  // 还没有开始过请求
+    bool placed;        // 当前响应已计入 countPlacement
+    atomic<bool> verifying; // 数据库线程正在（或即将）使用这个连接
+
     int iovCnt;
     struct iovec iov[2];
 
@@ -1,31 +1,64 @@
 #include "httprequest.h"
+#include "../metrics/alloctrack.h"
 
 using namespace std;
 
-const unordered_set<string> HttpRequest::DEFAULT_HTML
+const char* const HttpRequest::DEFAULT_HTML[] =
 {
     "/index", "/register", "/login",
     "/welcome", "/video", "/picture"
 };
 
-const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG
+const HttpRequest::HtmlTag HttpRequest::DEFAULT_HTML_TAG[] =
 {
     {"/register.html", 0},
     {"/login.html", 1}
 };
 
+UserStore* HttpRequest::userStore = nullptr;
+
+const char* HttpRequest::SESSION_COOKIE = "sid";
+
+// [begin, end) 与字符串 str 相同
+static bool equals(const char* begin, const char* end, const char* str)
+{
+    size_t len = strlen(str);
+    return (size_t)(end - begin) == len && memcmp(begin, str, len) == 0;
+}
+
+HttpRequest::HttpRequest():
+    method(ArenaAllocator<char>(&arena)), path(ArenaAllocator<char>(&arena)),
+    version(ArenaAllocator<char>(&arena)), body(ArenaAllocator<char>(&arena)),
+    header(0, ArenaStringHash(), equal_to<ArenaString>(), ArenaAllocator<char>(&arena)),
+    post(0, ArenaStringHash(), equal_to<ArenaString>(), ArenaAllocator<char>(&arena))
+{
+    init();
+}
+
 void HttpRequest::init()
 {
-    method = path = version = body = "";
+    ALLOC_SCOPE(ALLOC_HTTP_REQUEST);
+    // 字符串和容器先交换给临时对象析构，放弃 arena 中的内存，再整体回收
+    // （clear() 会保留容量，之后继续使用被回收的内存）
+    ArenaAllocator<char> alloc(&arena);
+    ArenaString(alloc).swap(method);
+    ArenaString(alloc).swap(path);
+    ArenaString(alloc).swap(version);
+    ArenaString(alloc).swap(body);
+    ArenaStringMap(0, ArenaStringHash(), equal_to<ArenaString>(), alloc).swap(header);
+    ArenaStringMap(0, ArenaStringHash(), equal_to<ArenaString>(), alloc).swap(post);
+    arena.reset();
+
     state = REQUEST_LINE;
-    header.clear();
-    post.clear();
     linger = false;
     contentLen = 0;
+    verifyTag = -1;
+    setCookie.clear();
 }
 
 HTTP_CODE HttpRequest::parse(Buffer& buffer)
 {
+    ALLOC_SCOPE(ALLOC_HTTP_REQUEST);
     const char CRLF[] = "\r\n";
     while (buffer.readableBytes())
     {
@@ -34,14 +67,15 @@ HTTP_CODE HttpRequest::parse(Buffer& buffer)
         // 如果没找到 CRLF，也不是 BODY，那么一定不完整
         if (lineEnd == buffer.beginWrite() && state != BODY) return NO_REQUEST;
         
-        string line(buffer.peek(), lineEnd);
-        if (state == BODY && line.size() < contentLen) return NO_REQUEST;
+        // 直接在读缓存上解析，不复制这一行
+        const char* line = buffer.peek();
+        if (state == BODY && (size_t)(lineEnd - line) < contentLen) return NO_REQUEST;
 
         switch(state)
         {
         case REQUEST_LINE:
         {
-            HTTP_CODE ret = parseRequestLine(line);
+            HTTP_CODE ret = parseRequestLine(line, lineEnd);
             buffer.retrieveUntil(lineEnd + 2);
             if (ret == BAD_REQUEST)
             {
@@ -52,11 +86,12 @@ HTTP_CODE HttpRequest::parse(Buffer& buffer)
         }
         case HEADERS:
         {
-            HTTP_CODE ret = parseHeader(line);
+            HTTP_CODE ret = parseHeader(line, lineEnd);
             buffer.retrieveUntil(lineEnd + 2);
             // 根据content-length字段判断请求完整，提前结束
             if (ret == GET_REQUEST)
             {
+                parseSession();
                 return GET_REQUEST;
             }
             break;
@@ -64,7 +99,7 @@ HTTP_CODE HttpRequest::parse(Buffer& buffer)
         case BODY:
         {
             // 响应体无CRLF，不需要+2
-            HTTP_CODE ret = parseBody(line);
+            HTTP_CODE ret = parseBody(line, lineEnd);
             buffer.retrieveUntil(lineEnd);
             if (ret == GET_REQUEST)
             {
@@ -89,24 +124,29 @@ void HttpRequest::parsePath()
     if (path == "/")
     {
         path = "/index.html";
+        return;
     }
-    else if (DEFAULT_HTML.count(path))
+    for (const char* html : DEFAULT_HTML)
     {
-        path += ".html";
+        if (path == html)
+        {
+            path += ".html";
+            return;
+        }
     }
 }
 
 // 解析请求行
-HTTP_CODE HttpRequest::parseRequestLine(const string& line)
+HTTP_CODE HttpRequest::parseRequestLine(const char* begin, const char* end)
 {
-    // GET / HTTP/1.1
-    regex pattern("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, pattern))
+    // GET / HTTP/1.1（方法 空格 路径 空格 HTTP/版本，各部分不含空格）
+    const char* sp1 = find(begin, end, ' ');
+    const char* sp2 = sp1 == end ? end : find(sp1 + 1, end, ' ');
+    if (end - sp2 >= 6 && memcmp(sp2, " HTTP/", 6) == 0 && find(sp2 + 6, end, ' ') == end)
     {
-        method = subMatch[1];
-        path = subMatch[2];
-        version = subMatch[3];
+        method.assign(begin, sp1);
+        path.assign(sp1 + 1, sp2);
+        version.assign(sp2 + 6, end);
         state = HEADERS;
         return NO_REQUEST;
     }
@@ -115,22 +155,27 @@ HTTP_CODE HttpRequest::parseRequestLine(const string& line)
 }
 
 // 解析请求头
-HTTP_CODE HttpRequest::parseHeader(const string& line)
+HTTP_CODE HttpRequest::parseHeader(const char* begin, const char* end)
 {
-    // Connection: keep-alive
-    regex pattern("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, pattern))
+    // Connection: keep-alive（冒号后的一个空格可省略）
+    const char* colon = find(begin, end, ':');
+    if (colon != end)
     {
-        header[subMatch[1]] = subMatch[2];
-        if (subMatch[1] == "Connection")
+        const char* value = colon + 1;
+        if (value != end && *value == ' ') value ++;
+        if (equals(begin, colon, "Connection"))
         {
-            linger = (subMatch[2] == "keep-alive");
+            linger = equals(value, end, "keep-alive");
         }
-        if (subMatch[1] == "Content-Length")
+        if (equals(begin, colon, "Content-Length"))
         {
-            contentLen = stoi(subMatch[2]);
+            contentLen = 0;
+            for (const char* p = value; p != end && isdigit((unsigned char)*p); p ++)
+            {
+                contentLen = contentLen * 10 + (*p - '0');
+            }
         }
+        setField(header, makeString(begin, colon - begin), makeString(value, end - value));
         return NO_REQUEST;
     }
     else if (contentLen)
@@ -146,15 +191,43 @@ HTTP_CODE HttpRequest::parseHeader(const string& line)
 }
 
 // 解析请求体，内部处理post请求
-HTTP_CODE HttpRequest::parseBody(const string& line)
+HTTP_CODE HttpRequest::parseBody(const char* begin, const char* end)
 {
-    body = line;
+    body.assign(begin, end);
     parsePost();
     // state = FINISH;
-    LOG_DEBUG("Body:%s len:%d", line.c_str(), line.size());
+    LOG_DEBUG("Body:%s len:%d", body.c_str(), body.size());
     return GET_REQUEST;
 }
 
+// map[key] = value（分配器没有默认构造函数，不能使用 operator[]）
+void HttpRequest::setField(ArenaStringMap& map, ArenaString&& key, ArenaString&& value)
+{
+    auto it = map.find(key);
+    if (it != map.end())
+    {
+        it->second = move(value);
+    }
+    else
+    {
+        map.emplace(move(key), move(value));
+    }
+}
+
+// 查找 map 中的 key，不存在时返回 nullptr
+const ArenaString* HttpRequest::getField(const ArenaStringMap& map, const char* key)
+{
+    auto it = map.find(makeString(key));
+    return it == map.end() ? nullptr : &it->second;
+}
+
+// 表单中 key 的值，不存在时为空（交给会话、用户存储使用）
+string HttpRequest::getPost(const char* key)
+{
+    const ArenaString* value = getField(post, key);
+    return value ? string(value->data(), value->size()) : string();
+}
+
 // 十六进制转为十进制
 int HttpRequest::convertHex(char ch)
 {
@@ -167,26 +240,90 @@ int HttpRequest::convertHex(char ch)
 void HttpRequest::parsePost()
 {
     // key-value
-    if (method == "POST" && header["Content-Type"] == "application/x-www-form-urlencoded")
+    const ArenaString* type = getField(header, "Content-Type");
+    if (method == "POST" && type && *type == "application/x-www-form-urlencoded")
     {
         parseFromUrlEncoded(); // 解析表单信息
-        if (DEFAULT_HTML_TAG.count(path))
+        for (const HtmlTag& tag : DEFAULT_HTML_TAG)
         {
+            if (path != tag.path) continue;
             // tag=1:login, tag=0:register
-            int tag = DEFAULT_HTML_TAG.find(path)->second;
-            LOG_DEBUG("Tag:%d", tag);
-            if (userVerify(post["username"], post["password"], tag))
-            {
-                LOG_INFO("success!");
-                path = "/welcome.html";
-            }
-            else
-            {
-                LOG_INFO("failed!");   
-                path = "/error.html";
-            }
+            // 需要查询数据库，由数据库线程调用 verifyUser 完成验证
+            verifyTag = tag.tag;
+            LOG_DEBUG("Tag:%d", verifyTag);
+            parseSession();
+            break;
+        }
+    }
+}
+
+// 取出请求头 Cookie 中名为 name 的值（Cookie: a=1; sid=xxx）
+string HttpRequest::getCookie(const string& name)
+{
+    const ArenaString* field = getField(header, "Cookie");
+    if (!field) return "";
+    const ArenaString& cookie = *field;
+    size_t pos = 0;
+    while (pos < cookie.size())
+    {
+        size_t end = cookie.find(';', pos);
+        if (end == string::npos) end = cookie.size();
+        while (pos < end && cookie[pos] == ' ') pos ++;
+        size_t eq = cookie.find('=', pos);
+        if (eq < end && cookie.compare(pos, eq - pos, name.c_str()) == 0)
+        {
+            return string(cookie.data() + eq + 1, end - eq - 1);
         }
+        pos = end + 1;
     }
+    return "";
+}
+
+// 已登录（会话有效）的客户端访问登录页或再次提交同一用户的登录表单，直接进入欢迎页，不查询数据库
+void HttpRequest::parseSession()
+{
+    if (path != "/login.html") return;
+    string sid = getCookie(SESSION_COOKIE);
+    string user;
+    if (sid.empty() || !SessionStore::instance()->lookup(sid, user)) return;
+    // 表单换了用户，按正常流程登录
+    if (verifyTag == 1 && getPost("username") != user) return;
+    LOG_DEBUG("Session hit: %s", user.c_str());
+    verifyTag = -1;
+    path = "/welcome.html";
+}
+
+// 验证登录、注册，并根据结果跳转页面（在数据库线程中执行）
+bool HttpRequest::verifyUser()
+{
+    assert(verifyTag >= 0);
+    bool isLogin = verifyTag;
+    string name = getPost("username");
+    VERIFY_RESULT ret = userVerify(name, getPost("password"), isLogin);
+    verifyTag = -1;
+    if (ret == VERIFY_SUCCESS)
+    {
+        LOG_INFO("success!");
+        path = "/welcome.html";
+        // 登录成功，创建会话，之后的请求凭 Cookie 识别用户
+        if (isLogin)
+        {
+            SessionStore* store = SessionStore::instance();
+            setCookie = string(SESSION_COOKIE) + "=" + store->create(name) +
+                        "; Path=/; HttpOnly; Max-Age=" + to_string(store->getTtlMs() / 1000);
+        }
+    }
+    else if (ret == VERIFY_FAILED)
+    {
+        LOG_INFO("failed!");   
+        path = "/error.html";
+    }
+    else
+    {
+        LOG_WARN("verify busy!");
+        return false;
+    }
+    return true;
 }
 
 // 从post请求中解析数据
@@ -194,7 +331,7 @@ void HttpRequest::parseFromUrlEncoded()
 {
     if (body.size() == 0) return;
 
-    string key, value;
+    ArenaString key = makeString(""), value = makeString("");
     int num = 0;
     int n = body.size();
     // key=value&key=value
@@ -208,7 +345,7 @@ void HttpRequest::parseFromUrlEncoded()
         switch (ch)
         {
         case '=':
-            key = body.substr(j, i - j);
+            key = makeString(body.data() + j, i - j);
             j = i + 1;
             break;
         case '+':
@@ -222,9 +359,9 @@ void HttpRequest::parseFromUrlEncoded()
             i += 2;
             break;
         case '&':
-            value = body.substr(j, i - j);
+            value = makeString(body.data() + j, i - j);
             j = i + 1;
-            post[key] = value;
+            setField(post, ArenaString(key), move(value));
         default:
             break;
         }
@@ -233,85 +370,19 @@ void HttpRequest::parseFromUrlEncoded()
     // last value
     if (!post.count(key) && j < i)
     {
-        value = body.substr(j, i - j);
-        post[key] = value;
+        setField(post, move(key), makeString(body.data() + j, i - j));
     }
 }
 
-bool HttpRequest::userVerify(const string &name, const string &pwd, bool isLogin) {
-    if (name == "" || pwd == "") { return false; }
+VERIFY_RESULT HttpRequest::userVerify(const string &name, const string &pwd, bool isLogin) {
+    if (name == "" || pwd == "") { return VERIFY_FAILED; }
     LOG_DEBUG("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL* sql;
-    SqlConnect(&sql, SqlConnPool::instance());
-    assert(sql);
-    bool flag = false;
-
-    char order[256] = { 0 };
-    MYSQL_RES *res = nullptr;
-    
-    if (!isLogin) { flag = true; }
-    // 查找用户是否存在
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("%s", order);
-
-    // 失败返回非0，成功返回0
-    // 失败释放结果集
-    if (mysql_query(sql, order)) 
-    { 
-        mysql_free_result(res);
-        return false; 
-    }
-    // 保存结果集
-    res = mysql_store_result(sql);
-
-    // 遍历结果集，如果为空，那么判断为假
-    while(MYSQL_ROW row = mysql_fetch_row(res)) 
-    {
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        string password(row[1]);
-        if (isLogin) 
-        {
-            if (pwd == password) { flag = true; }
-            else 
-            {
-                flag = false;
-                LOG_DEBUG("pwd error!");
-            }
-        } 
-        else 
-        { 
-            flag = false; 
-            LOG_DEBUG("user used!");
-        }
-    }
-    // 释放结果集
-    mysql_free_result(res);
-
-    /* 用户名未被使用，继续注册 */
-    if (!isLogin && flag == true) 
-    {
-        LOG_DEBUG("regirster!");
-        bzero(order, 256);
-        snprintf(order, 256,"INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG( "%s", order);
-        if (mysql_query(sql, order)) 
-        { 
-            LOG_DEBUG( "Insert error!");
-            flag = false; 
-        }
-        flag = true;
-    }
-    // RAII机制，不需要手动释放连接
-    // SqlConnPool::instance()->releaseConn(sql);
-    LOG_DEBUG( "UserVerify success!!");
-    return flag;
+    assert(userStore);
+    return isLogin ? userStore->login(name, pwd) : userStore->registerUser(name, pwd);
 }
 
+// 只有请求头 Connection: keep-alive 时 linger 为 true
 bool HttpRequest::isKeepAlive() const
 {
-    if (header.count("Connection"))
-    {
-        return linger;
-    }
-    return false;
+    return linger;
 }
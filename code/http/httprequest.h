@@ -2,16 +2,14 @@
 #define HTTPREQUEST_H
 
 #include <unordered_map>
-#include <unordered_set>
 #include <string>
-#include <regex>
 #include <errno.h>
-#include <mysql/mysql.h>
 
 #include "../buffer/buffer.h"
+#include "../buffer/arena.h"
 #include "../log/log.h"
-#include "../sqlConnPool/sqlconnpool.h"
-#include "../threadPool/threadpool.h"
+#include "../userStore/userstore.h"
+#include "../session/sessionstore.h"
 
 using namespace std;
 
@@ -35,42 +33,74 @@ enum PARSE_STATE
     FINISH            // 解析完成
 };
 
+/*
+    请求的方法、路径、请求头、表单等临时数据都从请求自己的 arena 分配，
+    init() 时整体回收（见 arena.h），稳定后解析一个请求不再向全局堆申请内存。
+    取出的引用在下一次 init() 之前有效。
+*/
 class HttpRequest
 {
 public:
-    HttpRequest() { init(); }
+    HttpRequest();
     ~HttpRequest() = default;
 
     void init();
     HTTP_CODE parse(Buffer& buffer);
 
-    string getPathConst() const { return path; }
-    string& getPath() { return path; }
-    string getMethod() const { return method; }
-    string getVersion() const { return version; }
+    const ArenaString& getPath() const { return path; }
+    const ArenaString& getMethod() const { return method; }
+    const ArenaString& getVersion() const { return version; }
 
     bool isKeepAlive() const;
 
+    // 登录、注册请求需要查询数据库
+    bool isVerifyPending() const { return verifyTag >= 0; }
+    // 放弃验证（数据库线程池繁忙）
+    void cancelVerify() { verifyTag = -1; }
+    bool verifyUser(); // 数据库繁忙时返回 false
+
+    // 需要发给客户端的 Set-Cookie（登录成功时设置会话编号）
+    const string& getSetCookie() const { return setCookie; }
+
+    static UserStore* userStore; // 用户存储的后端，由 WebServer 设置
+
 private:
-    HTTP_CODE parseRequestLine(const string& line);
-    HTTP_CODE parseHeader(const string& line);
-    HTTP_CODE parseBody(const string& line);
+    HTTP_CODE parseRequestLine(const char* begin, const char* end);
+    HTTP_CODE parseHeader(const char* begin, const char* end);
+    HTTP_CODE parseBody(const char* begin, const char* end);
 
     void parsePath();
     void parsePost();
     void parseFromUrlEncoded();
+    void parseSession();
+    string getCookie(const string& name);
+    string getPost(const char* key);
 
-    static bool userVerify(const string& name, const string& pwd, bool isLogin);
+    // 在 arena 中构造字符串
+    ArenaString makeString(const char* str, size_t len) { return ArenaString(str, len, ArenaAllocator<char>(&arena)); }
+    ArenaString makeString(const char* str) { return makeString(str, strlen(str)); }
+    static void setField(ArenaStringMap& map, ArenaString&& key, ArenaString&& value);
+    const ArenaString* getField(const ArenaStringMap& map, const char* key);
 
+    static VERIFY_RESULT userVerify(const string& name, const string& pwd, bool isLogin);
+
+    // arena 最先构造、最后析构，其余成员都可能引用其中的内存
+    Arena arena;
     PARSE_STATE state;                    // 解析的状态
-    string method, path, version, body;   // 请求方法，请求路径，协议版本，请求体
-    unordered_map<string, string> header; // 请求头
-    unordered_map<string, string> post;   // post 请求表单数据
+    ArenaString method, path, version, body; // 请求方法，请求路径，协议版本，请求体
+    ArenaStringMap header;                // 请求头
+    ArenaStringMap post;                  // post 请求表单数据
     bool linger;
     size_t contentLen; 
+    int verifyTag;                        // 待验证的表单：-1 无，0 注册，1 登录
+    string setCookie;                     // 响应中的 Set-Cookie，空表示不设置
+
 
-    static const unordered_set<string> DEFAULT_HTML;          // 默认的网页
-    static const unordered_map<string, int> DEFAULT_HTML_TAG;
+    // 路径表很小，直接逐个比较，不为查表构造 string
+    struct HtmlTag { const char* path; int tag; };
+    static const char* SESSION_COOKIE;               // 会话编号的 Cookie 名
+    static const char* const DEFAULT_HTML[];         // 默认的网页
+    static const HtmlTag DEFAULT_HTML_TAG[];
     static int convertHex(char ch); // 转换为十六进制
 };
 
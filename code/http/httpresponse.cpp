@@ -1,7 +1,10 @@
 #include "httpresponse.h"
+#include "../metrics/alloctrack.h"
 
 using namespace std;
 
+const string HttpResponse::DEFAULT_TYPE = "text/plain";
+
 const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = 
 {
     { ".html",  "text/html" },
@@ -23,6 +26,7 @@ const unordered_map<string, string> HttpResponse::SUFFIX_TYPE =
     { ".tar",   "application/x-tar" },
     { ".css",   "text/css "},
     { ".js",    "text/javascript "},
+    { ".json",  "application/json" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_STATUS = 
@@ -31,6 +35,7 @@ const unordered_map<int, string> HttpResponse::CODE_STATUS =
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 503, "Service Unavailable" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = 
@@ -38,13 +43,16 @@ const unordered_map<int, string> HttpResponse::CODE_PATH =
     { 400, "/400.html" },
     { 403, "/403.html" },
     { 404, "/404.html" },
+    { 503, "/503.html" },
 };
 
-HttpResponse::HttpResponse()
+HttpResponse::HttpResponse():
+    arena(1024), path(ArenaAllocator<char>(&arena)), filePath(ArenaAllocator<char>(&arena))
 {
     code = -1;
-    path = srcDir = "";
+    srcDir = "";
     isKeepAlive = false;
+    hasContent = false;
     mmFile = nullptr;
     mmFileStat = {0};
 }
@@ -55,14 +63,23 @@ HttpResponse::~HttpResponse()
 }
 
 // 响应报文初始化
-void HttpResponse::init(const string& srcDir, string& path, bool isKeepAlive, int code)
+void HttpResponse::init(const char* srcDir, const ArenaString& path, bool isKeepAlive, int code)
 {
-    assert(srcDir != "");
+    ALLOC_SCOPE(ALLOC_HTTP_RESPONSE);
+    assert(srcDir && *srcDir);
     if (mmFile) { unmapFile(); }
 
+    // 先放弃 arena 中的内存，再整体回收（见 HttpRequest::init）
+    ArenaString(ArenaAllocator<char>(&arena)).swap(this->path);
+    ArenaString(ArenaAllocator<char>(&arena)).swap(filePath);
+    arena.reset();
+
     this->code = code;
     this->isKeepAlive = isKeepAlive;
-    this->path = path;
+    this->cookie.clear();
+    this->content.clear();
+    this->hasContent = false;
+    this->path.assign(path.data(), path.size());
     this->srcDir = srcDir;
     mmFile = nullptr;
     mmFileStat = {0};
@@ -71,8 +88,22 @@ void HttpResponse::init(const string& srcDir, string& path, bool isKeepAlive, in
 // 创建响应报文
 void HttpResponse::makeResponse(Buffer& buffer)
 {
+    ALLOC_SCOPE(ALLOC_HTTP_RESPONSE);
+    MetricTimer timer(HIST_FILE_LOOKUP);
+    if (hasContent)
+    {
+        addState(buffer);
+        addHeader(buffer);
+        buffer.append("Content-length: ");
+        appendNumber(buffer, content.size());
+        buffer.append("\r\n\r\n");
+        buffer.append(content);
+        countCode();
+        return;
+    }
+
     // 判断请求的资源文件，如 /home/xxx/MyWebServer/resources/index.html
-    if (stat((srcDir + path).data(), &mmFileStat) < 0 || S_ISDIR(mmFileStat.st_mode)) // 调用失败 | 请求目录
+    if (stat(getFilePath(), &mmFileStat) < 0 || S_ISDIR(mmFileStat.st_mode)) // 调用失败 | 请求目录
     {
         code = 404;
     } 
@@ -93,6 +124,15 @@ void HttpResponse::makeResponse(Buffer& buffer)
     addHeader(buffer);
     // 添加响应体
     addContent(buffer);
+    countCode();
+}
+
+// 按状态码分类计数
+void HttpResponse::countCode()
+{
+    if (code >= 500) Metrics::add(CNT_RESPONSE_5XX);
+    else if (code >= 400) Metrics::add(CNT_RESPONSE_4XX);
+    else if (code >= 200 && code < 300) Metrics::add(CNT_RESPONSE_2XX);
 }
 
 // 获取映射的文件
@@ -107,6 +147,22 @@ size_t HttpResponse::getFileLen() const
     return mmFileStat.st_size;
 }
 
+// 只检查不超过 MAX_PAGES 页的文件，更大的文件视为不在页缓存中
+bool HttpResponse::isFileCached() const
+{
+    static const size_t MAX_PAGES = 64;
+    if (!mmFile) return true;
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t pages = (mmFileStat.st_size + pageSize - 1) / pageSize;
+    unsigned char resident[MAX_PAGES];
+    if (pages > MAX_PAGES || mincore(mmFile, mmFileStat.st_size, resident) < 0) return false;
+    for (size_t i = 0; i < pages; i ++)
+    {
+        if (!(resident[i] & 1)) return false;
+    }
+    return true;
+}
+
 int HttpResponse::getCode() const
 {
     return code;
@@ -122,20 +178,36 @@ void HttpResponse::unmapFile()
     }
 }
 
+// 资源的完整路径，path 改变后重新拼接
+const char* HttpResponse::getFilePath()
+{
+    filePath.assign(srcDir);
+    filePath.append(path);
+    return filePath.c_str();
+}
+
+// 追加十进制数字
+void HttpResponse::appendNumber(Buffer& buffer, long number)
+{
+    char num[24];
+    int len = snprintf(num, sizeof(num), "%ld", number);
+    buffer.append(num, len);
+}
+
 // 添加状态行
 void HttpResponse::addState(Buffer& buffer)
 {
-    string status;
-    if (CODE_STATUS.count(code))
-    {
-        status = CODE_STATUS.find(code)->second;
-    }
-    else
+    auto it = CODE_STATUS.find(code);
+    if (it == CODE_STATUS.end())
     {
         code = 400;
-        status = CODE_STATUS.find(400)->second;
+        it = CODE_STATUS.find(400);
     }
-    buffer.append("HTTP/1.1 " + to_string(code) + " " + status + "\r\n");
+    buffer.append("HTTP/1.1 ");
+    appendNumber(buffer, code);
+    buffer.append(" ");
+    buffer.append(it->second);
+    buffer.append("\r\n");
 }
 
 // 添加响应头
@@ -151,19 +223,27 @@ void HttpResponse::addHeader(Buffer& buffer)
     {
         buffer.append("close\r\n");
     }
-    buffer.append("Content-type: " + getFileType() + "\r\n");
+    if (!cookie.empty())
+    {
+        buffer.append("Set-Cookie: ");
+        buffer.append(cookie);
+        buffer.append("\r\n");
+    }
+    buffer.append("Content-type: ");
+    buffer.append(getFileType());
+    buffer.append("\r\n");
 }
 
 // 添加响应体
 void HttpResponse::addContent(Buffer& buffer)
 {
-    int srcFd = open((srcDir + path).data(), O_RDONLY);
+    int srcFd = open(filePath.c_str(), O_RDONLY);
     if (srcFd < 0)
     {
         errorContent(buffer, "File Not Found!");
         return;
     }
-    LOG_DEBUG("file path %s", (srcDir + path).data());
+    LOG_DEBUG("file path %s", filePath.c_str());
 
     // 将文件映射到内存提高文件的访问速度
     // PROT_READ：映射区可读，MAP_PRIVATE：写入时复制
@@ -175,21 +255,19 @@ void HttpResponse::addContent(Buffer& buffer)
     }
     mmFile = (char*)mmRet;
     close(srcFd);
-    buffer.append("Content-length: " + to_string(mmFileStat.st_size) + "\r\n\r\n");
+    buffer.append("Content-length: ");
+    appendNumber(buffer, mmFileStat.st_size);
+    buffer.append("\r\n\r\n");
 }
 
 // 判断文件类型
-string HttpResponse::getFileType()
+const string& HttpResponse::getFileType()
 {
-    string::size_type idx = path.find_last_of('.');
-    // 判断文件类型
-    if (idx == string::npos) return "text/plain";
-    string suffix = path.substr(idx);
-    if (SUFFIX_TYPE.count(suffix))
-    {
-        return SUFFIX_TYPE.find(suffix)->second;
-    }
-    return "text/plain";
+    size_t idx = path.find_last_of('.');
+    // 判断文件类型（已知的后缀都很短，查表用的 string 不会申请内存）
+    if (idx == ArenaString::npos || path.size() - idx > 15) return DEFAULT_TYPE;
+    auto it = SUFFIX_TYPE.find(string(path.data() + idx, path.size() - idx));
+    return it == SUFFIX_TYPE.end() ? DEFAULT_TYPE : it->second;
 }
 
 // 范围内的错误页面
@@ -197,30 +275,25 @@ void HttpResponse::errorHtml()
 {
     if (CODE_PATH.count(code))
     {
-        path = CODE_PATH.find(code)->second;
-        stat((srcDir + path).data(), &mmFileStat);
+        path.assign(CODE_PATH.find(code)->second.c_str());
+        stat(getFilePath(), &mmFileStat);
     }
 }
 
 // 范围外的错误页面
-void HttpResponse::errorContent(Buffer& buffer, string message)
+void HttpResponse::errorContent(Buffer& buffer, const char* message)
 {
-    string body;
-    string status;
-    body += "<html><title>Error</title>";
-    body += "<body bgcolor=\"ffffff\">";
-    if (CODE_STATUS.count(code))
-    {
-        status = CODE_STATUS.find(code)->second;
-    }
-    else
-    {
-        status = "Bad Request";
-    }
-    body += to_string(code) + " : " + status + "\n";
-    body += "<p>" + message + "</p>";
-    body += "<hr><em>MyWebServer</em></body></html>";
+    ALLOC_SCOPE(ALLOC_HTTP_RESPONSE);
+    auto it = CODE_STATUS.find(code);
+    char body[512];
+    int len = snprintf(body, sizeof(body),
+                       "<html><title>Error</title><body bgcolor=\"ffffff\">%d : %s\n"
+                       "<p>%s</p><hr><em>MyWebServer</em></body></html>",
+                       code, it != CODE_STATUS.end() ? it->second.c_str() : "Bad Request", message);
+    if (len >= (int)sizeof(body)) len = sizeof(body) - 1;
 
-    buffer.append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
-    buffer.append(body);
+    buffer.append("Content-length: ");
+    appendNumber(buffer, len);
+    buffer.append("\r\n\r\n");
+    buffer.append(body, len);
 }
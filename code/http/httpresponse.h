@@ -8,41 +8,63 @@
 #include <sys/mman.h>
 
 #include "../buffer/buffer.h"
+#include "../buffer/arena.h"
 #include "../log/log.h"
+#include "../metrics/metrics.h"
 
 using namespace std;
 
+/*
+    资源路径等临时数据从响应自己的 arena 分配，init() 时整体回收；
+    状态行和响应头直接追加到写缓存，不构造临时字符串。
+*/
 class HttpResponse
 {
 public:
     HttpResponse();
     ~HttpResponse();
 
-    void init(const string& srcDir, string& path, bool isKeepAlive = false, int code = -1);
+    // srcDir 由调用者保证在响应期间有效
+    void init(const char* srcDir, const ArenaString& path, bool isKeepAlive = false, int code = -1);
     void makeResponse(Buffer& buffer);
     void unmapFile();
     char* getFile();
     size_t getFileLen() const;
-    void errorContent(Buffer& buffer, string message);
+    // 映射的文件是否都在页缓存中（发送时不会因读盘阻塞），没有文件时为 true
+    bool isFileCached() const;
+    void errorContent(Buffer& buffer, const char* message);
     int getCode() const;
+    // 设置响应头 Set-Cookie，空字符串表示不设置（init 时清空）
+    void setCookie(const string& cookie) { this->cookie = cookie; }
+    // 使用内存中的响应体，不读取资源文件（init 时清空）
+    void setContent(const string& content) { this->content = content; hasContent = true; }
 
 private:
     void addState(Buffer& buffer);
     void addHeader(Buffer& buffer);
     void addContent(Buffer& buffer);
+    void countCode();
 
     void errorHtml();
-    string getFileType();
+    const string& getFileType();
+    const char* getFilePath();
+    static void appendNumber(Buffer& buffer, long number);
 
     int code;         // 响应状态码
     bool isKeepAlive; // 是否保持连接
+    string cookie;    // Set-Cookie 的值
+    string content;   // 内存中的响应体
+    bool hasContent;
 
-    string path;      // 资源的路径
-    string srcDir;    // 资源的目录
+    Arena arena;      // 先于 path、filePath 构造，后于它们析构
+    ArenaString path; // 资源的路径
+    ArenaString filePath; // 资源的完整路径（srcDir + path）
+    const char* srcDir;   // 资源的目录
 
     char* mmFile;     // 文件内存映射的指针
     struct stat mmFileStat; // 文件的状态信息
 
+    static const string DEFAULT_TYPE;                       // 未知后缀的类型
     static const unordered_map<string, string> SUFFIX_TYPE; // 后缀 -> 类型
     static const unordered_map<int, string> CODE_STATUS;    // 状态码 -> 描述
     static const unordered_map<int, string> CODE_PATH;      // 状态码 -> 路径
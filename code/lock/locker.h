@@ -1,127 +1,393 @@
 #ifndef LOCKER_H
 #define LOCKER_H
 
-#include <exception>
-#include <pthread.h>
-#include <semaphore.h>
+#include <atomic>
+#include <algorithm>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/*
+    锁的名称用于竞争分析：编译时定义 LOCK_PROFILE（make LOCK_PROFILE=1）后，
+    每个锁统计获取次数、等待时间和持有时间，按名称汇总（见 lockprofile.h）。
+    未定义时名称被忽略，没有额外开销。
+*/
+#ifdef LOCK_PROFILE
+#include "lockprofile.h"
+#endif
+
+/*
+    基于 futex 的互斥锁、条件变量和信号量
+
+    没有竞争时加锁、解锁、post、signal 都只是一次原子操作，不进入内核；
+    需要等待时先有限地自旋，仍然拿不到才调用 futex 休眠。
+    只有确实有线程在休眠时，解锁、post、signal 才调用 futex 唤醒，
+    主线程向空闲的工作线程分发任务时，如果对方还在自旋，就没有系统调用。
+
+    条件变量和信号量的 sleepers 是登记休眠且还没有被唤醒的线程数：唤醒方减去 futex 实际唤醒的
+    线程数，超时、被信号打断或没有进入休眠的线程自己减。被唤醒但还没有运行的线程不再计入，
+    连续的 signal、post 不会重复调用 futex 唤醒。
+*/
+
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex needs a plain 32-bit int");
+
+// abstime：绝对时间（CLOCK_REALTIME，与 pthread_cond_timedwait 相同），nullptr 表示一直等待
+static inline int futexWait(std::atomic<int>* addr, int val, const struct timespec* abstime = nullptr)
+{
+    return syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+                   val, abstime, nullptr, FUTEX_BITSET_MATCH_ANY);
+}
+
+// 返回被唤醒的线程数
+static inline int futexWake(std::atomic<int>* addr, int num)
+{
+    long ret = syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAKE_PRIVATE, num, nullptr, nullptr, 0);
+    return ret > 0 ? ret : 0;
+}
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/*
+    自适应自旋：记录最近自旋成功所需次数的滑动平均，下次最多自旋其两倍（至少 MIN_SPIN 次），
+    自旋失败时估计值衰减。单核机器上持有者不可能在自旋期间运行，不自旋。
+*/
+class AdaptiveSpin
+{
+public:
+    static const int MIN_SPIN = 16;
+    static const int MAX_SPIN = 1000;
+
+    AdaptiveSpin(): estimate(0) {}
+
+    int limit() const
+    {
+        static const bool multiCore = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+        if (!multiCore) return 0;
+        return std::min(MAX_SPIN, estimate.load(std::memory_order_relaxed) * 2 + MIN_SPIN);
+    }
+
+    // spins：成功前自旋的次数，失败时为 -1
+    void update(int spins)
+    {
+        int e = estimate.load(std::memory_order_relaxed);
+        int target = spins >= 0 ? spins : 0;
+        estimate.store(e + (target - e) / 8, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int> estimate; // 多个线程同时更新时丢失一次无妨
+};
 
 class sem
 {
 public:
-    sem()
+    explicit sem(int num = 0, const char* name = "sem"): count(num), sleepers(0)
+#ifdef LOCK_PROFILE
+        , stats(name, "sem")
+#endif
+    {
+    }
+
+    bool wait()
     {
-        if (sem_init(&m_sem, 0, 0) != 0)
+#ifdef LOCK_PROFILE
+        if (tryWait())
         {
-            throw std::exception();
+            stats.acquired(0, false);
+            return true;
         }
+        uint64_t start = LockProfiler::now();
+        waitSlow();
+        stats.acquired(LockProfiler::now() - start, true);
+#else
+        if (!tryWait()) waitSlow();
+#endif
+        return true;
     }
 
-    sem(int num)
+    bool post()
     {
-        if (sem_init(&m_sem, 0, num) != 0)
+        count.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) > 0)
         {
-            throw std::exception();
+            int woken = futexWake(&count, 1);
+            if (woken > 0) sleepers.fetch_sub(woken, std::memory_order_relaxed);
         }
+        return true;
     }
 
-    ~sem()
+    void setName(const char* name)
     {
-        sem_destroy(&m_sem);
+#ifdef LOCK_PROFILE
+        stats.setName(name);
+#else
+        (void)name;
+#endif
     }
 
-    bool wait()
+private:
+    bool tryWait()
     {
-        return sem_wait(&m_sem) == 0;
+        int c = count.load(std::memory_order_relaxed);
+        while (c > 0)
+        {
+            if (count.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
-    bool post()
+    void waitSlow()
     {
-        return sem_post(&m_sem) == 0;
+        int limit = spin.limit();
+        for (int i = 0; i < limit; i ++)
+        {
+            cpuRelax();
+            if (count.load(std::memory_order_relaxed) > 0 && tryWait())
+            {
+                spin.update(i);
+                return;
+            }
+        }
+        spin.update(-1);
+        // 先登记再由 futex 检查计数；post 先加计数再检查登记，两者至少有一方看到对方
+        while (!tryWait())
+        {
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            if (futexWait(&count, 0) != 0)
+            {
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
     }
 
-private:
-    sem_t m_sem;
+    std::atomic<int> count;
+    std::atomic<int> sleepers; // 登记休眠、还没有被唤醒的线程数
+    AdaptiveSpin spin;
+#ifdef LOCK_PROFILE
+    LockStats stats;
+#endif
 };
 
 
 class mtx
 {
 public:
-    mtx()
+    explicit mtx(const char* name = "mtx"): state(0)
+#ifdef LOCK_PROFILE
+        , stats(name, "mutex"), acquiredNs(0)
+#endif
     {
-        if (pthread_mutex_init(&m_mutex, NULL) != 0)
-        {
-            throw std::exception();
-        }
     }
 
-    ~mtx()
-    {
-        pthread_mutex_destroy(&m_mutex);
-    }
-    
     bool lock()
     {
-        return pthread_mutex_lock(&m_mutex) == 0;
+#ifdef LOCK_PROFILE
+        if (tryLock())
+        {
+            stats.acquired(0, false);
+        }
+        else
+        {
+            uint64_t start = LockProfiler::now();
+            lockSlow();
+            stats.acquired(LockProfiler::now() - start, true);
+        }
+        acquiredNs = LockProfiler::now();
+#else
+        if (!tryLock()) lockSlow();
+#endif
+        return true;
     }
 
     bool unlock()
     {
-        return pthread_mutex_unlock(&m_mutex) == 0;
+#ifdef LOCK_PROFILE
+        stats.released(LockProfiler::now() - acquiredNs);
+#endif
+        release();
+        return true;
     }
 
-    pthread_mutex_t *get()
+    void setName(const char* name)
     {
-        return &m_mutex;
+#ifdef LOCK_PROFILE
+        stats.setName(name);
+#else
+        (void)name;
+#endif
     }
 
 private:
-    pthread_mutex_t m_mutex;
-};
+    friend class cond;
 
+    bool tryLock()
+    {
+        int c = 0;
+        return state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
 
-class cond 
-{
-public:
-    cond()
+    void acquire()
+    {
+        if (!tryLock()) lockSlow();
+    }
+
+    // state 为 2 时可能有线程在休眠，需要唤醒一个
+    void release()
     {
-        if (pthread_cond_init(&m_cond, NULL) != 0)
+        if (state.fetch_sub(1, std::memory_order_release) != 1)
         {
-            throw std::exception();
+            state.store(0, std::memory_order_release);
+            futexWake(&state, 1);
         }
     }
 
-    ~cond()
+    void lockSlow()
     {
-        pthread_cond_destroy(&m_cond);
+        int limit = spin.limit();
+        for (int i = 0; i < limit; i ++)
+        {
+            cpuRelax();
+            if (state.load(std::memory_order_relaxed) == 0 && tryLock())
+            {
+                spin.update(i);
+                return;
+            }
+        }
+        spin.update(-1);
+        // 标记为有等待者后休眠，醒来后同样以 2 加锁（不知道是否还有其他等待者）
+        int c = state.exchange(2, std::memory_order_acquire);
+        while (c != 0)
+        {
+            futexWait(&state, 2);
+            c = state.exchange(2, std::memory_order_acquire);
+        }
     }
 
-    bool wait(pthread_mutex_t *m_mutex)
+    std::atomic<int> state; // 0 未加锁，1 加锁，2 加锁且可能有等待者
+    AdaptiveSpin spin;
+#ifdef LOCK_PROFILE
+    LockStats stats;
+    uint64_t acquiredNs; // 持有者获得锁的时间，只在持有锁时读写
+#endif
+};
+
+
+class cond
+{
+public:
+    explicit cond(const char* name = "cond"): seq(0), sleepers(0)
+#ifdef LOCK_PROFILE
+        , stats(name, "cond")
+#endif
     {
-        int ret = 0;
-        ret = pthread_cond_wait(&m_cond, m_mutex);
-        return ret == 0;
     }
-    
-    bool timewait(pthread_mutex_t *m_mutex, struct timespec t)
+
+    // 调用时必须持有 m；等待期间释放 m（不计入其持有时间），返回前重新加锁。允许虚假唤醒
+    bool wait(mtx& m)
     {
-        int ret = 0;
-        ret = pthread_cond_timedwait(&m_cond, m_mutex, &t);
-        return ret == 0;
+        return waitUntil(m, nullptr);
+    }
+
+    // t：绝对时间（CLOCK_REALTIME），超时返回 false
+    bool timewait(mtx& m, struct timespec t)
+    {
+        return waitUntil(m, &t);
     }
 
     bool signal()
     {
-        return pthread_cond_signal(&m_cond) == 0;
+        return wake(1);
     }
 
     bool broadcast()
     {
-        return pthread_cond_broadcast(&m_cond) == 0;
+        return wake(INT_MAX);
+    }
+
+    void setName(const char* name)
+    {
+#ifdef LOCK_PROFILE
+        stats.setName(name);
+#else
+        (void)name;
+#endif
     }
 
 private:
-    pthread_cond_t m_cond;
+    // 序号变化表示有通知；只有登记了休眠的线程时才调用 futex 唤醒
+    bool wake(int num)
+    {
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) > 0)
+        {
+            int woken = futexWake(&seq, num);
+            if (woken > 0) sleepers.fetch_sub(woken, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    bool waitUntil(mtx& m, const struct timespec* abstime)
+    {
+        // 在持有锁时读取序号，之后的通知都会改变它
+        int s = seq.load(std::memory_order_relaxed);
+#ifdef LOCK_PROFILE
+        uint64_t start = LockProfiler::now();
+        m.stats.released(start - m.acquiredNs);
+#endif
+        m.release();
+
+        bool ret = true;
+        int limit = spin.limit();
+        int i = 0;
+        while (i < limit && seq.load(std::memory_order_acquire) == s)
+        {
+            cpuRelax();
+            i ++;
+        }
+        if (seq.load(std::memory_order_acquire) != s)
+        {
+            spin.update(i);
+        }
+        else
+        {
+            spin.update(-1);
+            // 先登记再由 futex 检查序号；通知方先改序号再检查登记
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            if (futexWait(&seq, s, abstime) != 0)
+            {
+                // 没有被唤醒（超时、被信号打断或序号已变），由自己取消登记
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                ret = errno != ETIMEDOUT;
+            }
+        }
+
+        m.acquire();
+#ifdef LOCK_PROFILE
+        m.acquiredNs = LockProfiler::now();
+        stats.acquired(m.acquiredNs - start, true);
+#endif
+        return ret;
+    }
+
+    std::atomic<int> seq;      // 通知的序号
+    std::atomic<int> sleepers; // 登记休眠、还没有被唤醒的线程数
+    AdaptiveSpin spin;
+#ifdef LOCK_PROFILE
+    LockStats stats;
+#endif
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,158 @@
+#ifdef LOCK_PROFILE
+
+#include "lockprofile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+LockStats::LockStats(const char* name, const char* kind): name(name), kind(kind)
+{
+    LockProfiler::instance()->add(this);
+}
+
+LockStats::~LockStats()
+{
+    LockProfiler::instance()->remove(this);
+}
+
+void LockStats::setName(const char* name)
+{
+    LockProfiler::instance()->rename(this, name);
+}
+
+LockProfiler* LockProfiler::instance()
+{
+    static LockProfiler profiler;
+    return &profiler;
+}
+
+void LockProfiler::add(LockStats* lockStats)
+{
+    lock_guard<mutex> locker(mtx);
+    stats.push_back(lockStats);
+}
+
+void LockProfiler::remove(LockStats* lockStats)
+{
+    lock_guard<mutex> locker(mtx);
+    stats.erase(std::remove(stats.begin(), stats.end(), lockStats), stats.end());
+}
+
+void LockProfiler::rename(LockStats* lockStats, const char* name)
+{
+    lock_guard<mutex> locker(mtx);
+    lockStats->name = name;
+}
+
+static void addTo(HistogramSnapshot& snapshot, const Histogram& h)
+{
+    for (int i = 0; i < Histogram::BUCKET_NUM; i ++)
+    {
+        snapshot.buckets[i] += h.buckets[i].load(memory_order_relaxed);
+    }
+    snapshot.count += h.count.load(memory_order_relaxed);
+    snapshot.sum += h.sum.load(memory_order_relaxed);
+}
+
+// 同名、同类型的锁合并
+vector<LockProfiler::Summary> LockProfiler::summarize()
+{
+    vector<Summary> res;
+    lock_guard<mutex> locker(mtx);
+    for (LockStats* s : stats)
+    {
+        auto it = find_if(res.begin(), res.end(), [s](const Summary& x) {
+            return x.name == s->name && strcmp(x.kind, s->kind) == 0;
+        });
+        if (it == res.end())
+        {
+            res.push_back(Summary{s->name, s->kind, 0, 0, HistogramSnapshot(), HistogramSnapshot()});
+            it = res.end() - 1;
+        }
+        it->acquisitions += s->acquisitions.load(memory_order_relaxed);
+        it->contended += s->contended.load(memory_order_relaxed);
+        addTo(it->wait, s->waitNs);
+        addTo(it->hold, s->holdNs);
+    }
+    return res;
+}
+
+string LockProfiler::exposition()
+{
+    vector<Summary> summaries = summarize();
+    string out;
+    char line[256];
+    out += "# HELP webserver_lock_acquisitions_total Lock acquisitions (mutex), waits (cond, sem).\n";
+    out += "# TYPE webserver_lock_acquisitions_total counter\n";
+    for (const Summary& s : summaries)
+    {
+        snprintf(line, sizeof(line), "webserver_lock_acquisitions_total{lock=\"%s\",kind=\"%s\"} %llu\n",
+                 s.name.c_str(), s.kind, (unsigned long long)s.acquisitions);
+        out += line;
+    }
+    out += "# HELP webserver_lock_contended_total Acquisitions that had to wait.\n";
+    out += "# TYPE webserver_lock_contended_total counter\n";
+    for (const Summary& s : summaries)
+    {
+        snprintf(line, sizeof(line), "webserver_lock_contended_total{lock=\"%s\",kind=\"%s\"} %llu\n",
+                 s.name.c_str(), s.kind, (unsigned long long)s.contended);
+        out += line;
+    }
+
+    const char* NAMES[][2] = {
+        {"webserver_lock_wait_seconds", "Time waiting to acquire a lock or in a cond/sem wait."},
+        {"webserver_lock_hold_seconds", "Time a mutex is held."},
+    };
+    const double QUANTILES[] = {0.5, 0.99, 0.999};
+    for (int k = 0; k < 2; k ++)
+    {
+        out += string("# HELP ") + NAMES[k][0] + " " + NAMES[k][1] + "\n";
+        out += string("# TYPE ") + NAMES[k][0] + " summary\n";
+        for (const Summary& s : summaries)
+        {
+            const HistogramSnapshot& h = k == 0 ? s.wait : s.hold;
+            if (h.count == 0) continue;
+            for (double q : QUANTILES)
+            {
+                snprintf(line, sizeof(line), "%s{lock=\"%s\",kind=\"%s\",quantile=\"%g\"} %.9g\n",
+                         NAMES[k][0], s.name.c_str(), s.kind, q, h.percentile(q) / 1e9);
+                out += line;
+            }
+            snprintf(line, sizeof(line), "%s_sum{lock=\"%s\",kind=\"%s\"} %.9g\n%s_count{lock=\"%s\",kind=\"%s\"} %llu\n",
+                     NAMES[k][0], s.name.c_str(), s.kind, h.sum / 1e9,
+                     NAMES[k][0], s.name.c_str(), s.kind, (unsigned long long)h.count);
+            out += line;
+        }
+    }
+    return out;
+}
+
+vector<string> LockProfiler::report(size_t top)
+{
+    vector<Summary> summaries = summarize();
+    // 条件变量的等待大多是线程空闲，排在互斥锁和信号量之后
+    sort(summaries.begin(), summaries.end(), [](const Summary& a, const Summary& b) {
+        bool aCond = strcmp(a.kind, "cond") == 0, bCond = strcmp(b.kind, "cond") == 0;
+        if (aCond != bCond) return bCond;
+        return a.wait.sum > b.wait.sum;
+    });
+    vector<string> lines;
+    char line[256];
+    for (size_t i = 0; i < summaries.size() && i < top; i ++)
+    {
+        const Summary& s = summaries[i];
+        if (s.acquisitions == 0) continue;
+        snprintf(line, sizeof(line),
+                 "%-6s %-20s %10llu acquisitions, %5.1f%% contended, wait total %.3f ms p99 %.1f us, hold p99 %.1f us",
+                 s.kind, s.name.c_str(), (unsigned long long)s.acquisitions,
+                 100.0 * s.contended / s.acquisitions, s.wait.sum / 1e6,
+                 s.wait.percentile(0.99) / 1e3, s.hold.count ? s.hold.percentile(0.99) / 1e3 : 0.0);
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+    锁竞争分析（编译时定义 LOCK_PROFILE 才启用，见 locker.h）
+
+    每个具名的 mtx / cond / sem 带一个 LockStats，记录：
+        mutex：获取次数、需要等待的次数、等待时间和持有时间的直方图
+        cond ：等待次数、等待（阻塞）时间的直方图
+        sem  ：等待次数、需要阻塞的次数、阻塞时间的直方图
+    多个线程同时更新同一个锁的统计，计数用原子加；同名的锁（例如主库和副本的连接池）汇总输出。
+
+    输出：/metrics 追加每个锁的计数和分位数（带 lock、kind 标签），
+          另外由服务器定时把等待时间最长的几个锁写入日志。
+*/
+#ifndef LOCKPROFILE_H
+#define LOCKPROFILE_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "../metrics/metrics.h"
+
+using namespace std;
+
+struct LockStats
+{
+    LockStats(const char* name, const char* kind);
+    ~LockStats();
+
+    void setName(const char* name);
+
+    // 一次获取（或等待）完成，wait 为等待时间，blocked 表示需要等待
+    void acquired(uint64_t wait, bool blocked)
+    {
+        acquisitions.fetch_add(1, memory_order_relaxed);
+        if (blocked) contended.fetch_add(1, memory_order_relaxed);
+        add(waitNs, wait);
+    }
+
+    // 一次持有结束
+    void released(uint64_t hold)
+    {
+        add(holdNs, hold);
+    }
+
+    static void add(Histogram& h, uint64_t value)
+    {
+        h.buckets[Histogram::index(value)].fetch_add(1, memory_order_relaxed);
+        h.count.fetch_add(1, memory_order_relaxed);
+        h.sum.fetch_add(value, memory_order_relaxed);
+    }
+
+    string name;
+    const char* kind;
+    atomic<uint64_t> acquisitions{0};
+    atomic<uint64_t> contended{0};
+    Histogram waitNs;
+    Histogram holdNs;
+};
+
+class LockProfiler
+{
+public:
+    static LockProfiler* instance();
+
+    static uint64_t now() { return Metrics::now(); }
+
+    void add(LockStats* stats);
+    void remove(LockStats* stats);
+    void rename(LockStats* stats, const char* name);
+
+    // Prometheus 文本格式，追加到 /metrics
+    string exposition();
+
+    // 等待时间最长的 top 个锁（条件变量在后），每个锁一行
+    vector<string> report(size_t top);
+
+private:
+    struct Summary
+    {
+        string name;
+        const char* kind;
+        uint64_t acquisitions;
+        uint64_t contended;
+        HistogramSnapshot wait;
+        HistogramSnapshot hold;
+    };
+
+    LockProfiler() = default;
+    ~LockProfiler() = default;
+
+    vector<Summary> summarize();
+
+    mutex mtx; // 保护 stats（本身不做统计）
+    vector<LockStats*> stats;
+};
+
+#endif
@@ -4,7 +4,8 @@
     生产者：向队列尾部插入日志信息的线程
     消费者：从队列头部取出日志信息并处理的线程
 
-    因为涉及到多线程读写，使用互斥锁实现对队列的互斥访问，同时使用两个条件变量。
+    因为涉及到多线程读写，使用互斥锁实现对队列的互斥访问，同时使用两个条件变量
+    （locker.h 中的 mtx / cond，锁竞争分析按构造时的名称统计）。
 
     插入和删除时，条件变量需要配合互斥锁。
     先上锁，然后在 while 循环内检查条件变量
@@ -16,13 +17,15 @@
 
 #include <mutex>
 #include <queue>
-#include <condition_variable>
+#include <assert.h>
+#include <time.h>
 #include <sys/time.h>
+#include "../lock/locker.h"
 
 template<class T>
 class BlockQueue {
 public:
-    explicit BlockQueue(size_t MaxCapacity = 1000);
+    explicit BlockQueue(size_t MaxCapacity = 1000, const char* name = "blockqueue");
 
     ~BlockQueue();
 
@@ -46,6 +49,8 @@ public:
 
     void push(const T &item);
 
+    bool tryPush(const T &item);
+
     bool pop(T &item);
 
     bool pop(T &item, int timeout);
@@ -55,18 +60,19 @@ private:
 
     size_t capacity_;
 
-    std::mutex mtx;
+    mtx mtxQueue;
 
     bool isClose;
 
-    std::condition_variable condConsumer;
+    cond condConsumer;
 
-    std::condition_variable condProducer;
+    cond condProducer;
 };
 
 
 template<class T>
-BlockQueue<T>::BlockQueue(size_t maxCapacity) :capacity_(maxCapacity) 
+BlockQueue<T>::BlockQueue(size_t maxCapacity, const char* name) :capacity_(maxCapacity),
+    mtxQueue(name), condConsumer(name), condProducer(name)
 {
     assert(maxCapacity > 0);
     isClose = false;
@@ -82,89 +88,103 @@ template<class T>
 void BlockQueue<T>::close() 
 {
     {   
-        std::lock_guard<std::mutex> locker(mtx);
+        std::lock_guard<mtx> locker(mtxQueue);
         // queue不支持clear，但可以重新赋值
         queue = std::queue<T>();
         isClose = true;
     }
-    condProducer.notify_all();
-    condConsumer.notify_all();
+    condProducer.broadcast();
+    condConsumer.broadcast();
 }
 
 template<class T>
 void BlockQueue<T>::clear() 
 {
-    std::lock_guard<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     queue.clear();
 }
 
 template<class T>
 void BlockQueue<T>::flush() 
 {
-    condConsumer.notify_one();
+    condConsumer.signal();
 }
 
 template<class T>
 bool BlockQueue<T>::full()
 {
-    std::lock_guard<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     return queue.size() >= capacity_;
 }
 
 template<class T>
 bool BlockQueue<T>::empty() 
 {
-    std::lock_guard<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     return queue.empty();
 }
 
 template<class T>
 size_t BlockQueue<T>::size() 
 {
-    std::lock_guard<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     return queue.size();
 }
 
 template<class T>
 size_t BlockQueue<T>::capacity() 
 {
-    std::lock_guard<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     return capacity_;
 }
 
 template<class T>
 T BlockQueue<T>::front() 
 {
-    std::lock_guard<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     return queue.front();
 }
 
 template<class T>
 T BlockQueue<T>::back() 
 {
-    std::lock_guard<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     return queue.back();
 }
 
 template<class T>
 void BlockQueue<T>::push(const T &item) 
 {
-    std::unique_lock<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     while (queue.size() >= capacity_) 
     {
-        condProducer.wait(locker);
+        condProducer.wait(mtxQueue);
+    }
+    queue.push(item);
+    condConsumer.signal();
+}
+
+// 队列已满时不等待，直接返回 false
+template<class T>
+bool BlockQueue<T>::tryPush(const T &item) 
+{
+    std::lock_guard<mtx> locker(mtxQueue);
+    if (queue.size() >= capacity_) 
+    {
+        return false;
     }
     queue.push(item);
-    condConsumer.notify_one();
+    condConsumer.signal();
+    return true;
 }
 
 template<class T>
 bool BlockQueue<T>::pop(T &item) 
 {
-    std::unique_lock<std::mutex> locker(mtx);
+    std::lock_guard<mtx> locker(mtxQueue);
     while (queue.empty())
     {
-        condConsumer.wait(locker);
+        condConsumer.wait(mtxQueue);
         if (isClose) 
         {
             return false;
@@ -172,19 +192,22 @@ bool BlockQueue<T>::pop(T &item)
     }
     item = queue.front();
     queue.pop();
-    condProducer.notify_one();
+    condProducer.signal();
     return true;
 }
 
 template<class T>
 bool BlockQueue<T>::pop(T &item, int timeout) 
 {
-    std::unique_lock<std::mutex> locker(mtx);
+    // 最多等待 timeout 秒（cond 使用 CLOCK_REALTIME 的绝对时间）
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout;
+    std::lock_guard<mtx> locker(mtxQueue);
     while (queue.empty())
     {
-        // 判断等待时间是否超过 timeout
-        if (condConsumer.wait_for(locker, std::chrono::seconds(timeout)) 
-                == std::cv_status::timeout){
+        if (!condConsumer.timewait(mtxQueue, deadline))
+        {
             return false;
         }
         if (isClose) 
@@ -194,7 +217,7 @@ bool BlockQueue<T>::pop(T &item, int timeout)
     }
     item = queue.front();
     queue.pop();
-    condProducer.notify_one();
+    condProducer.signal();
     return true;
 }
 
@@ -1,31 +1,37 @@
 /* 
     同步/异步写日志
 
-    同步写日志：线程直接向文件内写入日志，写日志与线程业务是串行的
+    同步写日志：线程直接向文件内写入日志（包括切换分段），写日志与线程业务是串行的
     异步写日志：线程先将日志放到阻塞队列中，再使用专门的线程向文件内写日志
 
     为了避免日志混乱，需要用互斥锁实现文件的互斥访问，写日志前需要上锁。
 
     对于异步写日志：
         用单例模式维护一个阻塞队列，一个写线程，节约资源，减少竞态。
+        分段的创建、切换和清理都由写线程完成，生产者只负责格式化和入队，从不接触文件。
+        队列已满时丢弃这条日志并计数（dropped_log_lines_total），生产者不会等待写线程。
 
-    每次调用写日志方法后，或创建新日志文件前（日期改变，行数超限），都要调用flush将缓冲区内数据全部写入文件中。
-        如果是同步写日志，fflush(fp)；
-        如果是异步，还要先保证阻塞队列被清空。
+    日志按分段存储（见 logfile.h）：
+        日期改变，或当前分段写满（segmentSize），切换到新的分段；
+        设置了 maxSegments 时，日志目录内的分段数量超过它就删除最旧的分段（默认不删除）。
 */
 
 #include "log.h"
+#include "../metrics/alloctrack.h"
+#include "../metrics/metrics.h"
 
 using namespace std;
 
-Log::Log() 
+Log::Log(): mtxBuffer("log.buffer"), mtxFile("log.file")
 {
-    lineCount = 0;
     isAsync = false;
     writeThread = nullptr;
     queue = nullptr;
-    today = 0;
-    fp = nullptr;
+    segmentSize = 0;
+    maxSegments = 0;
+    segmentIndex = 0;
+    today[0] = '\0';
+    nextDay = 0;
 }
 
 Log::~Log() 
@@ -41,40 +47,56 @@ Log::~Log()
         // 回收写线程资源
         writeThread->join();
     }
-    // 缓存写入文件后再关闭指针
-    if (fp) 
-    {
-        lock_guard<mutex> locker(mtx);
-        flush();
-        fclose(fp);
-    }
+    // 截掉分段的预分配空间后再关闭
+    lock_guard<mtx> locker(mtxFile);
+    file.close();
 }
 
 int Log::getLevel() 
 {
-    lock_guard<mutex> locker(mtx);
+    lock_guard<mtx> locker(mtxBuffer);
     return this->level;
 }
 
 void Log::setLevel(int level) 
 {
-    lock_guard<mutex> locker(mtx);
+    lock_guard<mtx> locker(mtxBuffer);
     this->level = level;
 }
 
-// 初始化（阻塞队列，写线程，写缓冲区，日志文件指针）
+// 初始化（阻塞队列，写线程，写缓冲区，日志分段）
 void Log::init(int level = 1, const char* path, 
-    const char* suffix, int maxQueueSize) 
+    const char* suffix, int maxQueueSize,
+    size_t segmentSize, int maxSegments) 
 {
+    assert(segmentSize > 0);
     isOpen_ = true;
     this->level = level;
+    this->path = path;
+    this->suffix = suffix;
+    this->segmentSize = segmentSize;
+    this->maxSegments = maxSegments;
+
+    {
+        lock_guard<mtx> locker(mtxBuffer);
+        buffer.retrieveAll();
+    }
+
+    // 打开当天第一个未写满的分段
+    {
+        lock_guard<mtx> locker(mtxFile);
+        file.close();
+        today[0] = '\0';
+        openSegment(time(nullptr));
+    }
+
     if (maxQueueSize > 0)
     {
         isAsync = true;
         if (!queue)
         {
             // 初始化阻塞队列
-            unique_ptr<BlockQueue<std::string>> newQueue(new BlockQueue<std::string>);
+            unique_ptr<BlockQueue<std::string>> newQueue(new BlockQueue<std::string>(maxQueueSize, "log.queue"));
             queue = move(newQueue);
             // 初始化写日志线程
             std::unique_ptr<std::thread> NewThread(new thread(flushLogThread));
@@ -85,83 +107,22 @@ void Log::init(int level = 1, const char* path,
     {
         isAsync = false;
     }
-
-    lineCount = 0;
-    // 获取时间
-    time_t timer = time(nullptr);
-    struct tm *sysTime = localtime(&timer);
-    struct tm t = *sysTime;
-
-    // 初始化文件名
-    this->path = path;
-    this->suffix = suffix;
-    char fileName[LOG_NAME_LEN] = {0};
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", 
-            this->path, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, this->suffix);
-    today = t.tm_mday;
-
-    // 初始化文件指针
-    {
-        lock_guard<mutex> locker(mtx);
-        buffer.retrieveAll();
-        if (fp) 
-        { 
-            flush();
-            fclose(fp); 
-        }
-
-        fp = fopen(fileName, "a");
-        if (fp == nullptr) 
-        {
-            mkdir(this->path, 0777);
-            fp = fopen(fileName, "a");
-        } 
-        assert(fp != nullptr);
-    }
 }
 
 // 写日志
 void Log::write(int level, const char *format, ...) 
 {
+    ALLOC_SCOPE(ALLOC_LOG);
     struct timeval now = {0, 0};
     gettimeofday(&now, nullptr);
     time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
+    struct tm t;
+    localtime_r(&tSec, &t);
     va_list vaList;
 
-    // 日志日期改变，或者日志行数为最大行数的倍数，需要创建新的日志文件
-    if (today != t.tm_mday || (lineCount && (lineCount % MAX_LINES) == 0))
-    {
-        unique_lock<mutex> locker(mtx);
-        locker.unlock();
-        
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
-
-        if (today != t.tm_mday)
-        {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", this->path, tail, this->suffix);
-            today = t.tm_mday;
-            lineCount = 0;
-        }
-        else 
-        {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", this->path, tail, (lineCount  / MAX_LINES), this->suffix);
-        }
-        
-        locker.lock();
-        flush(); // 保证上一个日志已经写完
-        fclose(fp);
-        fp = fopen(newFile, "a");
-        assert(fp != nullptr);
-    }
-
-    // 向文件中互斥写日志
+    // 向缓冲区中互斥写日志
     {
-        unique_lock<mutex> locker(mtx);
-        lineCount ++;
+        lock_guard<mtx> locker(mtxBuffer);
         int n = snprintf(buffer.beginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
                     t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
@@ -173,23 +134,141 @@ void Log::write(int level, const char *format, ...)
         int m = vsnprintf(buffer.beginWrite(), buffer.writableBytes(), format, vaList);
         va_end(vaList);
 
+        // 超长的日志被截断
+        if (m >= (int)buffer.writableBytes()) 
+        {
+            m = buffer.writableBytes() - 1;
+        }
         buffer.hasWritten(m);
-        buffer.append("\n\0", 2);
+        buffer.append("\n", 1);
 
-        if (isAsync && queue && !queue->full()) 
+        if (isAsync && queue) 
         {
-            // 先将日志写入阻塞队列，之后再异步读写
-            queue->push(buffer.retrieveAllToStr());
+            // 先将日志写入阻塞队列，之后再异步读写；队列已满时丢弃，不等待写线程
+            if (!queue->tryPush(buffer.retrieveAllToStr()))
+            {
+                Metrics::add(CNT_LOG_DROPPED);
+            }
         } 
         else 
         {
             // 直接同步写日志
-            fputs(buffer.peek(), fp);
+            lock_guard<mtx> fileLocker(mtxFile);
+            appendToFile(buffer.peek(), buffer.readableBytes());
         }
         buffer.retrieveAll();
     }
 }
 
+// 追加到当前分段，日期改变或分段写满时切换分段（调用者持有 mtxFile）
+void Log::appendToFile(const char* data, size_t len)
+{
+    time_t now = time(nullptr);
+    if (!file.isOpen() || now >= nextDay)
+    {
+        openSegment(now);
+    }
+    // 保证一行日志不会跨越两个分段
+    if (len > file.writableBytes() && file.writtenBytes() > 0)
+    {
+        segmentIndex ++;
+        openSegment(now);
+    }
+    // 超过分段大小的单行日志被截断
+    file.append(data, len);
+}
+
+// 打开 segmentIndex 开始的第一个未写满的分段
+void Log::openSegment(time_t now)
+{
+    struct tm t;
+    localtime_r(&now, &t);
+    char date[36] = {0};
+    snprintf(date, sizeof(date), "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    if (strcmp(date, today) != 0)
+    {
+        // 日期改变（或重启），从当天已有的最后一个分段开始
+        strcpy(today, date);
+        segmentIndex = 0;
+        vector<pair<array<int, 4>, string>> segments;
+        listSegments(segments);
+        for (auto& segment : segments)
+        {
+            const array<int, 4>& key = segment.first;
+            if (key[0] == t.tm_year + 1900 && key[1] == t.tm_mon + 1 && key[2] == t.tm_mday)
+            {
+                segmentIndex = max(segmentIndex, key[3]);
+            }
+        }
+    }
+    // 下一次按日期切换的时间点
+    t.tm_mday ++;
+    t.tm_hour = t.tm_min = t.tm_sec = 0;
+    t.tm_isdst = -1;
+    nextDay = mktime(&t);
+
+    char fileName[LOG_NAME_LEN] = {0};
+    while (true)
+    {
+        if (segmentIndex == 0)
+        {
+            snprintf(fileName, LOG_NAME_LEN - 1, "%s/%s%s", path, today, suffix);
+        }
+        else
+        {
+            snprintf(fileName, LOG_NAME_LEN - 1, "%s/%s-%d%s", path, today, segmentIndex, suffix);
+        }
+        // 续写未写满的分段
+        if (LogFile::dataLength(fileName) < segmentSize) break;
+        segmentIndex ++;
+    }
+
+    if (!file.open(fileName, segmentSize))
+    {
+        mkdir(path, 0777);
+        file.open(fileName, segmentSize);
+    }
+    assert(file.isOpen());
+    removeOldSegments();
+}
+
+// 列出日志目录内的分段，按（年, 月, 日, 序号）排序
+void Log::listSegments(vector<pair<array<int, 4>, string>>& segments)
+{
+    DIR* dir = opendir(path);
+    if (!dir) return;
+
+    size_t suffixLen = strlen(suffix);
+    while (struct dirent* entry = readdir(dir))
+    {
+        const char* name = entry->d_name;
+        size_t nameLen = strlen(name);
+        if (nameLen <= suffixLen || strcmp(name + nameLen - suffixLen, suffix) != 0) continue;
+
+        array<int, 4> key = {{0, 0, 0, 0}};
+        int n = sscanf(name, "%4d_%2d_%2d-%d", &key[0], &key[1], &key[2], &key[3]);
+        if (n < 3) continue;
+        segments.emplace_back(key, name);
+    }
+    closedir(dir);
+    sort(segments.begin(), segments.end());
+}
+
+// 删除超出保留数量的最旧分段
+void Log::removeOldSegments()
+{
+    if (maxSegments <= 0) return;
+    vector<pair<array<int, 4>, string>> segments;
+    listSegments(segments);
+
+    char fileName[LOG_NAME_LEN] = {0};
+    for (size_t i = 0; i + maxSegments < segments.size(); i ++)
+    {
+        snprintf(fileName, LOG_NAME_LEN - 1, "%s/%s", path, segments[i].second.c_str());
+        unlink(fileName);
+    }
+}
+
 // 添加日志等级信息
 void Log::appendLogLevelTitle(int level)
 {
@@ -213,27 +292,26 @@ void Log::appendLogLevelTitle(int level)
     }
 }
 
-// 将缓存数据立即写入文件
+// 唤醒写线程处理队列内的日志
 void Log::flush() 
 {
     // 如果是异步，唤醒写日志线程，保证阻塞队列内的日志信息完全被清空
-    // 写日志线程通过加锁保证在队列清空前，文件指针不会被关闭
+    // 分段通过共享映射写入，数据已在页缓存中，不需要再刷新用户态缓冲区
     if (isAsync) 
     { 
         queue->flush(); 
     }
-    // 将缓存立即写入文件
-    fflush(fp);
 }
 
-// 异步写日志（每个日志完成前，将阻塞队列加锁，避免读写混乱）
+// 异步写日志（只持有 mtxFile，生产者可以同时格式化、入队）
 void Log::asyncWrite() 
 {
+    ALLOC_SCOPE(ALLOC_LOG);
     string str = "";
     while (queue->pop(str)) 
     {
-        lock_guard<mutex> locker(mtx);
-        fputs(str.c_str(), fp);
+        lock_guard<mtx> locker(mtxFile);
+        appendToFile(str.data(), str.size());
     }
 }
 
@@ -4,20 +4,29 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <dirent.h>
 #include <sys/time.h>
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
 #include <sys/stat.h>
 #include "blockqueue.h"
+#include "logfile.h"
 #include "../buffer/buffer.h"
+#include "../lock/locker.h"
 
 class Log {
 public:
-    // 日志等级，日志路径，日志后缀，异步日志队列最大长度
+    // 日志等级，日志路径，日志后缀，异步日志队列最大长度（0 表示同步写），分段大小，
+    // 保留的分段数量（0 表示不删除；大于 0 时目录内最旧的分段会被删除，包括之前运行留下的）
     void init(int level, const char* path = "./log", 
                 const char* suffix =".log",
-                int maxQueueCapacity = 1024);
+                int maxQueueCapacity = 1024,
+                size_t segmentSize = 16 * 1024 * 1024,
+                int maxSegments = 0);
 
     static Log* instance();
     static void flushLogThread();
@@ -28,6 +37,10 @@ public:
     int getLevel();
     void setLevel(int level);
     bool isOpen() { return isOpen_; }
+    // 异步队列中等待写入的日志条数
+    size_t queueSize() { return (isAsync && queue) ? queue->size() : 0; }
+    // 异步写线程，同步写日志时为 nullptr（用于绑定 CPU）
+    std::thread* getWriteThread() { return writeThread.get(); }
     
 private:
     Log();
@@ -35,16 +48,23 @@ private:
     virtual ~Log();
     void asyncWrite();
 
+    void appendToFile(const char* data, size_t len);
+    void openSegment(time_t now);
+    void removeOldSegments();
+    void listSegments(std::vector<std::pair<std::array<int, 4>, std::string>>& segments);
+
 private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
-    static const int MAX_LINES = 50000;
 
     const char* path;
     const char* suffix;
 
-    int lineCount;
-    int today;
+    size_t segmentSize; // 分段大小，写满后切换到下一个分段
+    int maxSegments;    // 日志目录内最多保留的分段数量
+    int segmentIndex;   // 当天的分段序号
+    char today[36];     // 当前分段的日期
+    time_t nextDay;     // 下一次按日期切换的时间点
 
     bool isOpen_;
  
@@ -52,10 +72,11 @@ private:
     int level;
     bool isAsync;
 
-    FILE* fp;
+    LogFile file;
     std::unique_ptr<BlockQueue<std::string>> queue; 
     std::unique_ptr<std::thread> writeThread;
-    std::mutex mtx;
+    mtx mtxBuffer;      // 保护格式化缓冲区和日志等级
+    mtx mtxFile;        // 保护日志分段（异步时只有写线程使用）
 };
 
 // 日志等级level要给定
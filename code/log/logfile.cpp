@@ -0,0 +1,132 @@
+#include "logfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+LogFile::LogFile()
+{
+    fd = -1;
+    base = nullptr;
+    capacity = 0;
+    offset = 0;
+}
+
+LogFile::~LogFile()
+{
+    close();
+}
+
+bool LogFile::open(const char* fileName, size_t capacity)
+{
+    close();
+    size_t used = dataLength(fileName);
+    fd = ::open(fileName, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    // 已有数据超过分段大小时，按实际长度续写
+    if (capacity < used)
+    {
+        capacity = used;
+    }
+    this->capacity = capacity;
+    this->offset = used;
+
+    // 去掉上次崩溃留下的 '\0' 尾部，再预分配整个分段
+    if (ftruncate(fd, used) < 0 ||
+        (fallocate(fd, 0, 0, capacity) < 0 && ftruncate(fd, capacity) < 0))
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    void* addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        // 无法映射，退化为按偏移写入（先去掉预分配的空间，否则追加在 '\0' 之后）
+        base = nullptr;
+        if (ftruncate(fd, used) < 0)
+        {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+    }
+    else
+    {
+        base = static_cast<char*>(addr);
+    }
+    return true;
+}
+
+void LogFile::close()
+{
+    if (fd < 0) return;
+    if (base)
+    {
+        munmap(base, capacity);
+        base = nullptr;
+        // 截掉未使用的预分配空间；失败时留下的 '\0' 尾部在下次打开时由 dataLength 去掉
+        // （不能通过 Log 记录，调用者可能正持有日志的锁）
+        if (ftruncate(fd, offset) < 0)
+        {
+            fprintf(stderr, "LogFile: truncate log segment to %zu bytes error: %s\n", offset, strerror(errno));
+        }
+    }
+    ::close(fd);
+    fd = -1;
+    capacity = offset = 0;
+}
+
+size_t LogFile::append(const char* data, size_t len)
+{
+    if (fd < 0) return 0;
+    if (len > capacity - offset)
+    {
+        len = capacity - offset;
+    }
+    if (base)
+    {
+        memcpy(base + offset, data, len);
+    }
+    else
+    {
+        ssize_t n = pwrite(fd, data, len, offset);
+        if (n < 0) return 0;
+        len = n;
+    }
+    offset += len;
+    return len;
+}
+
+size_t LogFile::dataLength(const char* fileName)
+{
+    int srcFd = ::open(fileName, O_RDONLY | O_CLOEXEC);
+    if (srcFd < 0) return 0;
+    struct stat st;
+    if (fstat(srcFd, &st) < 0 || st.st_size == 0)
+    {
+        ::close(srcFd);
+        return 0;
+    }
+    size_t len = st.st_size;
+    void* addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, srcFd, 0);
+    ::close(srcFd);
+    if (addr == MAP_FAILED) return len;
+
+    // 从尾部向前跳过预分配的 '\0'
+    const char* data = static_cast<const char*>(addr);
+    while (len > 0 && data[len - 1] == '\0')
+    {
+        len --;
+    }
+    munmap(addr, st.st_size);
+    return len;
+}
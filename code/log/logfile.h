@@ -0,0 +1,46 @@
+/*
+    日志分段文件
+
+    每个分段创建时先用 fallocate 预分配固定大小的磁盘空间，再用 mmap(MAP_SHARED) 映射整个分段，
+    追加日志只是一次 memcpy，不经过 stdio 缓冲，也不需要每行一次系统调用。
+
+    崩溃安全：写入映射区的数据直接进入页缓存，进程异常退出也不会丢失已写入的日志行。
+    预分配的尾部全是 '\0'，正常关闭时 ftruncate 到实际长度；崩溃留下的分段在下次打开时
+    从尾部向前找到最后一个非 '\0' 字节，恢复实际长度。
+
+    文件系统不支持 mmap 时，退化为按偏移 pwrite 写入（offset 即文件的实际长度）。
+*/
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+class LogFile
+{
+public:
+    LogFile();
+    ~LogFile();
+
+    // 打开（或续写）分段文件，预分配 capacity 字节
+    bool open(const char* fileName, size_t capacity);
+    void close();
+
+    // 追加数据，返回实际写入的字节数（空间不足时只写入能容纳的部分）
+    size_t append(const char* data, size_t len);
+
+    size_t writtenBytes() const { return offset; }
+    size_t writableBytes() const { return capacity - offset; }
+    bool isOpen() const { return fd >= 0; }
+
+    // 计算已有文件的实际日志长度（忽略预分配的 '\0' 尾部）
+    static size_t dataLength(const char* fileName);
+
+private:
+    int fd;          // 文件描述符
+    char* base;      // 映射区起始地址，nullptr 表示 pwrite 模式
+    size_t capacity; // 分段容量
+    size_t offset;   // 已写入的长度
+};
+
+#endif
@@ -19,10 +19,19 @@
 */
 int main() {
 
+    // 扩展配置，未修改的字段使用默认值
+    Config config;
+    // config.userStore = USER_STORE_LOCAL; // 只需要登录、注册时，可以不依赖 MySQL
+    config.sqlMinConn = 4;          // 数据库连接池最少保持4个连接
+    config.sqlWaitTimeoutMs = 500;  // 获取数据库连接最多等待500ms
+    // 只读副本（可选）：登录查询发往副本，注册发往主库
+    // config.sqlReplicas.push_back({"replica1", "127.0.0.1", 3307});
+
     WebServer server(
         8081, 3, 60000, false,             // 客户端监听端口，ET触发模式，连接计时1分钟，优雅退出
         3306, "root", "root", "webserver", // MySQL配置：监听端口，用户名，密码，数据库名
-        12, 6, 10000, true, 0, 1024);      // 数据库连接池数量，线程池数量，最大连接数，日志开关，日志等级，日志异步队列容量
+        12, 6, 10000, true, 0, 1024,       // 数据库连接池数量，线程池数量，最大连接数，日志开关，日志等级，日志异步队列容量
+        config);
 
     server.start();
 }
@@ -0,0 +1,203 @@
+#ifdef ALLOC_TRACK
+
+#include "alloctrack.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <new>
+#include <atomic>
+
+using namespace std;
+
+/*
+    计数器在静态存储区中常量初始化，main 之前的分配也能安全地记录。
+    每块内存前加 16 字节的头（保持 malloc 的 16 字节对齐），保存大小和分配时的标签。
+*/
+struct AllocCounter
+{
+    atomic<uint64_t> allocs;
+    atomic<uint64_t> bytes;
+    atomic<uint64_t> frees;
+    atomic<int64_t> liveBytes;
+    atomic<int64_t> peakBytes;
+};
+
+static AllocCounter counters[ALLOC_TAG_NUM];
+
+struct AllocHeader
+{
+    uint64_t size;
+    uint64_t tag;
+};
+
+static_assert(sizeof(AllocHeader) == 16, "keep malloc alignment");
+
+static const char* TAG_NAME[ALLOC_TAG_NUM] =
+{
+    "other", "buffer", "http_request", "http_response", "connection",
+    "log", "timer", "threadpool", "session", "userstore", "metrics",
+};
+
+static void* trackedAlloc(size_t size)
+{
+    AllocHeader* header = (AllocHeader*)malloc(sizeof(AllocHeader) + size);
+    if (!header) return nullptr;
+    int tag = AllocScope::current();
+    header->size = size;
+    header->tag = tag;
+    AllocCounter& c = counters[tag];
+    c.allocs.fetch_add(1, memory_order_relaxed);
+    c.bytes.fetch_add(size, memory_order_relaxed);
+    int64_t live = c.liveBytes.fetch_add(size, memory_order_relaxed) + size;
+    int64_t peak = c.peakBytes.load(memory_order_relaxed);
+    while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+    return header + 1;
+}
+
+static void trackedFree(void* p)
+{
+    if (!p) return;
+    AllocHeader* header = (AllocHeader*)p - 1;
+    AllocCounter& c = counters[header->tag];
+    c.frees.fetch_add(1, memory_order_relaxed);
+    c.liveBytes.fetch_sub(header->size, memory_order_relaxed);
+    free(header);
+}
+
+// 所有（非对齐版本的）分配、释放函数都要替换，保证经过 trackedAlloc 的内存只由 trackedFree 释放
+void* operator new(size_t size)
+{
+    void* p = trackedAlloc(size);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+    return trackedAlloc(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+    return trackedAlloc(size);
+}
+
+void operator delete(void* p) noexcept { trackedFree(p); }
+void operator delete[](void* p) noexcept { trackedFree(p); }
+void operator delete(void* p, size_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, size_t) noexcept { trackedFree(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { trackedFree(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { trackedFree(p); }
+
+AllocTracker::AllocTracker(): lastNs(Metrics::now())
+{
+    snapshot(last);
+}
+
+AllocTracker* AllocTracker::instance()
+{
+    static AllocTracker tracker;
+    return &tracker;
+}
+
+const char* AllocTracker::tagName(int tag)
+{
+    return TAG_NAME[tag];
+}
+
+void AllocTracker::snapshot(AllocStats stats[ALLOC_TAG_NUM])
+{
+    for (int i = 0; i < ALLOC_TAG_NUM; i ++)
+    {
+        stats[i].allocs = counters[i].allocs.load(memory_order_relaxed);
+        stats[i].bytes = counters[i].bytes.load(memory_order_relaxed);
+        stats[i].frees = counters[i].frees.load(memory_order_relaxed);
+        stats[i].liveBytes = counters[i].liveBytes.load(memory_order_relaxed);
+        stats[i].peakBytes = counters[i].peakBytes.load(memory_order_relaxed);
+    }
+}
+
+size_t AllocTracker::rssBytes()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp) return 0;
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(fp, "%lu %lu", &size, &resident);
+    fclose(fp);
+    return n == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+string AllocTracker::exposition()
+{
+    AllocStats stats[ALLOC_TAG_NUM];
+    snapshot(stats);
+    struct Field
+    {
+        const char* name;
+        const char* help;
+        const char* type;
+    };
+    const Field FIELDS[] = {
+        {"webserver_alloc_total", "Heap allocations through operator new.", "counter"},
+        {"webserver_alloc_bytes_total", "Bytes allocated through operator new.", "counter"},
+        {"webserver_free_total", "Heap blocks freed through operator delete.", "counter"},
+        {"webserver_alloc_live_bytes", "Bytes currently allocated.", "gauge"},
+        {"webserver_alloc_peak_bytes", "Peak of live bytes.", "gauge"},
+    };
+    string out;
+    char line[160];
+    for (int f = 0; f < 5; f ++)
+    {
+        out += string("# HELP ") + FIELDS[f].name + " " + FIELDS[f].help + "\n";
+        out += string("# TYPE ") + FIELDS[f].name + " " + FIELDS[f].type + "\n";
+        for (int i = 0; i < ALLOC_TAG_NUM; i ++)
+        {
+            const AllocStats& s = stats[i];
+            long long value = f == 0 ? (long long)s.allocs : f == 1 ? (long long)s.bytes :
+                              f == 2 ? (long long)s.frees : f == 3 ? s.liveBytes : s.peakBytes;
+            snprintf(line, sizeof(line), "%s{subsystem=\"%s\"} %lld\n", FIELDS[f].name, TAG_NAME[i], value);
+            out += line;
+        }
+    }
+    snprintf(line, sizeof(line), "# HELP webserver_rss_bytes Resident set size.\n"
+             "# TYPE webserver_rss_bytes gauge\nwebserver_rss_bytes %zu\n", rssBytes());
+    out += line;
+    return out;
+}
+
+vector<string> AllocTracker::report()
+{
+    AllocStats stats[ALLOC_TAG_NUM];
+    snapshot(stats);
+    uint64_t now = Metrics::now();
+    double seconds = now > lastNs ? (now - lastNs) / 1e9 : 1;
+
+    vector<string> lines;
+    char line[256];
+    int64_t live = 0;
+    for (int i = 0; i < ALLOC_TAG_NUM; i ++) live += stats[i].liveBytes;
+    snprintf(line, sizeof(line), "tracked live %.2f MB, RSS %.2f MB", live / 1048576.0, rssBytes() / 1048576.0);
+    lines.push_back(line);
+    for (int i = 0; i < ALLOC_TAG_NUM; i ++)
+    {
+        const AllocStats& s = stats[i];
+        if (s.allocs == 0) continue;
+        snprintf(line, sizeof(line),
+                 "%-14s live %9.3f MB (%8lld blocks), peak %9.3f MB, %9.0f allocs/s, %8.3f MB/s",
+                 TAG_NAME[i], s.liveBytes / 1048576.0, (long long)(s.allocs - s.frees), s.peakBytes / 1048576.0,
+                 (s.allocs - last[i].allocs) / seconds, (s.bytes - last[i].bytes) / seconds / 1048576.0);
+        lines.push_back(line);
+    }
+    for (int i = 0; i < ALLOC_TAG_NUM; i ++) last[i] = stats[i];
+    lastNs = now;
+    return lines;
+}
+
+#endif
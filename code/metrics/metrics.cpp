@@ -0,0 +1,206 @@
+#include "metrics.h"
+#include "alloctrack.h"
+
+#include <stdio.h>
+
+using namespace std;
+
+atomic<bool> Metrics::enabled(true);
+
+// 指标名及说明，顺序与枚举相同
+static const char* COUNTER_NAME[][2] =
+{
+    {"accepted_connections_total", "Accepted client connections."},
+    {"closed_connections_total", "Closed client connections."},
+    {"requests_total", "Completely parsed requests."},
+    {"bad_requests_total", "Malformed requests."},
+    {"responses_2xx_total", "Responses with 2xx status."},
+    {"responses_4xx_total", "Responses with 4xx status."},
+    {"responses_5xx_total", "Responses with 5xx status."},
+    {"written_bytes_total", "Bytes written to clients."},
+    {"dropped_tasks_total", "Tasks dropped because a thread pool queue was full."},
+    {"loop_slow_callbacks_total", "Event handlers or timer callbacks on the main loop over the slow threshold."},
+    {"loop_slow_iterations_total", "Main loop iterations over the slow threshold."},
+    {"loop_poll_spin_hits_total", "Event loop waits satisfied while busy polling."},
+    {"loop_poll_blocks_total", "Event loop waits that blocked after the busy poll budget ran out."},
+    {"inline_responses_total", "Responses sent directly on the event loop (hybrid execution)."},
+    {"offloaded_responses_total", "Responses sent by the worker pool: large, not cached, or following one that was (hybrid execution)."},
+    {"dropped_log_lines_total", "Log lines dropped because the async log queue was full."},
+};
+
+static const char* HISTOGRAM_NAME[][2] =
+{
+    {"queue_wait_seconds", "Time a request task waits in the thread pool queue."},
+    {"sql_queue_wait_seconds", "Time a login/register task waits in the SQL thread pool queue."},
+    {"parse_seconds", "Time to parse a request."},
+    {"file_lookup_seconds", "Time to stat and map the resource and build response headers."},
+    {"write_seconds", "Time spent in one write of a response."},
+    {"verify_seconds", "Time to verify a login or register."},
+    {"loop_busy_seconds", "Main loop iteration time excluding epoll_wait."},
+    {"loop_wait_seconds", "Time the main loop spends in one epoll_wait."},
+    {"loop_timers_seconds", "Time the main loop spends running expired timers in one iteration."},
+    {"loop_dispatch_seconds", "Time the main loop spends dispatching events in one iteration."},
+    {"loop_callback_seconds", "Time of a single event handler or timer callback on the main loop."},
+    {"timer_lag_seconds", "How late a timer callback runs after its expiry."},
+};
+
+static const char* PREFIX = "webserver_";
+
+Metrics* Metrics::instance()
+{
+    static Metrics metrics;
+    return &metrics;
+}
+
+// 当前线程的指标，第一次使用时分配并登记
+Metrics::ThreadMetrics* Metrics::local()
+{
+    ALLOC_SCOPE(ALLOC_METRICS);
+    static thread_local ThreadMetrics* metrics = nullptr;
+    if (!metrics)
+    {
+        Metrics* global = instance();
+        unique_ptr<ThreadMetrics> block(new ThreadMetrics());
+        metrics = block.get();
+        lock_guard<mutex> locker(global->mtx);
+        global->threads.push_back(move(block));
+    }
+    return metrics;
+}
+
+void Metrics::addGauge(const string& name, const string& help, function<double()> read)
+{
+    lock_guard<mutex> locker(mtx);
+    gauges.push_back({name, help, read});
+}
+
+void Metrics::addSection(function<string()> read)
+{
+    lock_guard<mutex> locker(mtx);
+    sections.push_back(read);
+}
+
+uint64_t Metrics::getCounter(METRIC_COUNTER counter)
+{
+    lock_guard<mutex> locker(mtx);
+    uint64_t sum = 0;
+    for (auto& t : threads)
+    {
+        sum += t->counters[counter].load(memory_order_relaxed);
+    }
+    return sum;
+}
+
+void Metrics::getHistogram(METRIC_HISTOGRAM histogram, HistogramSnapshot& snapshot)
+{
+    snapshot = HistogramSnapshot();
+    lock_guard<mutex> locker(mtx);
+    for (auto& t : threads)
+    {
+        const Histogram& h = t->histograms[histogram];
+        for (int i = 0; i < Histogram::BUCKET_NUM; i ++)
+        {
+            snapshot.buckets[i] += h.buckets[i].load(memory_order_relaxed);
+        }
+        snapshot.count += h.count.load(memory_order_relaxed);
+        snapshot.sum += h.sum.load(memory_order_relaxed);
+    }
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const
+{
+    // 各桶分别读取，总数以桶的和为准
+    uint64_t total = 0;
+    for (int i = 0; i < Histogram::BUCKET_NUM; i ++) total += buckets[i];
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(p * total);
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < Histogram::BUCKET_NUM; i ++)
+    {
+        seen += buckets[i];
+        if (seen > rank) return Histogram::upperBound(i);
+    }
+    return Histogram::upperBound(Histogram::BUCKET_NUM - 1);
+}
+
+static void appendHeader(string& out, const string& name, const char* help, const char* type)
+{
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+static void appendValue(string& out, const string& name, double value)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), " %.9g\n", value);
+    out += name;
+    out += buf;
+}
+
+/*
+    Prometheus 文本格式（version 0.0.4）
+    直方图按 2 的幂纳秒输出累计桶（1us ~ 16s），另外输出常用分位数的仪表，便于直接查看。
+*/
+string Metrics::exposition()
+{
+    ALLOC_SCOPE(ALLOC_METRICS);
+    string out;
+    out.reserve(16384);
+
+    for (int c = 0; c < COUNTER_NUM; c ++)
+    {
+        string name = string(PREFIX) + COUNTER_NAME[c][0];
+        appendHeader(out, name, COUNTER_NAME[c][1], "counter");
+        appendValue(out, name, (double)getCounter((METRIC_COUNTER)c));
+    }
+
+    HistogramSnapshot snapshot;
+    for (int h = 0; h < HISTOGRAM_NUM; h ++)
+    {
+        getHistogram((METRIC_HISTOGRAM)h, snapshot);
+        string name = string(PREFIX) + HISTOGRAM_NAME[h][0];
+        appendHeader(out, name, HISTOGRAM_NAME[h][1], "histogram");
+
+        uint64_t cumulative = 0;
+        int i = 0;
+        for (int bits = 10; bits <= 34; bits ++)
+        {
+            uint64_t bound = 1ull << bits;
+            while (i < Histogram::BUCKET_NUM && Histogram::upperBound(i) <= bound)
+            {
+                cumulative += snapshot.buckets[i ++];
+            }
+            char le[32];
+            snprintf(le, sizeof(le), "%.9g", bound / 1e9);
+            appendValue(out, name + "_bucket{le=\"" + le + "\"}", (double)cumulative);
+        }
+        while (i < Histogram::BUCKET_NUM) cumulative += snapshot.buckets[i ++];
+        appendValue(out, name + "_bucket{le=\"+Inf\"}", (double)cumulative);
+        appendValue(out, name + "_sum", snapshot.sum / 1e9);
+        appendValue(out, name + "_count", (double)cumulative);
+
+        string quantile = name.substr(0, name.size() - 8) + "_quantile_seconds";
+        appendHeader(out, quantile, HISTOGRAM_NAME[h][1], "gauge");
+        const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+        for (double q : QUANTILES)
+        {
+            char label[48];
+            snprintf(label, sizeof(label), "{quantile=\"%g\"}", q);
+            appendValue(out, quantile + label, snapshot.percentile(q) / 1e9);
+        }
+    }
+
+    lock_guard<mutex> locker(mtx);
+    for (Gauge& gauge : gauges)
+    {
+        string name = PREFIX + gauge.name;
+        appendHeader(out, name, gauge.help.c_str(), "gauge");
+        appendValue(out, name, gauge.read());
+    }
+    for (auto& section : sections)
+    {
+        out += section();
+    }
+    return out;
+}
@@ -0,0 +1,204 @@
+/*
+    运行指标
+
+    计数器和延迟直方图按线程保存：每个线程第一次记录时分配自己的一组指标，之后只有这个线程写入，
+    写入是普通的原子读 + 原子写（relaxed），没有锁，也没有原子的读改写指令，线程之间不共享缓存行。
+    读取（/metrics）时遍历所有线程的指标求和，读到的是近似一致的快照。
+
+    直方图类似 HdrHistogram：按数量级（2 的幂）分段，每段再等分为 8 个子桶，相对误差不超过 12.5%，
+    记录一次只是计算下标和两次加法，范围 1ns 到约 4.9 小时。
+
+    仪表（gauge）是读取时调用的回调，例如当前连接数、任务队列长度，由各模块在启动时注册。
+*/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+
+using namespace std;
+
+// 计数器
+enum METRIC_COUNTER
+{
+    CNT_ACCEPT = 0,    // 接受的连接
+    CNT_CLOSE,         // 关闭的连接
+    CNT_REQUEST,       // 解析完成的请求
+    CNT_BAD_REQUEST,   // 格式错误的请求
+    CNT_RESPONSE_2XX,  // 各类响应状态码
+    CNT_RESPONSE_4XX,
+    CNT_RESPONSE_5XX,
+    CNT_BYTES_WRITTEN, // 发送的字节数
+    CNT_TASK_DROPPED,  // 任务队列已满被丢弃的任务
+    CNT_SLOW_CALLBACK, // 主循环中超过阈值的事件处理、定时器回调
+    CNT_SLOW_ITERATION, // 超过阈值的主循环迭代
+    CNT_POLL_SPIN_HIT, // 忙轮询期间等到事件，不需要阻塞
+    CNT_POLL_BLOCK,    // 忙轮询期间没有事件，转为阻塞等待
+    CNT_INLINE_RESPONSE,  // 混合模式下在事件循环中直接发送的响应
+    CNT_OFFLOAD_RESPONSE, // 混合模式下交给请求线程池发送的响应
+    CNT_LOG_DROPPED,   // 异步日志队列已满被丢弃的日志
+    COUNTER_NUM
+};
+
+// 延迟直方图（纳秒）
+enum METRIC_HISTOGRAM
+{
+    HIST_QUEUE_WAIT = 0, // 任务在请求线程池队列中的等待时间
+    HIST_SQL_QUEUE_WAIT, // 任务在数据库线程池队列中的等待时间
+    HIST_PARSE,          // 解析请求
+    HIST_FILE_LOOKUP,    // 查找并映射资源文件，生成响应头
+    HIST_WRITE,          // 一次发送响应
+    HIST_VERIFY,         // 登录、注册的验证
+    HIST_LOOP_BUSY,      // 主循环一次迭代除 epoll_wait 以外的时间
+    HIST_LOOP_WAIT,      // 主循环一次 epoll_wait
+    HIST_LOOP_TIMERS,    // 主循环一次迭代中处理到期定时器的时间
+    HIST_LOOP_DISPATCH,  // 主循环一次迭代中分发事件的时间
+    HIST_LOOP_CALLBACK,  // 主循环中单个事件处理或定时器回调
+    HIST_TIMER_LAG,      // 定时器回调相对到期时间的延迟
+    HISTOGRAM_NUM
+};
+
+class Histogram
+{
+public:
+    static const int SUB_BITS = 3;                 // 每个数量级分为 2^3 个子桶
+    static const int SUB_NUM = 1 << SUB_BITS;
+    static const int MAX_BITS = 44;                // 最大记录 2^44 ns
+    static const int BUCKET_NUM = (MAX_BITS - SUB_BITS + 1) * SUB_NUM;
+
+    // 只由所属线程调用
+    void record(uint64_t value)
+    {
+        add(buckets[index(value)], 1);
+        add(count, 1);
+        add(sum, value);
+    }
+
+    // 下标 i 的桶的上界（不含）
+    static uint64_t upperBound(int i)
+    {
+        if (i < SUB_NUM) return i + 1;
+        int shift = i / SUB_NUM - 1;
+        return (uint64_t)(SUB_NUM + i % SUB_NUM + 1) << shift;
+    }
+
+    static int index(uint64_t value)
+    {
+        if (value < (uint64_t)SUB_NUM) return (int)value;
+        int msb = 63 - __builtin_clzll(value);
+        if (msb >= MAX_BITS) return BUCKET_NUM - 1;
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_NUM + (int)((value >> shift) & (SUB_NUM - 1));
+    }
+
+    atomic<uint64_t> buckets[BUCKET_NUM] = {};
+    atomic<uint64_t> count{0};
+    atomic<uint64_t> sum{0};
+
+private:
+    static void add(atomic<uint64_t>& x, uint64_t n)
+    {
+        x.store(x.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+};
+
+// 合并后的直方图
+struct HistogramSnapshot
+{
+    uint64_t buckets[Histogram::BUCKET_NUM] = {};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    // 分位数（0~1），返回所在桶的上界
+    uint64_t percentile(double p) const;
+};
+
+class Metrics
+{
+public:
+    static Metrics* instance();
+
+    // 运行时开关，关闭后记录函数直接返回（用于测量指标本身的开销）
+    static atomic<bool> enabled;
+
+    static void add(METRIC_COUNTER counter, uint64_t n = 1)
+    {
+        if (!enabled.load(memory_order_relaxed)) return;
+        atomic<uint64_t>& x = local()->counters[counter];
+        x.store(x.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+
+    static void record(METRIC_HISTOGRAM histogram, uint64_t ns)
+    {
+        if (!enabled.load(memory_order_relaxed)) return;
+        local()->histograms[histogram].record(ns);
+    }
+
+    // 单调时钟（纳秒）
+    static uint64_t now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 注册仪表，读取时调用 read
+    void addGauge(const string& name, const string& help, function<double()> read);
+
+    // 注册额外的一段指标（已是 Prometheus 文本格式），追加在输出的最后
+    void addSection(function<string()> read);
+
+    uint64_t getCounter(METRIC_COUNTER counter);
+    void getHistogram(METRIC_HISTOGRAM histogram, HistogramSnapshot& snapshot);
+
+    // Prometheus 文本格式
+    string exposition();
+
+private:
+    Metrics() = default;
+    ~Metrics() = default;
+
+    struct ThreadMetrics
+    {
+        atomic<uint64_t> counters[COUNTER_NUM] = {};
+        Histogram histograms[HISTOGRAM_NUM];
+    };
+
+    struct Gauge
+    {
+        string name;
+        string help;
+        function<double()> read;
+    };
+
+    static ThreadMetrics* local();
+
+    mutex mtx;
+    vector<unique_ptr<ThreadMetrics>> threads; // 所有线程的指标（线程退出后保留，计数不丢失）
+    vector<Gauge> gauges;
+    vector<function<string()>> sections;
+};
+
+// RAII 计时，析构时记录经过的时间
+class MetricTimer
+{
+public:
+    explicit MetricTimer(METRIC_HISTOGRAM histogram):
+        histogram(histogram), start(Metrics::enabled.load(memory_order_relaxed) ? Metrics::now() : 0) {}
+
+    ~MetricTimer()
+    {
+        if (start) Metrics::record(histogram, Metrics::now() - start);
+    }
+
+private:
+    METRIC_HISTOGRAM histogram;
+    uint64_t start;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "statsshm.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+const char* STAT_NAME[STAT_NUM] =
+{
+    "connections", "queue_length", "sql_queue_length", "timers", "log_queue",
+    "sql_free", "sql_used", "sessions", "accepted", "requests", "bytes_written", "responses_5xx"
+};
+
+StatsShm::StatsShm()
+{
+    data = nullptr;
+    owner = false;
+}
+
+StatsShm::~StatsShm()
+{
+    close();
+}
+
+string StatsShm::nameOf(int port)
+{
+    return "/webserver." + to_string(port);
+}
+
+bool StatsShm::create(const string& name, int workerCnt, int sqlWorkerCnt, int intervalMs)
+{
+    close();
+    // 上次异常退出留下的段直接删除，重新创建
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, sizeof(StatsShmData)) < 0)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* addr = mmap(nullptr, sizeof(StatsShmData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // ftruncate 得到的内存全是 0，原子变量的初始值即为 0
+    data = static_cast<StatsShmData*>(addr);
+    data->pid = getpid();
+    data->workerCnt = workerCnt;
+    data->sqlWorkerCnt = sqlWorkerCnt;
+    data->intervalMs = intervalMs;
+    data->version = StatsShmData::VERSION;
+    // 魔数最后写入，读者看到魔数时其他字段已经就绪
+    atomic_thread_fence(memory_order_release);
+    data->magic = StatsShmData::MAGIC;
+    this->name = name;
+    owner = true;
+    return true;
+}
+
+void StatsShm::beginWrite()
+{
+    data->seq.store(data->seq.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    // 序号变为奇数之后才能写字段
+    atomic_thread_fence(memory_order_release);
+}
+
+void StatsShm::endWrite()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    data->updateNs.store((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec, memory_order_relaxed);
+    // 字段写完之后序号才变为偶数
+    data->seq.store(data->seq.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+bool StatsShm::open(const string& name)
+{
+    close();
+    int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(StatsShmData))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* addr = mmap(nullptr, sizeof(StatsShmData), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return false;
+    data = static_cast<StatsShmData*>(addr);
+    if (data->magic != StatsShmData::MAGIC || data->version != StatsShmData::VERSION)
+    {
+        close();
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    this->name = name;
+    owner = false;
+    return true;
+}
+
+bool StatsShm::read(StatsSnapshot& snapshot)
+{
+    if (!data) return false;
+    for (int retry = 0; retry < 1000; retry ++)
+    {
+        uint64_t seq = data->seq.load(memory_order_acquire);
+        if (seq & 1)
+        {
+            sched_yield();
+            continue;
+        }
+        snapshot.pid = data->pid;
+        snapshot.workerCnt = data->workerCnt;
+        snapshot.sqlWorkerCnt = data->sqlWorkerCnt;
+        snapshot.intervalMs = data->intervalMs;
+        snapshot.updateNs = data->updateNs.load(memory_order_relaxed);
+        for (int i = 0; i < STAT_NUM; i ++)
+        {
+            snapshot.values[i] = data->values[i].load(memory_order_relaxed);
+        }
+        for (int i = 0; i < StatsShmData::MAX_WORKERS; i ++)
+        {
+            snapshot.busyNs[i] = data->busyNs[i].load(memory_order_relaxed);
+        }
+        // 字段读完之后再检查序号
+        atomic_thread_fence(memory_order_acquire);
+        if (data->seq.load(memory_order_relaxed) == seq) return true;
+    }
+    return false;
+}
+
+void StatsShm::close()
+{
+    if (!data) return;
+    munmap(data, sizeof(StatsShmData));
+    data = nullptr;
+    if (owner) shm_unlink(name.c_str());
+    owner = false;
+}
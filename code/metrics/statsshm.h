@@ -0,0 +1,106 @@
+/*
+    共享内存统计段
+
+    服务器把实时状态（连接数、队列长度、各工作线程的忙碌时间、定时器数量、日志队列长度、连接池空闲数等）
+    周期性地写入 POSIX 共享内存（/dev/shm/webserver.<端口>），webserver-top 直接映射读取，
+    不经过服务器的套接字，服务器过载、不再响应 HTTP 请求时也能查看。
+
+    一致性由顺序锁（seqlock）保证：
+        写者（主线程）写之前把序号加一（奇数表示正在写），写完再加一；
+        读者先读序号，复制全部字段，再读一次序号，两次相同且为偶数时快照有效，否则重试。
+    读者只读映射，不会阻塞写者。字段都是无锁的 64 位原子变量，可以放在进程间共享的内存中。
+*/
+#ifndef STATSSHM_H
+#define STATSSHM_H
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+using namespace std;
+
+// 统计项，顺序与 STAT_NAME 相同
+enum STAT_FIELD
+{
+    STAT_CONNECTIONS = 0, // 当前连接数
+    STAT_QUEUE_LENGTH,    // 请求线程池的任务队列长度
+    STAT_SQL_QUEUE_LENGTH,// 数据库线程池的任务队列长度
+    STAT_TIMER_SIZE,      // 定时器数量
+    STAT_LOG_QUEUE,       // 异步日志队列长度
+    STAT_SQL_FREE,        // 主库连接池的空闲连接数
+    STAT_SQL_USED,        // 主库连接池正在使用的连接数
+    STAT_SESSIONS,        // 会话数
+    STAT_ACCEPTED,        // 累计接受的连接
+    STAT_REQUESTS,        // 累计请求数
+    STAT_BYTES_WRITTEN,   // 累计发送字节数
+    STAT_RESPONSE_5XX,    // 累计 5xx 响应
+    STAT_NUM
+};
+
+extern const char* STAT_NAME[STAT_NUM];
+
+struct StatsShmData
+{
+    static const uint32_t MAGIC = 0x57535453; // "WSTS"
+    static const uint32_t VERSION = 1;
+    static const int MAX_WORKERS = 256;
+
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;
+    int32_t workerCnt;    // 请求线程数，忙碌时间数组的前 workerCnt 项
+    int32_t sqlWorkerCnt; // 数据库线程数，紧接在请求线程之后
+    int32_t intervalMs;   // 更新间隔
+    atomic<uint64_t> seq; // 顺序锁的序号
+    atomic<uint64_t> updateNs;                  // 最近一次更新的时间（CLOCK_MONOTONIC）
+    atomic<uint64_t> values[STAT_NUM];
+    atomic<uint64_t> busyNs[MAX_WORKERS];       // 各工作线程累计执行任务的时间
+};
+
+// 读者复制出来的快照
+struct StatsSnapshot
+{
+    int pid;
+    int workerCnt;
+    int sqlWorkerCnt;
+    int intervalMs;
+    uint64_t updateNs;
+    uint64_t values[STAT_NUM];
+    uint64_t busyNs[StatsShmData::MAX_WORKERS];
+};
+
+class StatsShm
+{
+public:
+    StatsShm();
+    ~StatsShm();
+
+    // 共享内存的名字
+    static string nameOf(int port);
+
+    // 写者：创建共享内存段
+    bool create(const string& name, int workerCnt, int sqlWorkerCnt, int intervalMs);
+    void beginWrite();
+    void set(STAT_FIELD field, uint64_t value)
+    {
+        data->values[field].store(value, memory_order_relaxed);
+    }
+    void setBusy(int worker, uint64_t ns)
+    {
+        if (worker < StatsShmData::MAX_WORKERS) data->busyNs[worker].store(ns, memory_order_relaxed);
+    }
+    void endWrite();
+
+    // 读者：只读打开，读取一致的快照（写者正在写时重试）
+    bool open(const string& name);
+    bool read(StatsSnapshot& snapshot);
+
+    void close();
+
+private:
+    StatsShmData* data;
+    string name;
+    bool owner; // 写者负责删除共享内存段
+};
+
+#endif
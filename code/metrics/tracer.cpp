@@ -0,0 +1,180 @@
+#include "tracer.h"
+#include "alloctrack.h"
+
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+
+using namespace std;
+
+atomic<bool> Tracer::dumpRequested(false);
+
+// 事件名（线程轨道上的标记）和以该事件结束的区间名，顺序与枚举相同
+static const char* STAGE_NAME[][2] =
+{
+    {"accept",      "accept"},
+    {"epollin",     "wait for data"},
+    {"enqueue",     "dispatch"},
+    {"task start",  "queue wait"},
+    {"read",        "read"},
+    {"parse",       "parse"},
+    {"sql enqueue", "dispatch to sql"},
+    {"sql start",   "sql queue wait"},
+    {"response",    "make response"},
+    {"epollout",    "wait for epollout"},
+    {"writev",      "writev"},
+    {"done",        "finish"},
+    {"close",       "close"},
+};
+
+Tracer* Tracer::instance()
+{
+    static Tracer tracer;
+    return &tracer;
+}
+
+void Tracer::init(int sampleEvery, size_t ringSize)
+{
+    this->sampleEvery = sampleEvery;
+    this->ringSize = ringSize > 0 ? ringSize : 1;
+    startNs = Metrics::now();
+}
+
+// 当前线程的环形缓冲区，第一次使用时分配并登记
+Tracer::Ring* Tracer::local()
+{
+    ALLOC_SCOPE(ALLOC_METRICS);
+    static thread_local Ring* ring = nullptr;
+    if (!ring)
+    {
+        Tracer* global = instance();
+        unique_ptr<Ring> block(new Ring());
+        block->tid = syscall(SYS_gettid);
+        block->events.resize(global->ringSize);
+        ring = block.get();
+        lock_guard<mutex> locker(global->mtx);
+        global->rings.push_back(move(block));
+    }
+    return ring;
+}
+
+void Tracer::record(uint32_t traceId, TRACE_STAGE stage, uint64_t arg, uint64_t ns)
+{
+    Ring* ring = local();
+    uint64_t head = ring->head.load(memory_order_relaxed);
+    Event& event = ring->events[head % ring->events.size()];
+    event.ns = ns ? ns : Metrics::now();
+    event.arg = arg;
+    event.traceId = traceId;
+    event.stage = stage;
+    ring->head.store(head + 1, memory_order_release);
+}
+
+/*
+    复制所有线程的事件（导出时各线程仍在写入）：
+    先读 head，复制最近的事件，再读一次 head，丢弃复制期间可能被覆盖的事件
+*/
+void Tracer::collect(vector<pair<int, Event>>& out)
+{
+    lock_guard<mutex> locker(mtx);
+    for (auto& ring : rings)
+    {
+        size_t size = ring->events.size();
+        uint64_t head = ring->head.load(memory_order_acquire);
+        uint64_t first = head > size ? head - size : 0;
+        vector<Event> copy;
+        for (uint64_t i = first; i < head; i ++)
+        {
+            copy.push_back(ring->events[i % size]);
+        }
+        uint64_t after = ring->head.load(memory_order_acquire);
+        uint64_t valid = after > size ? after - size : 0;
+        for (uint64_t i = max(first, valid); i < head; i ++)
+        {
+            out.push_back({ring->tid, copy[i - first]});
+        }
+    }
+}
+
+string Tracer::exportJson()
+{
+    ALLOC_SCOPE(ALLOC_METRICS);
+    vector<pair<int, Event>> events;
+    collect(events);
+    // 按请求分组，组内按时间排序
+    sort(events.begin(), events.end(), [](const pair<int, Event>& a, const pair<int, Event>& b) {
+        if (a.second.traceId != b.second.traceId) return a.second.traceId < b.second.traceId;
+        return a.second.ns < b.second.ns;
+    });
+
+    int pid = getpid();
+    string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char line[256];
+    bool first = true;
+    auto append = [&](const char* fmt, const char* name, char ph, uint32_t id, int tid, uint64_t ns) {
+        double us = ns > startNs ? (ns - startNs) / 1000.0 : 0;
+        snprintf(line, sizeof(line), fmt, first ? "" : ",\n", name, ph, id, us, pid, tid);
+        json += line;
+        first = false;
+    };
+    const char* ASYNC = "%s{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"%c\",\"id\":%u,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}";
+
+    for (size_t begin = 0; begin < events.size(); )
+    {
+        size_t end = begin;
+        uint32_t id = events[begin].second.traceId;
+        while (end < events.size() && events[end].second.traceId == id) end ++;
+
+        // 整个请求的区间
+        char name[32];
+        snprintf(name, sizeof(name), "request %u", id);
+        append(ASYNC, name, 'b', id, events[begin].first, events[begin].second.ns);
+        for (size_t i = begin; i < end; i ++)
+        {
+            const Event& event = events[i].second;
+            int tid = events[i].first;
+            // 上一个阶段到这个阶段之间的区间
+            if (i > begin)
+            {
+                append(ASYNC, STAGE_NAME[event.stage][1], 'b', id, events[i - 1].first, events[i - 1].second.ns);
+                append(ASYNC, STAGE_NAME[event.stage][1], 'e', id, tid, event.ns);
+            }
+            // 事件所在线程的标记
+            double us = event.ns > startNs ? (event.ns - startNs) / 1000.0 : 0;
+            snprintf(line, sizeof(line),
+                     ",\n{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+                     "\"args\":{\"request\":%u,\"arg\":%llu}}",
+                     STAGE_NAME[event.stage][0], us, pid, tid, id, (unsigned long long)event.arg);
+            json += line;
+        }
+        append(ASYNC, name, 'e', id, events[end - 1].first, events[end - 1].second.ns);
+        begin = end;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool Tracer::dumpToFile(const string& fileName)
+{
+    string json = exportJson();
+    FILE* fp = fopen(fileName.c_str(), "w");
+    if (!fp) return false;
+    bool ok = fwrite(json.data(), 1, json.size(), fp) == json.size();
+    return fclose(fp) == 0 && ok;
+}
+
+static void onDumpSignal(int)
+{
+    Tracer::dumpRequested = true;
+}
+
+// SIGUSR2 只设置标志，导出在主循环中进行（信号处理函数中不能分配内存、写文件）
+void Tracer::installSignal()
+{
+    struct sigaction sa = {};
+    sa.sa_handler = onDumpSignal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR2, &sa, nullptr);
+}
@@ -0,0 +1,110 @@
+/*
+    请求生命周期追踪
+
+    按比例采样请求（每 N 个新请求采样一个），记录请求经过的各个阶段的时间戳：
+    接受连接、EPOLLIN、进入任务队列、任务开始执行、读取、解析完成、响应生成（stat/mmap）、
+    EPOLLOUT、每次 writev、完成或关闭。
+
+    每个线程把事件写入自己的环形缓冲区（只有本线程写入，不加锁），满了覆盖最旧的事件。
+    未被采样的请求只多一次判断（连接的 traceId 是否为 0），开销可以忽略。
+
+    导出为 Chrome trace 格式（JSON），可以用 chrome://tracing 或 Perfetto 打开：
+        每个请求是一条异步轨道，相邻两个阶段之间的时间是一个区间（如 queue wait、parse、writev），
+        同时在各线程的轨道上标出事件发生的位置。
+    触发方式：向进程发送 SIGUSR2（写入日志目录），或访问追踪接口（默认 /debug/trace.json）。
+*/
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+#include "metrics.h"
+
+using namespace std;
+
+// 请求经过的阶段
+enum TRACE_STAGE
+{
+    TRACE_ACCEPT = 0,   // 接受连接（连接的第一个请求被采样时补记）
+    TRACE_EPOLLIN,      // 主线程收到 EPOLLIN
+    TRACE_ENQUEUE,      // 加入请求线程池的任务队列
+    TRACE_TASK_START,   // 工作线程开始执行任务
+    TRACE_READ,         // 读取完成，参数为读取的字节数
+    TRACE_PARSE,        // 解析完成
+    TRACE_SQL_ENQUEUE,  // 加入数据库线程池的任务队列
+    TRACE_SQL_START,    // 数据库线程开始验证
+    TRACE_RESPONSE,     // 响应生成（查找、映射文件，写入响应头）
+    TRACE_EPOLLOUT,     // 主线程收到 EPOLLOUT
+    TRACE_WRITE,        // 一次 writev，参数为写入的字节数
+    TRACE_DONE,         // 响应发送完成
+    TRACE_CLOSE,        // 连接关闭
+    TRACE_STAGE_NUM
+};
+
+class Tracer
+{
+public:
+    static Tracer* instance();
+
+    // sampleEvery：每 N 个请求采样一个，0 表示关闭；ringSize：每个线程保存的事件数
+    void init(int sampleEvery, size_t ringSize);
+
+    bool isEnabled() const { return sampleEvery > 0; }
+
+    // 新请求开始时决定是否采样，返回追踪编号，0 表示不采样（只在主线程调用）
+    uint32_t sample()
+    {
+        if (sampleEvery <= 0 || ++ requestCnt % sampleEvery) return 0;
+        if (++ nextId == 0) nextId = 1;
+        return nextId;
+    }
+
+    // 记录一个事件，ns 为 0 时取当前时间
+    static void record(uint32_t traceId, TRACE_STAGE stage, uint64_t arg = 0, uint64_t ns = 0);
+
+    // 导出所有线程的事件（Chrome trace JSON）
+    string exportJson();
+    bool dumpToFile(const string& fileName);
+
+    // 收到 SIGUSR2 时设置，由主循环检查并导出
+    static atomic<bool> dumpRequested;
+    static void installSignal();
+
+private:
+    Tracer(): sampleEvery(0), ringSize(0), requestCnt(0), nextId(0), startNs(0) {}
+    ~Tracer() = default;
+
+    struct Event
+    {
+        uint64_t ns;
+        uint64_t arg;
+        uint32_t traceId;
+        uint32_t stage;
+    };
+
+    struct Ring
+    {
+        int tid;
+        atomic<uint64_t> head{0}; // 已写入的事件总数，下一个事件写在 head % size
+        vector<Event> events;
+    };
+
+    static Ring* local();
+    void collect(vector<pair<int, Event>>& out);
+
+    int sampleEvery;
+    size_t ringSize;
+    uint64_t requestCnt; // 只由主线程修改
+    uint32_t nextId;
+    uint64_t startNs;    // 导出的时间戳相对于这个时间
+
+    mutex mtx;
+    vector<unique_ptr<Ring>> rings; // 所有线程的环形缓冲区（线程退出后保留）
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "conntable.h"
+
+using namespace std;
+
+ConnTable::ConnTable(): slots(nullptr), maxFd(0), mapSize(0)
+{
+}
+
+ConnTable::~ConnTable()
+{
+    for (int fd = 0; fd < maxFd; fd ++)
+    {
+        if (constructed[fd]) slots[fd].~HttpConnect();
+    }
+    PageAlloc::unmap(slots, mapSize);
+}
+
+bool ConnTable::init(int maxFd, HUGE_PAGE_MODE& mode, bool numaLocal)
+{
+    assert(!slots);
+    mapSize = sizeof(HttpConnect) * maxFd;
+    slots = (HttpConnect*)PageAlloc::map(mapSize, mode, numaLocal ? PageAlloc::currentNode() : -1);
+    if (!slots) return false;
+    this->maxFd = maxFd;
+    constructed.assign(maxFd, false);
+    return true;
+}
@@ -0,0 +1,55 @@
+/*
+    连接表：按文件描述符索引的 HttpConnect 数组
+
+    整个表是一次 PageAlloc 映射的连续内存，槽位在第一次使用时构造，之后随描述符复用；
+    没有使用过的槽位不占用物理内存。与哈希表相比，查找不需要计算哈希、不会分散在堆中，
+    可以使用大页映射（大量连接时减少 dTLB 缺失），NUMA 下绑定到主线程（事件循环）所在的节点。
+*/
+#ifndef CONNTABLE_H
+#define CONNTABLE_H
+
+#include <assert.h>
+#include <vector>
+
+#include "../buffer/pagealloc.h"
+#include "../http/httpconnect.h"
+
+using namespace std;
+
+class ConnTable
+{
+public:
+    ConnTable();
+    ~ConnTable();
+
+    ConnTable(const ConnTable&) = delete;
+    ConnTable& operator=(const ConnTable&) = delete;
+
+    // 映射 maxFd 个槽位，mode 返回实际使用的页的方式
+    bool init(int maxFd, HUGE_PAGE_MODE& mode, bool numaLocal);
+
+    // 第一次访问时构造
+    HttpConnect& operator[](int fd)
+    {
+        assert(fd >= 0 && fd < maxFd);
+        if (!constructed[fd])
+        {
+            new (&slots[fd]) HttpConnect();
+            constructed[fd] = true;
+        }
+        return slots[fd];
+    }
+
+    size_t count(int fd) const
+    {
+        return fd >= 0 && fd < maxFd && constructed[fd];
+    }
+
+private:
+    HttpConnect* slots;
+    vector<bool> constructed;
+    int maxFd;
+    size_t mapSize;
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "cpuplacement.h"
+#include "../log/log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <algorithm>
+#include <map>
+#include <utility>
+
+using namespace std;
+
+// 读取 sysfs 中的一个整数，失败返回 -1
+static int readInt(const char* path)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    int value = -1;
+    if (fscanf(fp, "%d", &value) != 1) value = -1;
+    fclose(fp);
+    return value;
+}
+
+vector<int> CpuPlacement::parseList(const string& list)
+{
+    vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        size_t end = list.find(',', pos);
+        if (end == string::npos) end = list.size();
+        int first, last;
+        char tail;
+        string item = list.substr(pos, end - pos);
+        if (sscanf(item.c_str(), "%d-%d%c", &first, &last, &tail) == 2) {}
+        else if (sscanf(item.c_str(), "%d%c", &first, &tail) == 1) { last = first; }
+        else return vector<int>();
+        if (first < 0 || last < first || last >= CPU_SETSIZE) return vector<int>();
+        for (int cpu = first; cpu <= last; cpu ++) cpus.push_back(cpu);
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+string CpuPlacement::formatList(const vector<int>& cpus)
+{
+    if (cpus.empty()) return "-";
+    string str;
+    for (size_t i = 0; i < cpus.size(); i ++)
+    {
+        if (i) str += ",";
+        str += to_string(cpus[i]);
+    }
+    return str;
+}
+
+vector<int> CpuPlacement::allowedCpus()
+{
+    vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu ++)
+    {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// 按（插槽, 核）分组，第一轮取每个物理核的第一个逻辑 CPU，第二轮取兄弟核，依此类推
+vector<int> CpuPlacement::spreadOrder()
+{
+    vector<pair<int, int>> coreOrder;          // 物理核第一次出现的顺序
+    map<pair<int, int>, vector<int>> cores;     // 物理核 -> 逻辑 CPU
+    char path[128];
+    for (int cpu : allowedCpus())
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int package = readInt(path);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        int core = readInt(path);
+        // 读不到拓扑时每个逻辑 CPU 单独作为一个核
+        pair<int, int> key = (package < 0 || core < 0) ? make_pair(-1, cpu) : make_pair(package, core);
+        if (!cores.count(key)) coreOrder.push_back(key);
+        cores[key].push_back(cpu);
+    }
+
+    vector<int> order;
+    for (size_t round = 0; ; round ++)
+    {
+        size_t added = 0;
+        for (const auto& key : coreOrder)
+        {
+            const vector<int>& siblings = cores[key];
+            if (round < siblings.size())
+            {
+                order.push_back(siblings[round]);
+                added ++;
+            }
+        }
+        if (!added) break;
+    }
+    return order;
+}
+
+// /proc/interrupts 中名称包含 device 的中断，读取它们实际（或设置的）绑定的 CPU
+vector<int> CpuPlacement::irqCpus(const string& device)
+{
+    vector<int> cpus;
+    FILE* fp = fopen("/proc/interrupts", "r");
+    if (!fp) return cpus;
+    char line[4096];
+    char path[128];
+    while (fgets(line, sizeof(line), fp))
+    {
+        int irq;
+        if (sscanf(line, " %d:", &irq) != 1 || !strstr(line, device.c_str())) continue;
+        vector<int> irqList;
+        for (const char* name : {"effective_affinity_list", "smp_affinity_list"})
+        {
+            snprintf(path, sizeof(path), "/proc/irq/%d/%s", irq, name);
+            FILE* affinity = fopen(path, "r");
+            if (!affinity) continue;
+            char list[1024] = {0};
+            if (fgets(list, sizeof(list), affinity))
+            {
+                list[strcspn(list, "\n")] = '\0';
+                irqList = parseList(list);
+            }
+            fclose(affinity);
+            if (!irqList.empty()) break;
+        }
+        cpus.insert(cpus.end(), irqList.begin(), irqList.end());
+    }
+    fclose(fp);
+    sort(cpus.begin(), cpus.end());
+    cpus.erase(unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+vector<int> CpuPlacement::assign(const string& list, int num, bool autoSpread,
+                                 const vector<int>& order, size_t& next)
+{
+    vector<int> cpus;
+    if (!list.empty())
+    {
+        cpus = parseList(list);
+        if (cpus.empty()) { LOG_WARN("Invalid CPU list: %s", list.c_str()); }
+        return cpus;
+    }
+    if (!autoSpread || order.empty()) return cpus;
+    for (int i = 0; i < num; i ++)
+    {
+        cpus.push_back(order[next ++ % order.size()]);
+    }
+    return cpus;
+}
+
+CpuPlan CpuPlacement::plan(const Config& config, int threadNum, int sqlThreadNum)
+{
+    CpuPlan plan;
+    if (!config.irqDevice.empty()) plan.irqCpus = irqCpus(config.irqDevice);
+
+    vector<int> order;
+    if (config.cpuAutoSpread)
+    {
+        order = spreadOrder();
+        if (config.cpuAvoidIrq && !plan.irqCpus.empty())
+        {
+            vector<int> rest;
+            for (int cpu : order)
+            {
+                if (!binary_search(plan.irqCpus.begin(), plan.irqCpus.end(), cpu)) rest.push_back(cpu);
+            }
+            if (!rest.empty()) order = rest; // 全部是中断 CPU 时仍然使用
+        }
+    }
+
+    size_t next = 0;
+    vector<int> loop = assign(config.cpuLoop, 1, config.cpuAutoSpread, order, next);
+    plan.loop = loop.empty() ? -1 : loop[0];
+    plan.workers = assign(config.cpuWorkers, threadNum, config.cpuAutoSpread, order, next);
+    vector<int> log = assign(config.cpuLog, 1, config.cpuAutoSpread, order, next);
+    plan.log = log.empty() ? -1 : log[0];
+    plan.sqlWorkers = assign(config.cpuSqlWorkers, sqlThreadNum, config.cpuAutoSpread, order, next);
+    return plan;
+}
+
+bool CpuPlacement::pin(pthread_t thread, int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
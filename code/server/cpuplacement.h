@@ -0,0 +1,53 @@
+/*
+    线程的 CPU 绑定
+
+    事件循环、请求线程池、数据库线程池和日志写线程可以分别绑定到指定的 CPU（列表格式 "0-3,8"），
+    避免线程在 CPU 之间迁移带来的缓存失效和调度抖动，延迟更稳定。
+    未指定列表的角色在开启自动分散时按物理核分配：
+        先为每个物理核取一个逻辑 CPU（不与超线程的兄弟核共用），用完后再使用兄弟核，仍不够时循环使用；
+        顺序为事件循环、请求线程、日志写线程、数据库线程。
+    网卡中断：按网卡名在 /proc/interrupts 中找到它的中断，读取各中断绑定的 CPU，
+    启动时写入日志（提示与哪些线程重叠），自动分散时可以避开这些 CPU。
+*/
+#ifndef CPUPLACEMENT_H
+#define CPUPLACEMENT_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "../config/config.h"
+
+using namespace std;
+
+// 各角色绑定的 CPU，-1 或空表示不绑定
+struct CpuPlan
+{
+    int loop = -1;
+    vector<int> workers;    // 第 i 个请求线程绑定 workers[i]
+    vector<int> sqlWorkers;
+    int log = -1;
+    vector<int> irqCpus;    // 处理网卡中断的 CPU
+};
+
+class CpuPlacement
+{
+public:
+    static CpuPlan plan(const Config& config, int threadNum, int sqlThreadNum);
+
+    static bool pin(pthread_t thread, int cpu);
+
+    static vector<int> parseList(const string& list); // "0-3,8"，格式错误时为空
+    static string formatList(const vector<int>& cpus);
+
+    static vector<int> allowedCpus(); // 进程可以使用的 CPU
+    static vector<int> spreadOrder(); // 按物理核分散的顺序
+    static vector<int> irqCpus(const string& device);
+
+private:
+    // 列表为空时从自动分散的顺序中依次取 num 个，不自动分散时不绑定
+    static vector<int> assign(const string& list, int num, bool autoSpread,
+                              const vector<int>& order, size_t& next);
+};
+
+#endif
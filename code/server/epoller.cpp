@@ -1,6 +1,7 @@
 #include "epoller.h"
+#include "../metrics/metrics.h"
 
-Epoller::Epoller(int maxEvent):epollFd(epoll_create(512)), events(maxEvent)
+Epoller::Epoller(int maxEvent):epollFd(epoll_create(512)), events(maxEvent), busyPollNs(0)
 {
     assert(epollFd >= 0 && events.size() > 0);
 }
@@ -38,7 +39,36 @@ bool Epoller::delfd(int fd)
 
 int Epoller::wait(int timeoutMs)
 {
-    return epoll_wait(epollFd, &events[0], static_cast<int>(events.size()), timeoutMs);
+    int maxEvents = static_cast<int>(events.size());
+    if (busyPollNs <= 0 || timeoutMs == 0)
+    {
+        return epoll_wait(epollFd, &events[0], maxEvents, timeoutMs);
+    }
+
+    // 先忙轮询，期间有事件直接返回；定时器先到期时不再继续轮询
+    int64_t budget = busyPollNs;
+    if (timeoutMs > 0 && budget > (int64_t)timeoutMs * 1000000) budget = (int64_t)timeoutMs * 1000000;
+    uint64_t start = Metrics::now();
+    int64_t elapsed = 0;
+    do
+    {
+        int n = epoll_wait(epollFd, &events[0], maxEvents, 0);
+        if (n != 0)
+        {
+            if (n > 0) Metrics::add(CNT_POLL_SPIN_HIT);
+            return n;
+        }
+        elapsed = Metrics::now() - start;
+    } while (elapsed < budget);
+
+    // 轮询期间没有事件，阻塞等待剩下的时间
+    Metrics::add(CNT_POLL_BLOCK);
+    if (timeoutMs > 0)
+    {
+        timeoutMs -= elapsed / 1000000;
+        if (timeoutMs < 0) timeoutMs = 0;
+    }
+    return epoll_wait(epollFd, &events[0], maxEvents, timeoutMs);
 }
 
 int Epoller::getEventfd(size_t i) const
@@ -7,6 +7,7 @@
 #include <assert.h>
 #include <vector>
 #include <errno.h>
+#include <stdint.h>
 
 using namespace std;
 
@@ -22,11 +23,18 @@ public:
 
     int wait(int timeoutsMs = -1);
 
+    /*
+        忙轮询：阻塞之前先以零超时反复调用 epoll_wait，最多 spinUs 微秒（不超过 wait 的超时时间），
+        轻负载时事件到达不需要等待线程被唤醒，代价是空闲时也会占用 CPU。0 表示关闭。
+    */
+    void setBusyPoll(int spinUs) { busyPollNs = spinUs > 0 ? (int64_t)spinUs * 1000 : 0; }
+
     int getEventfd(size_t i) const;
     uint32_t getEvents(size_t i) const;
 private:
     int epollFd; // epoll_create()创建一个epoll对象，返回值是epollFd
     vector<struct epoll_event> events; // 检测到的事件的集合
+    int64_t busyPollNs; // 忙轮询的时长，0 表示关闭
 };
 
 #endif
\ No newline at end of file
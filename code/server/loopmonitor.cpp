@@ -0,0 +1,78 @@
+#include "loopmonitor.h"
+
+void LoopMonitor::init(bool enabled, int slowCallbackUs, int slowIterationUs)
+{
+    this->enabled = enabled;
+    slowCallbackNs = slowCallbackUs > 0 ? (uint64_t)slowCallbackUs * 1000 : 0;
+    slowIterationNs = slowIterationUs > 0 ? (uint64_t)slowIterationUs * 1000 : 0;
+}
+
+// 警告日志限流：每秒最多一条
+bool LoopMonitor::shouldWarn(uint64_t now)
+{
+    if (now - lastWarnNs < 1000000000)
+    {
+        suppressed ++;
+        return false;
+    }
+    lastWarnNs = now;
+    return true;
+}
+
+void LoopMonitor::eventDone(int fd, uint32_t events, uint64_t start)
+{
+    if (!enabled) return;
+    uint64_t end = Metrics::now();
+    uint64_t cost = end - start;
+    Metrics::record(HIST_LOOP_CALLBACK, cost);
+    if (slowCallbackNs && cost > slowCallbackNs)
+    {
+        Metrics::add(CNT_SLOW_CALLBACK);
+        if (shouldWarn(end))
+        {
+            LOG_WARN("Slow event handler: fd %d, events 0x%x, %.3f ms (%llu slow events suppressed)",
+                     fd, events, cost / 1e6, (unsigned long long)suppressed);
+            suppressed = 0;
+        }
+    }
+}
+
+void LoopMonitor::timerDone(int id, int64_t lateNs, int64_t costNs)
+{
+    if (!enabled) return;
+    Metrics::record(HIST_TIMER_LAG, lateNs > 0 ? lateNs : 0);
+    Metrics::record(HIST_LOOP_CALLBACK, costNs);
+    if (slowCallbackNs && (uint64_t)costNs > slowCallbackNs)
+    {
+        Metrics::add(CNT_SLOW_CALLBACK);
+        if (shouldWarn(Metrics::now()))
+        {
+            LOG_WARN("Slow timer callback: id %d, %.3f ms, %.3f ms late (%llu slow events suppressed)",
+                     id, costNs / 1e6, lateNs / 1e6, (unsigned long long)suppressed);
+            suppressed = 0;
+        }
+    }
+}
+
+void LoopMonitor::iterationDone(uint64_t start, uint64_t timersEnd, uint64_t waitEnd, int eventCnt)
+{
+    if (!enabled) return;
+    uint64_t end = Metrics::now();
+    uint64_t timers = timersEnd - start;
+    uint64_t dispatch = end - waitEnd;
+    Metrics::record(HIST_LOOP_TIMERS, timers);
+    Metrics::record(HIST_LOOP_WAIT, waitEnd - timersEnd);
+    Metrics::record(HIST_LOOP_DISPATCH, dispatch);
+    Metrics::record(HIST_LOOP_BUSY, timers + dispatch);
+    if (slowIterationNs && timers + dispatch > slowIterationNs)
+    {
+        Metrics::add(CNT_SLOW_ITERATION);
+        if (shouldWarn(end))
+        {
+            LOG_WARN("Slow loop iteration: %.3f ms (timers %.3f ms, dispatch %.3f ms, %d events, "
+                     "%llu slow events suppressed)", (timers + dispatch) / 1e6, timers / 1e6, dispatch / 1e6,
+                     eventCnt, (unsigned long long)suppressed);
+            suppressed = 0;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/*
+    主循环（reactor）监控
+
+    主线程一次迭代依次做三件事：执行到期的定时器回调、epoll_wait、分发事件（接受连接、
+    把读写任务放入线程池）。任何一步变慢，所有连接的事件都会被推迟，而线程池看起来仍然空闲。
+
+    每次迭代记录定时器、等待、分发各自的时间和除等待以外的总时间；每个事件处理和定时器回调
+    单独计时，同时记录定时器回调相对到期时间的延迟（主循环被占用时，定时器会晚执行）。
+    超过阈值的回调和迭代计数，并写一条警告日志（每秒最多一条，其余的只计数）。
+*/
+#ifndef LOOPMONITOR_H
+#define LOOPMONITOR_H
+
+#include <stdint.h>
+
+#include "../metrics/metrics.h"
+#include "../log/log.h"
+
+class LoopMonitor
+{
+public:
+    LoopMonitor(): enabled(false), slowCallbackNs(0), slowIterationNs(0), lastWarnNs(0), suppressed(0) {}
+
+    // slowCallbackUs、slowIterationUs：慢回调、慢迭代的阈值（微秒），0 表示不检查
+    void init(bool enabled, int slowCallbackUs, int slowIterationUs);
+
+    bool isEnabled() const { return enabled; }
+
+    // 关闭时返回 0，调用方不需要额外判断
+    uint64_t now() const { return enabled ? Metrics::now() : 0; }
+
+    // 一个事件处理结束，start 为开始时间
+    void eventDone(int fd, uint32_t events, uint64_t start);
+
+    // 一个定时器回调结束（由定时器的观察者调用）
+    void timerDone(int id, int64_t lateNs, int64_t costNs);
+
+    // 一次迭代结束：start 开始，timersEnd 定时器处理完，waitEnd epoll_wait 返回
+    void iterationDone(uint64_t start, uint64_t timersEnd, uint64_t waitEnd, int eventCnt);
+
+private:
+    bool shouldWarn(uint64_t now);
+
+    bool enabled;
+    uint64_t slowCallbackNs;
+    uint64_t slowIterationNs;
+    uint64_t lastWarnNs;  // 上一次写警告日志的时间
+    uint64_t suppressed;  // 限流期间没有写日志的慢回调、慢迭代
+};
+
+#endif
@@ -2,15 +2,23 @@
 
 using namespace std;
 
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69 // Linux 5.11
+#endif
+
 // 服务器相关参数
 WebServer::WebServer(
     int port, int trigMode, int timeoutMs, bool optLinger,
     int sqlPort, const char* sqlUser, const char* sqlPwd,
     const char* dbName, int connPoolNum,
     int threadNum, int maxRequests,
-    bool openLog, int logLevel, int logQueSize):
-    port(port), openLinger(optLinger), timeoutMs(timeoutMs), isClose(false),
-    timer(new HeapTimer()), epoller(new Epoller())
+    bool openLog, int logLevel, int logQueSize,
+    const Config& config):
+    port(port), openLinger(optLinger), timeoutMs(timeoutMs), sessionSweepMs(config.sessionSweepMs),
+    statsIntervalMs(0), lockReportMs(0), allocReportMs(0), loopCpu(-1),
+    socketBusyPollUs(config.socketBusyPollUs), socketPreferBusyPoll(config.socketPreferBusyPoll),
+    execMode(config.execMode), inlineWriteBytes(config.inlineWriteBytes), isClose(false),
+    timer(new HeapTimer()), epoller(new Epoller()), sqlThreadPool(new ThreadPool())
 {
     // 获取当前的工作目录（底层使用 malloc）
     srcDir = getcwd(nullptr, 256);
@@ -21,19 +29,98 @@ WebServer::WebServer(
     HttpConnect::userCnt = 0;
     HttpConnect::srcDir = srcDir;
 
+    // 初始化日志实例（先于各模块初始化，记录它们的启动信息）
+    if (openLog) Log::instance()->init(logLevel, "./log", ".log", logQueSize, config.logSegmentSize, config.logMaxSegments);
+
+    // 连接表和缓冲区池的内存布局（大页、NUMA），先于创建连接
+    if (!initMemory(config)) isClose = true;
+
     // 线程池，实例初始化
-    ThreadPool::instance()->init(threadNum, maxRequests);
+    ThreadPool::instance()->init(threadNum, maxRequests, HIST_QUEUE_WAIT, "threadpool.http");
+
+    // 用户存储（及数据库连接池）
+    if (!initUserStore(sqlPort, sqlUser, sqlPwd, dbName, connPoolNum, config)) isClose = true;
+
+    // 会话存储，过期会话由定时器周期清理
+    SessionStore::instance()->init(config.sessionTtlMs, config.sessionMax);
+    if (sessionSweepMs > 0)
+    {
+        timer->add(SESSION_TIMER_ID, sessionSweepMs, bind(&WebServer::expireSessions, this));
+    }
+
+    // 数据库线程池，线程数与连接数相同，每个线程同时最多占用一个连接；
+    // 线程独占模式下只有这些线程绑定连接（每个库一个），启动时预热用的主线程等其他线程用完即归还
+    sqlThreadPool->init(connPoolNum, maxRequests, HIST_SQL_QUEUE_WAIT, "threadpool.sql",
+                        [](int) { SqlConnPool::bindThisThread(); });
+
+    // 线程绑定 CPU（事件循环在 start 中绑定，不影响在此之前创建的线程）
+    initPlacement(config);
+
+    // 运行指标
+    Metrics::enabled = config.metricsEnabled;
+    HttpConnect::metricsPath = config.metricsEnabled ? config.metricsPath : "";
+    initGauges(config);
+
+    // 请求追踪（按比例采样），SIGUSR2 或追踪接口导出
+    Tracer::instance()->init(config.traceSample, config.traceEvents);
+    HttpConnect::tracePath = config.traceSample > 0 ? config.tracePath : "";
+    traceDir = config.traceDir;
+    if (config.traceSample > 0) Tracer::installSignal();
 
-    // 数据库连接池，实例初始化
-    SqlConnPool::instance()->init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
+    // 主循环监控：每次迭代的耗时分解，慢回调、慢迭代告警
+    loopMonitor.init(config.loopMonitor, config.loopSlowCallbackUs, config.loopSlowIterationUs);
+    if (config.loopMonitor)
+    {
+        LoopMonitor* monitor = &loopMonitor;
+        timer->setObserver([monitor](int id, int64_t lateNs, int64_t costNs) {
+            monitor->timerDone(id, lateNs, costNs);
+        });
+    }
+
+#ifdef LOCK_PROFILE
+    // 锁竞争分析：定期把等待时间最长的锁写入日志
+    if (openLog && config.lockReportMs > 0)
+    {
+        lockReportMs = config.lockReportMs;
+        timer->add(LOCK_TIMER_ID, lockReportMs, bind(&WebServer::reportLocks, this));
+    }
+#endif
+
+#ifdef ALLOC_TRACK
+    // 分子系统的内存分配统计：定期把各子系统的占用、峰值和分配速率写入日志
+    if (openLog && config.allocReportMs > 0)
+    {
+        allocReportMs = config.allocReportMs;
+        AllocTracker::instance()->report(); // 速率从这里开始计算
+        timer->add(ALLOC_TIMER_ID, allocReportMs, bind(&WebServer::reportAllocs, this));
+    }
+#endif
+
+    // 事件循环忙轮询
+    epoller->setBusyPoll(config.busyPollUs);
 
     // 设置不同套接字的触发模式
     initEventMode(trigMode);
     if (!initSocket()) isClose = true;
 
-    // 初始化日志实例
+    // 共享内存统计段，由定时器周期更新（端口绑定成功后创建，不影响同一端口上已在运行的服务器）
+    if (!isClose && config.statsIntervalMs > 0)
+    {
+        statsShm.reset(new StatsShm());
+        if (statsShm->create(StatsShm::nameOf(port), threadNum, connPoolNum, config.statsIntervalMs))
+        {
+            statsIntervalMs = config.statsIntervalMs;
+            publishStats();
+        }
+        else
+        {
+            LOG_WARN("Create stats shm %s error: %s", StatsShm::nameOf(port).c_str(), strerror(errno));
+            statsShm.reset();
+        }
+    }
+
+    // 记录启动信息
     if(openLog) {
-        Log::instance()->init(logLevel, "./log", ".log", logQueSize);
         if(isClose) { LOG_ERROR("========== Server init error!=========="); }
         else {
             LOG_INFO("========== Server init ==========");
@@ -42,8 +129,23 @@ WebServer::WebServer(
                             (listenEvent & EPOLLET ? "ET": "LT"),
                             (connEvent & EPOLLET ? "ET": "LT"));
             LOG_INFO("LogSys level: %d", logLevel);
+            if (config.busyPollUs > 0 || socketBusyPollUs > 0 || socketPreferBusyPoll) {
+                LOG_INFO("BusyPoll: epoll %dus, SO_BUSY_POLL %dus, SO_PREFER_BUSY_POLL %s",
+                         config.busyPollUs, socketBusyPollUs, socketPreferBusyPoll ? "on" : "off");
+            }
             LOG_INFO("srcDir: %s", HttpConnect::srcDir);
             LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            if (execMode == EXEC_HYBRID) {
+                LOG_INFO("Exec Mode: hybrid, inline write up to %zu bytes", inlineWriteBytes);
+            } else {
+                LOG_INFO("Exec Mode: pool");
+            }
+            if (config.userStore == USER_STORE_LOCAL) {
+                LOG_INFO("UserStore: local %s", config.userStorePath.c_str());
+            } else {
+                LOG_INFO("UserStore: mysql, primary: %s:%d, replicas: %d",
+                         config.sqlHost.c_str(), sqlPort, (int)config.sqlReplicas.size());
+            }
         }
     }
 }
@@ -55,8 +157,241 @@ WebServer::~WebServer()
     isClose = true;
     // 回收路径动态缓存
     free(srcDir);
-    // 关闭数据库连接池
-    SqlConnPool::instance()->destroy();
+    // 关闭所有数据库的连接池（未使用 MySQL 时不做任何事）
+    SqlRouter::instance()->destroy();
+}
+
+// 注册仪表：读取 /metrics 时取各模块的当前值
+void WebServer::initGauges(const Config& config)
+{
+    Metrics* metrics = Metrics::instance();
+    metrics->addGauge("connections", "Open client connections.",
+                      [] { return (double)HttpConnect::userCnt; });
+    metrics->addGauge("queue_length", "Tasks waiting in the request thread pool.",
+                      [] { return (double)ThreadPool::instance()->queueSize(); });
+    ThreadPool* sqlPool = sqlThreadPool.get();
+    metrics->addGauge("sql_queue_length", "Tasks waiting in the SQL thread pool.",
+                      [sqlPool] { return (double)sqlPool->queueSize(); });
+    metrics->addGauge("sessions", "Live sessions.",
+                      [] { return (double)SessionStore::instance()->size(); });
+    if (config.userStore == USER_STORE_MYSQL)
+    {
+        metrics->addGauge("sql_free_connections", "Idle connections in the primary SQL pool.",
+                          [] { return (double)SqlConnPool::instance()->getStats().freeConnCnt; });
+        metrics->addGauge("sql_used_connections", "Connections in use in the primary SQL pool.",
+                          [] { SqlPoolStats stats = SqlConnPool::instance()->getStats();
+                               return (double)(stats.useConnCnt + stats.boundConnCnt); });
+    }
+    if (BufferPool::isEnabled())
+    {
+        metrics->addGauge("buffer_pool_mapped_bytes", "Memory mapped by the buffer pool.",
+                          [] { return (double)BufferPool::instance()->mappedBytes(); });
+        metrics->addGauge("buffer_pool_used_bytes", "Buffer storage in use from the buffer pool.",
+                          [] { return (double)BufferPool::instance()->usedBytes(); });
+    }
+    if (config.hugePages != HUGE_PAGE_OFF)
+    {
+        metrics->addGauge("huge_page_bytes", "Memory of the process backed by huge pages.",
+                          [] { return (double)PageAlloc::hugePageBytes(); });
+    }
+#ifdef LOCK_PROFILE
+    metrics->addSection([] { return LockProfiler::instance()->exposition(); });
+#endif
+#ifdef ALLOC_TRACK
+    metrics->addSection([] { return AllocTracker::instance()->exposition(); });
+#endif
+}
+
+// 把当前状态写入共享内存统计段，并重新设置定时器（在主线程中执行）
+void WebServer::publishStats()
+{
+    ThreadPool* pool = ThreadPool::instance();
+    statsShm->beginWrite();
+    statsShm->set(STAT_CONNECTIONS, HttpConnect::userCnt);
+    statsShm->set(STAT_QUEUE_LENGTH, pool->queueSize());
+    statsShm->set(STAT_SQL_QUEUE_LENGTH, sqlThreadPool->queueSize());
+    statsShm->set(STAT_TIMER_SIZE, timer->size());
+    statsShm->set(STAT_LOG_QUEUE, Log::instance()->queueSize());
+    if (SqlRouter::instance()->hasPrimary())
+    {
+        SqlPoolStats stats = SqlConnPool::instance()->getStats();
+        statsShm->set(STAT_SQL_FREE, stats.freeConnCnt);
+        statsShm->set(STAT_SQL_USED, stats.useConnCnt + stats.boundConnCnt);
+    }
+    statsShm->set(STAT_SESSIONS, SessionStore::instance()->size());
+    statsShm->set(STAT_ACCEPTED, Metrics::instance()->getCounter(CNT_ACCEPT));
+    statsShm->set(STAT_REQUESTS, Metrics::instance()->getCounter(CNT_REQUEST));
+    statsShm->set(STAT_BYTES_WRITTEN, Metrics::instance()->getCounter(CNT_BYTES_WRITTEN));
+    statsShm->set(STAT_RESPONSE_5XX, Metrics::instance()->getCounter(CNT_RESPONSE_5XX));
+    int threadNum = pool->getThreadNum();
+    for (int i = 0; i < threadNum; i ++)
+    {
+        statsShm->setBusy(i, pool->getBusyNs(i));
+    }
+    for (int i = 0; i < sqlThreadPool->getThreadNum(); i ++)
+    {
+        statsShm->setBusy(threadNum + i, sqlThreadPool->getBusyNs(i));
+    }
+    statsShm->endWrite();
+    timer->add(STATS_TIMER_ID, statsIntervalMs, bind(&WebServer::publishStats, this));
+}
+
+// 锁竞争报告：等待时间最长的锁（累计值），每个锁一行
+void WebServer::reportLocks()
+{
+#ifdef LOCK_PROFILE
+    for (const string& line : LockProfiler::instance()->report(8))
+    {
+        LOG_INFO("Lock %s", line.c_str());
+    }
+    timer->add(LOCK_TIMER_ID, lockReportMs, bind(&WebServer::reportLocks, this));
+#endif
+}
+
+// 内存分配报告：进程 RSS 和已统计的占用，每个子系统一行
+void WebServer::reportAllocs()
+{
+#ifdef ALLOC_TRACK
+    for (const string& line : AllocTracker::instance()->report())
+    {
+        LOG_INFO("Alloc %s", line.c_str());
+    }
+    timer->add(ALLOC_TIMER_ID, allocReportMs, bind(&WebServer::reportAllocs, this));
+#endif
+}
+
+// 在后台线程中把追踪写入文件，不阻塞事件循环
+void WebServer::dumpTrace()
+{
+    char fileName[256];
+    snprintf(fileName, sizeof(fileName), "%s/trace-%d-%ld.json", traceDir.c_str(), (int)getpid(), (long)time(nullptr));
+    string name = fileName;
+    thread([name] {
+        if (Tracer::instance()->dumpToFile(name)) { LOG_INFO("Trace dumped to %s", name.c_str()); }
+        else { LOG_WARN("Dump trace to %s error: %s", name.c_str(), strerror(errno)); }
+    }).detach();
+}
+
+// 清理过期会话，并重新设置定时器
+void WebServer::expireSessions()
+{
+    size_t cnt = SessionStore::instance()->expire();
+    if (cnt) { LOG_DEBUG("Expire %d sessions", (int)cnt); }
+    timer->add(SESSION_TIMER_ID, sessionSweepMs, bind(&WebServer::expireSessions, this));
+}
+
+// 映射连接表；开启大页或 NUMA 时，读写缓冲区改从缓冲区池分配
+bool WebServer::initMemory(const Config& config)
+{
+    HUGE_PAGE_MODE mode = config.hugePages;
+    if (!users.init(MAX_FD, mode, config.numaLocal))
+    {
+        LOG_ERROR("Map connection table error: %s", strerror(errno));
+        return false;
+    }
+    if (mode != config.hugePages)
+    {
+        LOG_WARN("Huge pages not reserved (vm.nr_hugepages), fall back to %s", PageAlloc::modeName(mode));
+    }
+    if (config.hugePages != HUGE_PAGE_OFF || config.numaLocal)
+    {
+        BufferPool::instance()->init(mode, config.numaLocal, config.bufferRegionSize);
+    }
+    LOG_INFO("Memory: huge pages %s, numa %s (%d nodes), buffer pool %s",
+             PageAlloc::modeName(mode), config.numaLocal ? "local" : "off", PageAlloc::nodeCount(),
+             BufferPool::isEnabled() ? "on" : "off");
+    return true;
+}
+
+// 按配置绑定各线程的 CPU，并提示与网卡中断 CPU 的重叠
+void WebServer::initPlacement(const Config& config)
+{
+    ThreadPool* pool = ThreadPool::instance();
+    CpuPlan plan = CpuPlacement::plan(config, pool->getThreadNum(), sqlThreadPool->getThreadNum());
+    loopCpu = plan.loop;
+
+    bool failed = false;
+    for (int i = 0; i < pool->getThreadNum() && !plan.workers.empty(); i ++)
+    {
+        int cpu = plan.workers[i % plan.workers.size()];
+        failed |= !CpuPlacement::pin(pool->getThread(i).native_handle(), cpu);
+    }
+    for (int i = 0; i < sqlThreadPool->getThreadNum() && !plan.sqlWorkers.empty(); i ++)
+    {
+        int cpu = plan.sqlWorkers[i % plan.sqlWorkers.size()];
+        failed |= !CpuPlacement::pin(sqlThreadPool->getThread(i).native_handle(), cpu);
+    }
+    thread* logThread = Log::instance()->getWriteThread();
+    if (logThread && plan.log >= 0)
+    {
+        failed |= !CpuPlacement::pin(logThread->native_handle(), plan.log);
+    }
+    if (failed)
+    {
+        LOG_WARN("Pin threads error, allowed CPUs: %s",
+                 CpuPlacement::formatList(CpuPlacement::allowedCpus()).c_str());
+    }
+    if (plan.loop >= 0 || !plan.workers.empty() || !plan.sqlWorkers.empty() || plan.log >= 0)
+    {
+        LOG_INFO("CPU placement: loop %d, workers %s, sql %s, log %d", plan.loop,
+                 CpuPlacement::formatList(plan.workers).c_str(),
+                 CpuPlacement::formatList(plan.sqlWorkers).c_str(), plan.log);
+    }
+
+    if (config.irqDevice.empty()) return;
+    if (plan.irqCpus.empty())
+    {
+        LOG_INFO("No IRQs found for %s in /proc/interrupts", config.irqDevice.c_str());
+        return;
+    }
+    // 中断与事件循环、请求线程在同一个 CPU 上时，软中断处理会打断它们
+    vector<int> shared;
+    for (int cpu : plan.irqCpus)
+    {
+        if (cpu == plan.loop || count(plan.workers.begin(), plan.workers.end(), cpu)) shared.push_back(cpu);
+    }
+    LOG_INFO("%s IRQs on CPUs %s", config.irqDevice.c_str(), CpuPlacement::formatList(plan.irqCpus).c_str());
+    if (!shared.empty())
+    {
+        LOG_WARN("CPUs %s handle %s IRQs and run the loop or workers, "
+                 "consider cpuAvoidIrq or moving the IRQs (/proc/irq/N/smp_affinity_list)",
+                 CpuPlacement::formatList(shared).c_str(), config.irqDevice.c_str());
+    }
+}
+
+// 按配置创建用户存储，MySQL 后端同时初始化主库和副本的连接池
+bool WebServer::initUserStore(int sqlPort, const char* sqlUser, const char* sqlPwd,
+                              const char* dbName, int connPoolNum, const Config& config)
+{
+    if (config.userStore == USER_STORE_LOCAL)
+    {
+        LocalUserStore* store = new LocalUserStore();
+        userStore.reset(store);
+        HttpRequest::userStore = store;
+        return store->open(config.userStorePath, config.userStoreSync);
+    }
+
+    // 数据库连接池，实例初始化（连接数在 sqlMinConn 和 connPoolNum 之间伸缩）
+    SqlConnPool::instance()->init(config.sqlHost.c_str(), sqlPort, sqlUser, sqlPwd, dbName, connPoolNum,
+                                  config.sqlMinConn, config.sqlWaitTimeoutMs,
+                                  config.sqlIdleTimeoutMs, config.sqlPingIntervalMs,
+                                  config.sqlThreadAffine);
+    // 主库和只读副本，按语句类型路由
+    SqlRouter::instance()->setPrimary("primary", SqlConnPool::instance());
+    for (const SqlReplica& replica : config.sqlReplicas)
+    {
+        unique_ptr<SqlConnPool> pool(new SqlConnPool());
+        pool->init(replica.host.c_str(), replica.port, sqlUser, sqlPwd, dbName, connPoolNum,
+                   config.sqlMinConn, config.sqlWaitTimeoutMs,
+                   config.sqlIdleTimeoutMs, config.sqlPingIntervalMs,
+                   config.sqlThreadAffine);
+        SqlRouter::instance()->addReplica(replica.name, move(pool));
+    }
+    MysqlUserStore* store = new MysqlUserStore();
+    userStore.reset(store);
+    HttpRequest::userStore = store;
+    store->init(config.userBloom, config.userInsertBatch, config.userInsertDelayMs);
+    return true;
 }
 
 // 设置不同套接字的触发模式
@@ -97,12 +432,17 @@ void WebServer::start()
 {
     int timeMs = -1; // epoll wait timeout == -1, 无事件将阻塞
     if (!isClose) {LOG_INFO("========= Server start =========");}
+    // 事件循环绑定 CPU（放在最后，之前创建的线程不继承这个绑定）
+    if (loopCpu >= 0 && !CpuPlacement::pin(pthread_self(), loopCpu))
+    {
+        LOG_WARN("Pin event loop to CPU %d error", loopCpu);
+    }
     while (!isClose)
     {
-        // 该连接超时，返回下一个计时器的超时时间
-        if (timeoutMs > 0) {
-            timeMs = timer->getNextTick();
-        }
+        uint64_t loopStart = loopMonitor.now();
+        // 处理到期的定时器（连接超时、会话清理），返回下一个计时器的超时时间
+        timeMs = timer->getNextTick();
+        uint64_t timersEnd = loopMonitor.now();
 
         /* 
             利用 epoll 的 epoll_wait 实现定时功能
@@ -113,6 +453,10 @@ void WebServer::start()
             这样做的目的是为了让 epoll_wait() 调用次数变少，提高效率。  
         */
         int eventCnt = epoller->wait(timeMs);
+        uint64_t waitEnd = loopMonitor.now();
+
+        // 收到 SIGUSR2（epoll_wait 被信号中断返回），导出追踪
+        if (Tracer::dumpRequested.exchange(false)) dumpTrace();
 
         // 循环处理事件表
         for (int i = 0; i < eventCnt; i ++)
@@ -121,6 +465,7 @@ void WebServer::start()
             int fd = epoller->getEventfd(i);
             // 事件内容
             uint32_t events = epoller->getEvents(i);
+            uint64_t eventStart = loopMonitor.now();
 
             // 监听套接字只有连接事件
             if (fd == listenFd) {
@@ -148,7 +493,9 @@ void WebServer::start()
             {
                 LOG_ERROR("Unexpected event");
             }
+            loopMonitor.eventDone(fd, events, eventStart);
         }
+        loopMonitor.iterationDone(loopStart, timersEnd, waitEnd, eventCnt);
     }
 }
 
@@ -173,21 +520,36 @@ void WebServer::closeConnect(HttpConnect* client)
     client->closeConnect();
 }
 
+// 连接超时：验证还在数据库线程中时不能关闭（数据库线程仍在使用这个连接），顺延一个周期
+void WebServer::onTimeout(HttpConnect* client)
+{
+    assert(client);
+    if (client->isVerifying())
+    {
+        timer->add(client->getFd(), timeoutMs, bind(&WebServer::onTimeout, this, client));
+        return;
+    }
+    closeConnect(client);
+}
+
 // 为连接注册事件和设置计时器
 void WebServer::addClient(int fd, sockaddr_in addr)
 {
+    ALLOC_SCOPE(ALLOC_CONNECTION);
     assert(fd > 0);
-    // users 是哈希表（套接字是键，HttpConnect 对象是值）
+    // users 是按套接字索引的连接表（槽位在第一次使用时构造）
     // 初始化 HttpConnect 对象
     users[fd].init(fd, addr);
+    Metrics::add(CNT_ACCEPT);
     // 添加计时器，到期关闭连接
     if(timeoutMs > 0)
     {
-        timer->add(fd, timeoutMs, bind(&WebServer::closeConnect, this, &users[fd]));
+        timer->add(fd, timeoutMs, bind(&WebServer::onTimeout, this, &users[fd]));
     }
     epoller->addfd(fd, EPOLLIN | connEvent);
     // 套接字设置非阻塞
     setfdNonblock(fd);
+    setBusyPoll(fd);
     LOG_INFO("Client[%d] in!", users[fd].getFd());
 }
 
@@ -201,7 +563,7 @@ void WebServer::dealListen()
     {
         int fd = accept(listenFd, (struct sockaddr*)&addr, &len);
         if (fd <= 0) { return; }
-        if (HttpConnect::userCnt >= MAX_FD)
+        if (HttpConnect::userCnt >= MAX_FD || fd >= MAX_FD)
         {
             sendError(fd, "Server busy!");
             LOG_WARN("Clients is full!");
@@ -216,6 +578,15 @@ void WebServer::dealRead(HttpConnect* client)
 {
     assert(client);
     extentTime(client);
+    client->beginTrace();
+    // 混合模式：直接在事件循环中读取和处理
+    if (execMode == EXEC_HYBRID)
+    {
+        client->trace(TRACE_TASK_START);
+        if (receive(client)) serve(client, true);
+        return;
+    }
+    client->trace(TRACE_ENQUEUE);
     // 非静态成员函数需要传递 this 指针，作为第一个参数
     ThreadPool::instance()->addTask(std::bind(&WebServer::onRead, this, client));
 }
@@ -225,6 +596,21 @@ void WebServer::dealWrite(HttpConnect* client)
 {
     assert(client);
     extentTime(client);
+    client->trace(TRACE_EPOLLOUT);
+    // 验证完成，响应回到事件循环，超时计时从这里重新开始（计时器只在事件循环中操作）
+    client->setVerifying(false);
+    // 混合模式：剩下的响应不大时直接在事件循环中发送（未发完的响应续写时不再计数）
+    if (execMode == EXEC_HYBRID)
+    {
+        bool cheap = client->isCheapWrite(inlineWriteBytes);
+        client->countPlacement(cheap);
+        if (cheap)
+        {
+            if (sendResponse(client)) serve(client, true);
+            return;
+        }
+    }
+    client->trace(TRACE_ENQUEUE);
     // 非静态成员函数需要传递 this 指针，作为第一个参数
     ThreadPool::instance()->addTask(std::bind(&WebServer::onWrite, this, client));
 }
@@ -242,16 +628,23 @@ void WebServer::extentTime(HttpConnect* client)
 void WebServer::onRead(HttpConnect* client)
 {
     assert(client);
-    int ret = -1;
+    client->trace(TRACE_TASK_START);
+    if (receive(client)) onProcess(client);
+}
+
+// 接收请求数据，客户端关闭或出错时关闭连接并返回 false
+bool WebServer::receive(HttpConnect* client)
+{
     int readErrno = 0;
-    ret = client->read(&readErrno);
+    ssize_t ret = client->read(&readErrno);
+    client->trace(TRACE_READ, ret > 0 ? ret : 0);
     // 客户端发送EOF
     if (ret <= 0 && readErrno != EAGAIN)
     {
         closeConnect(client);
-        return;
+        return false;
     }
-    onProcess(client);
+    return true;
 }
 
 /* 
@@ -266,6 +659,12 @@ void WebServer::onProcess(HttpConnect* client)
 {
     if (client->process())
     {
+        // 需要查询数据库，交给数据库线程池，不占用处理静态资源的线程
+        if (client->isSqlPending())
+        {
+            submitVerify(client);
+            return;
+        }
         epoller->modfd(client->getFd(), connEvent | EPOLLOUT);
     }
     else
@@ -274,6 +673,32 @@ void WebServer::onProcess(HttpConnect* client)
     }
 }
 
+/*
+    把验证交给数据库线程池：
+        从入队到事件循环收到写事件（dealWrite）期间标记为验证中，超时回调只顺延不关闭连接；
+        队列已满时不查询数据库，直接生成 503 并监听写，否则连接（EPOLLONESHOT）不会再有事件。
+*/
+void WebServer::submitVerify(HttpConnect* client)
+{
+    client->trace(TRACE_SQL_ENQUEUE);
+    client->setVerifying(true);
+    if (!sqlThreadPool->addTask(std::bind(&WebServer::onSql, this, client)))
+    {
+        LOG_WARN("SQL task queue full, client[%d] gets 503", client->getFd());
+        client->rejectVerify();
+        epoller->modfd(client->getFd(), connEvent | EPOLLOUT);
+    }
+}
+
+// 数据库函数：验证用户并生成响应，完成后监听写（在数据库线程中执行）
+void WebServer::onSql(HttpConnect* client)
+{
+    assert(client);
+    client->trace(TRACE_SQL_START);
+    client->verify();
+    epoller->modfd(client->getFd(), connEvent | EPOLLOUT);
+}
+
 /* 
     写函数：发送响应报文，大文件需要分多次发送
     由于设置了 oneshot，需要再次监听读
@@ -281,17 +706,29 @@ void WebServer::onProcess(HttpConnect* client)
 void WebServer::onWrite(HttpConnect* client)
 {
     assert(client);
-    int ret = -1;
+    client->trace(TRACE_TASK_START);
+    if (!sendResponse(client)) return;
+    // 混合模式下继续在当前线程处理已经读入的请求（流水线）
+    if (execMode == EXEC_HYBRID) serve(client, false);
+    else onProcess(client);
+}
+
+/*
+    发送响应，发送完毕且保持连接时返回 true，由调用者处理下一个请求；
+    缓存满时继续监听写，其他情况关闭连接，都返回 false
+*/
+bool WebServer::sendResponse(HttpConnect* client)
+{
     int writeErrno = 0;
-    ret = client->write(&writeErrno);
+    ssize_t ret = client->write(&writeErrno);
     // 发送完毕
     if (client->toWriteBytes() == 0)
     {
+        client->endTrace(TRACE_DONE);
         // 传输完成    
         if (client->isKeepAlive())
         {
-            onProcess(client);
-            return;
+            return true;
         }
     }
     // 发送失败
@@ -301,11 +738,63 @@ void WebServer::onWrite(HttpConnect* client)
         if (writeErrno == EAGAIN)
         {
             epoller->modfd(client->getFd(), connEvent | EPOLLOUT);
-            return;
+            return false;
         }
     }
     // 其他原因导致，关闭连接
     closeConnect(client);
+    return false;
+}
+
+/*
+    混合模式的处理函数：处理读缓存中的请求并直接发送响应，直到需要等待读、写事件或交给其他线程
+
+    登录、注册交给数据库线程池；在事件循环中执行时（onLoop），较大或文件不在页缓存中的响应
+    交给请求线程池发送，避免读盘或大量拷贝阻塞事件循环。
+    小文件的请求因此不经过任务队列，省去两次跨线程切换和线程唤醒。
+*/
+void WebServer::serve(HttpConnect* client, bool onLoop)
+{
+    while (client->process())
+    {
+        if (client->isSqlPending())
+        {
+            submitVerify(client);
+            return;
+        }
+        if (onLoop && !client->isCheapWrite(inlineWriteBytes))
+        {
+            client->countPlacement(false);
+            client->trace(TRACE_ENQUEUE);
+            ThreadPool::instance()->addTask(std::bind(&WebServer::onWrite, this, client));
+            return;
+        }
+        client->countPlacement(onLoop);
+        if (!sendResponse(client)) return;
+    }
+    epoller->modfd(client->getFd(), connEvent | EPOLLIN);
+}
+
+// 设置套接字的内核忙轮询，失败（权限不足或内核不支持）只在第一次时警告
+void WebServer::setBusyPoll(int fd)
+{
+    static bool warned = false;
+    bool failed = false;
+    if (socketBusyPollUs > 0)
+    {
+        failed |= setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &socketBusyPollUs, sizeof(socketBusyPollUs)) < 0;
+    }
+    if (socketPreferBusyPoll)
+    {
+        int optval = 1;
+        failed |= setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &optval, sizeof(optval)) < 0;
+    }
+    if (failed && !warned)
+    {
+        warned = true;
+        LOG_WARN("Set socket busy poll error: %s (SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN)",
+                 strerror(errno));
+    }
 }
 
 // 创建监听套接字（设置属性，绑定端口，向epoll注册连接事件）
@@ -366,6 +855,8 @@ bool WebServer::initSocket()
         return false;
     }
 
+    setBusyPoll(listenFd);
+
     // 套接字设为可接受连接状态，并指明请求队列大小
     ret = listen(listenFd, 6);
     if (ret == -1)
@@ -5,16 +5,30 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
+#include <limits.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #include "epoller.h"
+#include "loopmonitor.h"
+#include "conntable.h"
+#include "cpuplacement.h"
+#include "../config/config.h"
 #include "../log/log.h"
 #include "../timer/heaptimer.h"
 #include "../sqlConnPool/sqlconnpool.h"
+#include "../sqlConnPool/sqlrouter.h"
 #include "../threadPool/threadpool.h"
 #include "../http/httpconnect.h"
+#include "../session/sessionstore.h"
+#include "../metrics/metrics.h"
+#include "../metrics/statsshm.h"
+#include "../metrics/tracer.h"
+#include "../metrics/alloctrack.h"
+#include "../userStore/mysqluserstore.h"
+#include "../userStore/localuserstore.h"
+#include "../buffer/bufferpool.h"
 
 using namespace std;
 
@@ -26,7 +40,8 @@ public:
         int sqlPort, const char* sqlUser, const char* sqlPwd,
         const char* dbName, int connPoolNum,
         int threadNum, int maxRequests,
-        bool openLog, int logLevel, int logQueSize);
+        bool openLog, int logLevel, int logQueSize,
+        const Config& config = Config());
     
     ~WebServer();
 
@@ -43,27 +58,66 @@ private:
     void sendError(int fd, const char* info);
     void extentTime(HttpConnect* client);
     void closeConnect(HttpConnect* client);
+    void onTimeout(HttpConnect* client);
 
     void onRead(HttpConnect* client);
     void onWrite(HttpConnect* client);
     void onProcess(HttpConnect* client);
+    void onSql(HttpConnect* client);
+    void submitVerify(HttpConnect* client);
+
+    bool receive(HttpConnect* client);
+    bool sendResponse(HttpConnect* client);
+    void serve(HttpConnect* client, bool onLoop);
+
+    void expireSessions();
+    void publishStats();
+    void reportLocks();
+    void reportAllocs();
+    void dumpTrace();
+    void initGauges(const Config& config);
+
+    bool initMemory(const Config& config);
+    void initPlacement(const Config& config);
+    bool initUserStore(int sqlPort, const char* sqlUser, const char* sqlPwd,
+                       const char* dbName, int connPoolNum, const Config& config);
 
     static const int MAX_FD = 65536;  // 最大的文件描述符的数量
+    static const int SESSION_TIMER_ID = INT_MAX; // 会话清理定时器的编号（与连接的描述符区分）
+    static const int STATS_TIMER_ID = INT_MAX - 1; // 统计段更新定时器的编号
+    static const int LOCK_TIMER_ID = INT_MAX - 2;  // 锁竞争报告定时器的编号
+    static const int ALLOC_TIMER_ID = INT_MAX - 3; // 内存分配报告定时器的编号
     static int setfdNonblock(int fd); // 设置文件描述符为非阻塞
+    void setBusyPoll(int fd);         // 按配置设置套接字的内核忙轮询
 
     int port;        // 端口
     bool openLinger; // 是否打开优雅关闭
     int timeoutMs;   // 毫秒MS
+    int sessionSweepMs; // 会话清理间隔
+    int statsIntervalMs; // 统计段更新间隔
+    int lockReportMs;    // 锁竞争报告间隔
+    int allocReportMs;   // 内存分配报告间隔
+    int loopCpu;         // 事件循环绑定的 CPU，-1 表示不绑定
+    int socketBusyPollUs;      // 套接字的 SO_BUSY_POLL，0 表示不设置
+    bool socketPreferBusyPoll; // 套接字的 SO_PREFER_BUSY_POLL
+    EXEC_MODE execMode;        // 请求的执行方式
+    size_t inlineWriteBytes;   // 混合模式下事件循环直接发送的响应上限
     bool isClose;   // 是否关闭
     int listenFd;    // 监听的文件描述符
     char* srcDir;    // 资源的目录
+    string traceDir; // 追踪文件的目录
 
     uint32_t listenEvent; // 监听的文件描述符的事件
     uint32_t connEvent;   // 连接的文件描述符的事件
 
+    LoopMonitor loopMonitor; // 主循环监控
+
     unique_ptr<HeapTimer> timer;           // 定时器
     unique_ptr<Epoller> epoller;           // epoll对象
-    unordered_map<int, HttpConnect> users; // 保存客户端连接的信息
+    unique_ptr<UserStore> userStore;       // 用户存储的后端
+    unique_ptr<StatsShm> statsShm;         // 共享内存统计段
+    ConnTable users;                       // 保存客户端连接的信息（按描述符索引）
+    unique_ptr<ThreadPool> sqlThreadPool;  // 数据库线程池，执行登录、注册的数据库操作（先于 users 析构）
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "sessionstore.h"
+#include "../metrics/alloctrack.h"
+
+#include <sys/random.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std;
+
+SessionStore::SessionStore()
+{
+    shardCapacity = (1 << 20) / SHARD_NUM;
+    ttl = chrono::minutes(30);
+}
+
+SessionStore* SessionStore::instance()
+{
+    static SessionStore store;
+    return &store;
+}
+
+void SessionStore::init(int ttlMs, size_t maxSessions)
+{
+    ttl = chrono::milliseconds(ttlMs);
+    shardCapacity = maxSessions / SHARD_NUM;
+    if (shardCapacity == 0) shardCapacity = 1;
+}
+
+/*
+    生成随机编号
+    每个线程缓存一块系统随机数（getrandom），用完再取，避免每次登录一次系统调用。
+*/
+SessionStore::SessionId SessionStore::randomId()
+{
+    static thread_local unsigned char pool[4096];
+    static thread_local size_t used = sizeof(pool);
+
+    if (used + sizeof(SessionId) > sizeof(pool))
+    {
+        size_t filled = 0;
+        while (filled < sizeof(pool))
+        {
+            ssize_t n = getrandom(pool + filled, sizeof(pool) - filled, 0);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                // 内核不支持 getrandom 时从 /dev/urandom 读取
+                int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+                n = fd < 0 ? -1 : read(fd, pool + filled, sizeof(pool) - filled);
+                if (fd >= 0) close(fd);
+                if (n <= 0) abort();
+            }
+            filled += n;
+        }
+        used = 0;
+    }
+    SessionId id;
+    memcpy(&id, pool + used, sizeof(id));
+    // 用过的随机数清零，避免之后从内存中恢复出其他会话的编号
+    memset(pool + used, 0, sizeof(id));
+    used += sizeof(id);
+    return id;
+}
+
+string SessionStore::formatId(const SessionId& id)
+{
+    static const char HEX[] = "0123456789abcdef";
+    string sid(32, '0');
+    for (int i = 0; i < 16; i ++)
+    {
+        sid[15 - i] = HEX[(id.hi >> (i * 4)) & 0xf];
+        sid[31 - i] = HEX[(id.lo >> (i * 4)) & 0xf];
+    }
+    return sid;
+}
+
+bool SessionStore::parseId(const string& sid, SessionId& id)
+{
+    if (sid.size() != 32) return false;
+    id.hi = id.lo = 0;
+    for (int i = 0; i < 32; i ++)
+    {
+        char ch = sid[i];
+        uint64_t v;
+        if (ch >= '0' && ch <= '9') v = ch - '0';
+        else if (ch >= 'a' && ch <= 'f') v = ch - 'a' + 10;
+        else return false;
+        uint64_t& part = i < 16 ? id.hi : id.lo;
+        part = (part << 4) | v;
+    }
+    return true;
+}
+
+string SessionStore::create(const string& user)
+{
+    ALLOC_SCOPE(ALLOC_SESSION);
+    SessionId id = randomId();
+    Shard& shard = shardOf(id);
+    lock_guard<mutex> locker(shard.mtx);
+    // 分片已满，淘汰最久未访问的会话
+    if (shard.items.size() >= shardCapacity)
+    {
+        shard.index.erase(shard.items.front().id);
+        shard.items.pop_front();
+    }
+    shard.items.push_back({id, user, Clock::now() + ttl});
+    shard.index[id] = prev(shard.items.end());
+    return formatId(id);
+}
+
+bool SessionStore::lookup(const string& sid, string& user)
+{
+    SessionId id;
+    if (!parseId(sid, id)) return false;
+    Shard& shard = shardOf(id);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.index.find(id);
+    if (it == shard.index.end()) return false;
+
+    Clock::time_point now = Clock::now();
+    if (it->second->expires <= now)
+    {
+        shard.items.erase(it->second);
+        shard.index.erase(it);
+        return false;
+    }
+    // 刷新到期时间，移到表尾
+    it->second->expires = now + ttl;
+    shard.items.splice(shard.items.end(), shard.items, it->second);
+    user = it->second->user;
+    return true;
+}
+
+void SessionStore::erase(const string& sid)
+{
+    SessionId id;
+    if (!parseId(sid, id)) return;
+    Shard& shard = shardOf(id);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.index.find(id);
+    if (it == shard.index.end()) return;
+    shard.items.erase(it->second);
+    shard.index.erase(it);
+}
+
+size_t SessionStore::expire()
+{
+    size_t cnt = 0;
+    Clock::time_point now = Clock::now();
+    for (Shard& shard : shards)
+    {
+        lock_guard<mutex> locker(shard.mtx);
+        while (!shard.items.empty() && shard.items.front().expires <= now)
+        {
+            shard.index.erase(shard.items.front().id);
+            shard.items.pop_front();
+            cnt ++;
+        }
+    }
+    return cnt;
+}
+
+size_t SessionStore::size()
+{
+    size_t cnt = 0;
+    for (Shard& shard : shards)
+    {
+        lock_guard<mutex> locker(shard.mtx);
+        cnt += shard.items.size();
+    }
+    return cnt;
+}
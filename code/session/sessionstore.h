@@ -0,0 +1,95 @@
+/*
+    会话存储
+
+    登录成功后生成 128 位随机会话编号，通过 Cookie（sid）发给客户端，
+    之后的请求带上 Cookie，直接在内存中找到用户名，不需要再查询数据库。
+
+    会话按编号分到多个分片，每个分片一把互斥锁、一个链表和一个哈希表（与 LruCache 相同）：
+        链表按最近访问的顺序排列，所有会话的有效期相同，表头的会话最先过期；
+        访问会话时刷新到期时间并移到表尾（滑动过期）。
+    过期清理由服务器的定时器周期性调用 expire，每个分片只从表头删除过期的会话，开销与过期数量成正比。
+    分片满时淘汰表头（最久未访问）的会话。
+*/
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <unordered_map>
+#include <stdint.h>
+
+using namespace std;
+
+class SessionStore
+{
+public:
+    static SessionStore* instance();
+
+    // 会话有效期（毫秒），最多保存的会话数
+    void init(int ttlMs, size_t maxSessions);
+
+    // 为用户创建会话，返回会话编号（32 位十六进制字符串）
+    string create(const string& user);
+
+    // 查找会话对应的用户名，并刷新到期时间；编号无效或已过期返回 false
+    bool lookup(const string& sid, string& user);
+
+    void erase(const string& sid);
+
+    // 删除所有过期的会话，返回删除的数量
+    size_t expire();
+
+    size_t size();
+
+    int getTtlMs() const { return (int)ttl.count(); }
+
+private:
+    SessionStore();
+    ~SessionStore() = default;
+
+    typedef chrono::steady_clock Clock;
+
+    // 会话编号：128 位随机数
+    struct SessionId
+    {
+        uint64_t hi;
+        uint64_t lo;
+        bool operator==(const SessionId& other) const { return hi == other.hi && lo == other.lo; }
+    };
+
+    struct SessionIdHash
+    {
+        // 编号本身是随机数，直接取低位
+        size_t operator()(const SessionId& id) const { return id.lo; }
+    };
+
+    struct Session
+    {
+        SessionId id;
+        string user;
+        Clock::time_point expires; // 到期时间
+    };
+
+    struct Shard
+    {
+        mutex mtx;
+        list<Session> items; // 按访问顺序排列，表头最旧
+        unordered_map<SessionId, list<Session>::iterator, SessionIdHash> index;
+    };
+
+    static const size_t SHARD_NUM = 64;
+
+    static bool parseId(const string& sid, SessionId& id);
+    static string formatId(const SessionId& id);
+    static SessionId randomId();
+
+    Shard& shardOf(const SessionId& id) { return shards[(id.hi >> 32) % SHARD_NUM]; }
+
+    Shard shards[SHARD_NUM];
+    size_t shardCapacity;     // 每个分片最多保存的会话数
+    chrono::milliseconds ttl; // 会话有效期
+};
+
+#endif
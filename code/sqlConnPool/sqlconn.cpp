@@ -0,0 +1,76 @@
+#include "sqlconn.h"
+
+#include <string.h>
+#include "../log/log.h"
+
+SqlConn::SqlConn(MYSQL* sql)
+{
+    this->sql = sql;
+    this->slot = -1;
+    this->inUse = false;
+    for (int i = 0; i < MAX_STMTS; i ++)
+    {
+        stmts[i] = nullptr;
+    }
+    touch();
+}
+
+SqlConn::~SqlConn()
+{
+    closeStmts();
+    if (sql)
+    {
+        mysql_close(sql);
+    }
+}
+
+void SqlConn::reset(MYSQL* sql)
+{
+    closeStmts();
+    if (this->sql)
+    {
+        mysql_close(this->sql);
+    }
+    this->sql = sql;
+    touch();
+}
+
+MYSQL_STMT* SqlConn::stmt(int id, const char* query)
+{
+    assert(id >= 0 && id < MAX_STMTS);
+    if (stmts[id]) return stmts[id];
+    if (!sql) return nullptr;
+
+    MYSQL_STMT* stmt = mysql_stmt_init(sql);
+    if (!stmt)
+    {
+        LOG_ERROR("MySQL stmt init error!");
+        return nullptr;
+    }
+    if (mysql_stmt_prepare(stmt, query, strlen(query)))
+    {
+        LOG_ERROR("MySQL prepare error: %s", mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    stmts[id] = stmt;
+    return stmt;
+}
+
+void SqlConn::closeStmt(int id)
+{
+    assert(id >= 0 && id < MAX_STMTS);
+    if (stmts[id])
+    {
+        mysql_stmt_close(stmts[id]);
+        stmts[id] = nullptr;
+    }
+}
+
+void SqlConn::closeStmts()
+{
+    for (int i = 0; i < MAX_STMTS; i ++)
+    {
+        closeStmt(i);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef SQL_CONN_H
+#define SQL_CONN_H
+
+#include <mysql/mysql.h>
+#include <assert.h>
+#include <stdint.h>
+#include <chrono>
+
+// MySQL 8.0 的客户端库移除了 my_bool，MariaDB 仍然保留
+#if !defined(MARIADB_BASE_VERSION) && !defined(MARIADB_VERSION_ID) && MYSQL_VERSION_ID >= 80000
+typedef bool my_bool;
+#endif
+
+/*
+    连接池中的一个连接
+
+    除了 MYSQL 句柄，还缓存在该连接上预处理过的语句（MYSQL_STMT）。
+    语句在第一次使用时 prepare，之后同一连接上的请求直接复用，MySQL 不需要重复解析 SQL。
+    预处理语句只属于创建它的连接，连接被取出后由使用者独占，因此不需要加锁。
+*/
+class SqlConn
+{
+public:
+    static const int MAX_STMTS = 8; // 每个连接最多缓存的语句数量
+
+    explicit SqlConn(MYSQL* sql);
+    ~SqlConn();
+
+    MYSQL* get() const { return sql; }
+
+    // 连接断开后换成新的 MYSQL 句柄，旧的语句一起关闭
+    void reset(MYSQL* sql);
+
+    // 连接池分配的槽位，无锁空闲栈用槽位下标串联连接
+    int getSlot() const { return slot; }
+    void setSlot(int slot) { this->slot = slot; }
+
+    // 线程独占模式下，标记绑定的连接是否正在使用（只由所属线程访问）
+    bool inUse;
+
+    // 获取编号为 id 的预处理语句，第一次使用时 prepare
+    MYSQL_STMT* stmt(int id, const char* query);
+
+    // 关闭语句（执行出错或连接重建后，旧的语句句柄不再可用）
+    void closeStmt(int id);
+    void closeStmts();
+
+    // 记录归还连接池的时间，用于空闲回收（使用过的连接也视为检查过）
+    void touch() { lastUsed = lastChecked = std::chrono::steady_clock::now(); }
+    int64_t idleMs() const { return sinceMs(lastUsed); }
+
+    // 记录健康检查（ping）的时间，不影响空闲时间，空闲的连接仍然会被回收
+    void checked() { lastChecked = std::chrono::steady_clock::now(); }
+    int64_t uncheckedMs() const { return sinceMs(lastChecked); }
+
+private:
+    static int64_t sinceMs(std::chrono::steady_clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - t).count();
+    }
+
+    MYSQL* sql;
+    int slot;
+    MYSQL_STMT* stmts[MAX_STMTS];
+    std::chrono::steady_clock::time_point lastUsed;
+    std::chrono::steady_clock::time_point lastChecked;
+};
+
+#endif
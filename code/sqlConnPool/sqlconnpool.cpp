@@ -1,55 +1,253 @@
 #include "sqlconnpool.h"
+#include "sqlrouter.h"
+
+#include <algorithm>
 
 using namespace std;
 
+// SqlPoolStats
+uint64_t SqlPoolStats::waitPercentile(double p) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < WAIT_BUCKETS; i ++) total += waitHist[i];
+    if (total == 0) return 0;
+
+    uint64_t rank = total * p;
+    uint64_t cnt = 0;
+    for (int i = 0; i < WAIT_BUCKETS; i ++)
+    {
+        cnt += waitHist[i];
+        if (cnt > rank) return i == 0 ? 0 : (1ULL << i);
+    }
+    return 1ULL << (WAIT_BUCKETS - 1);
+}
+
+// 线程独占模式下，每个线程在各个连接池中绑定的连接
+static SqlConn*& boundConn(int poolId)
+{
+    static thread_local SqlConn* conns[SqlConnPool::MAX_POOLS] = {nullptr};
+    return conns[poolId];
+}
+
+// 当前线程是否可以绑定连接（见 bindThisThread）
+static bool& bindable()
+{
+    static thread_local bool on = false;
+    return on;
+}
+
 // SqlConnPool
-SqlConnPool::SqlConnPool()
+atomic<int> SqlConnPool::poolCnt(0);
+
+SqlConnPool::SqlConnPool(): mtxPool("sqlpool"), condFree("sqlpool.free"), condMaintain("sqlpool.maintain")
 {
+    port = 0;
+    minConnCnt = maxConnCnt = 0;
+    waitTimeoutMs = -1;
+    idleTimeoutMs = pingIntervalMs = 0;
+    threadAffine = false;
+    poolId = poolCnt ++;
+    assert(poolId < MAX_POOLS);
+    totalConnCnt = 0;
     useConnCnt = 0;
-    freeConnCnt = 0;
+    waiterCnt = 0;
+    isClose = true;
+    timeoutCnt = 0;
+    connectErrCnt = 0;
+    for (int i = 0; i < SqlPoolStats::WAIT_BUCKETS; i ++)
+    {
+        waitHist[i] = 0;
+    }
 }
 
 void SqlConnPool::init(
     const char* host, int port, 
     const char* user, const char* pwd,
-    const char* dbName, int maxConnCnt = 10)
+    const char* dbName, int maxConnCnt,
+    int minConnCnt, int waitTimeoutMs,
+    int idleTimeoutMs, int pingIntervalMs,
+    bool threadAffine)
 {
     assert(maxConnCnt > 0);
-    for (int i = 0; i < maxConnCnt; i ++)
+    if (minConnCnt <= 0 || minConnCnt > maxConnCnt)
     {
-        MYSQL *sql = nullptr;
-        sql = mysql_init(sql);
-        if (!sql)
-        {
-            LOG_ERROR("MySQL init error!");
-            assert(sql);
-        }
-        sql = mysql_real_connect(sql, host, user, pwd, dbName, port, nullptr, 0);
-        if (!sql)
+        minConnCnt = maxConnCnt;
+    }
+    this->host = host;
+    this->port = port;
+    this->user = user;
+    this->pwd = pwd;
+    this->dbName = dbName;
+    this->minConnCnt = minConnCnt;
+    this->maxConnCnt = maxConnCnt;
+    this->waitTimeoutMs = waitTimeoutMs;
+    this->idleTimeoutMs = idleTimeoutMs;
+    this->pingIntervalMs = pingIntervalMs;
+    this->threadAffine = threadAffine;
+    isClose = false;
+
+    // 每个连接占用一个槽位，槽位数等于最大连接数
+    spareConns.init(maxConnCnt);
+    for (int i = maxConnCnt - 1; i >= 0; i --)
+    {
+        freeSlots.push_back(i);
+    }
+
+    // 客户端库的全局初始化不是线程安全的，先于并行建立连接完成
+    mysql_library_init(0, nullptr, nullptr);
+
+    // 并行建立最少连接数个连接，连接失败的不放入连接池，之后按需重建
+    vector<SqlConn*> conns(minConnCnt, nullptr);
+    vector<thread> connectors;
+    for (int i = 0; i < minConnCnt; i ++)
+    {
+        connectors.emplace_back([this, &conns, i] { conns[i] = connect(); });
+    }
+    for (auto& connector : connectors)
+    {
+        connector.join();
+    }
+
+    mtxPool.lock();
+    for (SqlConn* conn : conns)
+    {
+        if (conn)
         {
-            LOG_ERROR("MySQL Connect error");
+            putIdle(conn);
+            totalConnCnt ++;
         }
-        connQue.push(sql);
     }
-    this->freeConnCnt = maxConnCnt;
+    mtxPool.unlock();
+    if (totalConnCnt < minConnCnt)
+    {
+        LOG_ERROR("SqlConnPool: only %d of %d connections established", totalConnCnt, minConnCnt);
+    }
+
+    maintainThread = thread(&SqlConnPool::maintain, this);
+}
+
+// 建立 MySQL 连接，失败返回 nullptr
+MYSQL* SqlConnPool::connectRaw()
+{
+    MYSQL *sql = mysql_init(nullptr);
+    if (!sql)
+    {
+        LOG_ERROR("MySQL init error!");
+        connectErrCnt ++;
+        return nullptr;
+    }
+    unsigned int connectTimeout = 3;
+    mysql_options(sql, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout);
+    if (!mysql_real_connect(sql, host.c_str(), user.c_str(), pwd.c_str(),
+                            dbName.c_str(), port, nullptr, 0))
+    {
+        LOG_ERROR("MySQL Connect error: %s", mysql_error(sql));
+        mysql_close(sql);
+        connectErrCnt ++;
+        return nullptr;
+    }
+    return sql;
+}
+
+// 新建连接并分配槽位，失败返回 nullptr（调用者已经占用了连接数名额）
+SqlConn* SqlConnPool::connect()
+{
+    MYSQL *sql = connectRaw();
+    if (!sql) return nullptr;
+    SqlConn* conn = new SqlConn(sql);
+    mtxPool.lock();
+    assert(!freeSlots.empty());
+    conn->setSlot(freeSlots.back());
+    freeSlots.pop_back();
+    mtxPool.unlock();
+    return conn;
+}
+
+void SqlConnPool::closeConn(SqlConn* conn)
+{
+    mtxPool.lock();
+    freeSlots.push_back(conn->getSlot());
+    mtxPool.unlock();
+    delete conn;
+}
+
+// 放回空闲连接（持有锁）
+void SqlConnPool::putIdle(SqlConn* conn)
+{
+    if (threadAffine)
+    {
+        spareConns.push(conn);
+    }
+    else
+    {
+        connQue.push_back(conn);
+    }
+}
 
-    mtxPool = new mtx();
-    semFree = new sem(maxConnCnt);
+bool SqlConnPool::checkAlive(SqlConn* conn)
+{
+    if (conn->uncheckedMs() < pingIntervalMs) return true;
+    if (mysql_ping(conn->get()) != 0)
+    {
+        LOG_WARN("SqlConnPool: connection lost, reconnecting");
+        MYSQL* sql = connectRaw();
+        if (!sql) return false;
+        conn->reset(sql);
+    }
+    conn->touch();
+    return true;
+}
+
+void SqlConnPool::dropConn(SqlConn* conn)
+{
+    mtxPool.lock();
+    auto it = find(boundConns.begin(), boundConns.end(), conn);
+    if (it != boundConns.end()) boundConns.erase(it);
+    totalConnCnt --;
+    mtxPool.unlock();
+    closeConn(conn);
+    // 空出了名额，等待的线程可以新建连接
+    condFree.signal();
 }
 
 void SqlConnPool::destroy()
 {
-    this->mtxPool->lock();
+    mtxPool.lock();
+    if (isClose)
+    {
+        mtxPool.unlock();
+        return;
+    }
+    isClose = true;
+    mtxPool.unlock();
+    condMaintain.broadcast();
+    condFree.broadcast();
+    if (maintainThread.joinable())
+    {
+        maintainThread.join();
+    }
+
+    mtxPool.lock();
     while (!connQue.empty())
     {
-        MYSQL* item = connQue.front();
-        connQue.pop();
-        mysql_close(item);
+        SqlConn* item = connQue.front();
+        connQue.pop_front();
+        delete item; // 关闭预处理语句和连接
+        totalConnCnt --;
     }
-    this->mtxPool->unlock();
-    delete(mtxPool);
-    delete(semFree);
-    mysql_library_end();
+    while (SqlConn* item = spareConns.pop())
+    {
+        delete item;
+        totalConnCnt --;
+    }
+    // 绑定到线程的连接此时不再使用
+    for (SqlConn* item : boundConns)
+    {
+        delete item;
+        totalConnCnt --;
+    }
+    boundConns.clear();
+    mtxPool.unlock();
 }
 
 SqlConnPool* SqlConnPool::instance()
@@ -58,41 +256,352 @@ SqlConnPool* SqlConnPool::instance()
     return &connPool;
 }
 
-MYSQL* SqlConnPool::getConn()
+void SqlConnPool::bindThisThread()
 {
-    MYSQL *sql = nullptr;
-    if(connQue.empty()){
-        LOG_WARN("SqlConnPool busy!");
+    bindable() = true;
+}
+
+/*
+    获取连接
+        线程独占模式：优先使用本线程绑定的连接，其次从无锁栈中取空闲连接；
+                      调用过 bindThisThread 且还没有绑定连接的线程，绑定取到的连接；
+        有空闲连接，直接取出最近归还的连接；
+        没有空闲连接且未达到最大连接数，新建连接；
+        否则等待其他线程归还，超过 timeoutMs 返回 nullptr；
+        取到的连接断开且重建失败（数据库不可用）时丢弃它，返回 nullptr。
+*/
+SqlConn* SqlConnPool::getConn(int timeoutMs, bool* connectFailed)
+{
+    if (connectFailed) *connectFailed = false;
+    if (!threadAffine)
+    {
+        return getSharedConn(timeoutMs, connectFailed);
+    }
+
+    // 本线程绑定的连接：不需要任何同步
+    SqlConn*& bound = boundConn(poolId);
+    if (bound && !bound->inUse)
+    {
+        bound->inUse = true;
+        if (checkAlive(bound)) return bound;
+        // 重建失败，解除绑定，按未绑定的线程获取
+        dropConn(bound);
+        bound = nullptr;
+    }
+
+    SqlConn* conn = spareConns.pop();
+    if (conn)
+    {
+        useConnCnt ++;
+        recordWait(0);
+    }
+    else
+    {
+        conn = getSharedConn(timeoutMs, connectFailed);
+        if (!conn) return nullptr;
+    }
+    conn->inUse = true;
+    if (!checkAlive(conn))
+    {
+        useConnCnt --;
+        dropConn(conn);
+        if (connectFailed) *connectFailed = true;
         return nullptr;
     }
 
-    this->semFree->wait();
-    this->mtxPool->lock();
-    sql = connQue.front();
-    connQue.pop();
-    this->useConnCnt ++;
-    this->freeConnCnt --;
-    this->mtxPool->unlock();
-    
-    return sql;
+    // 本线程允许绑定且还没有绑定连接，绑定这个连接；其他线程用完后归还到无锁栈
+    if (!bound && bindable())
+    {
+        bound = conn;
+        useConnCnt --;
+        mtxPool.lock();
+        boundConns.push_back(conn);
+        mtxPool.unlock();
+    }
+    return conn;
 }
 
-void SqlConnPool::freeConn(MYSQL *sql)
+// 加锁获取连接
+SqlConn* SqlConnPool::getSharedConn(int timeoutMs, bool* connectFailed)
 {
-    assert(sql);
-    this->mtxPool->lock();
-    connQue.push(sql);
-    this->useConnCnt --;
-    this->freeConnCnt ++;
-    this->mtxPool->unlock();
-    this->semFree->post();
+    if (timeoutMs == -2)
+    {
+        timeoutMs = waitTimeoutMs;
+    }
+    auto start = chrono::steady_clock::now();
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeoutMs > 0)
+    {
+        deadline.tv_sec += timeoutMs / 1000;
+        deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec ++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    SqlConn *conn = nullptr;
+    bool timeout = false;
+    mtxPool.lock();
+    while (!isClose)
+    {
+        // 先登记等待再检查无锁栈，保证归还连接的线程能看到等待者
+        waiterCnt ++;
+        if (threadAffine && (conn = spareConns.pop()))
+        {
+            waiterCnt --;
+            break;
+        }
+        if (!connQue.empty())
+        {
+            waiterCnt --;
+            conn = connQue.back();
+            connQue.pop_back();
+            break;
+        }
+        if (totalConnCnt < maxConnCnt)
+        {
+            waiterCnt --;
+            // 先占用名额，建立连接时不持有锁
+            totalConnCnt ++;
+            mtxPool.unlock();
+            conn = connect();
+            mtxPool.lock();
+            if (!conn)
+            {
+                totalConnCnt --;
+                if (connectFailed) *connectFailed = true;
+            }
+            break;
+        }
+        // 不等待的探测（如路由轮询副本）取不到连接是正常情况，不计为超时
+        if (timeoutMs == 0)
+        {
+            waiterCnt --;
+            mtxPool.unlock();
+            return nullptr;
+        }
+        if (timeoutMs < 0)
+        {
+            condFree.wait(mtxPool);
+        }
+        else if (!condFree.timewait(mtxPool, deadline) && connQue.empty() && spareConns.size() == 0)
+        {
+            timeout = true;
+        }
+        waiterCnt --;
+        if (timeout) break;
+    }
+    if (conn) { useConnCnt ++; }
+    mtxPool.unlock();
+
+    recordWait(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+    if (timeout)
+    {
+        timeoutCnt ++;
+        LOG_WARN("SqlConnPool busy!");
+    }
+    return conn;
+}
+
+void SqlConnPool::freeConn(SqlConn *conn)
+{
+    assert(conn);
+    conn->touch();
+    if (threadAffine)
+    {
+        conn->inUse = false;
+        // 本线程绑定的连接：不需要任何同步
+        if (conn == boundConn(poolId)) return;
+
+        useConnCnt --;
+        spareConns.push(conn);
+        // 有线程在加锁路径上等待，唤醒它
+        if (waiterCnt > 0)
+        {
+            mtxPool.lock();
+            mtxPool.unlock();
+            condFree.signal();
+        }
+        return;
+    }
+
+    mtxPool.lock();
+    connQue.push_back(conn);
+    useConnCnt --;
+    mtxPool.unlock();
+    condFree.signal();
 }
 
 int SqlConnPool::getFreeConnCnt()
 {
-    this->mtxPool->lock();
-    return connQue.size();
-    this->mtxPool->unlock();
+    mtxPool.lock();
+    int cnt = connQue.size() + spareConns.size();
+    mtxPool.unlock();
+    return cnt;
+}
+
+SqlPoolStats SqlConnPool::getStats()
+{
+    SqlPoolStats stats;
+    mtxPool.lock();
+    stats.totalConnCnt = totalConnCnt;
+    stats.useConnCnt = useConnCnt;
+    stats.boundConnCnt = boundConns.size();
+    stats.freeConnCnt = connQue.size() + spareConns.size();
+    stats.waiterCnt = waiterCnt;
+    mtxPool.unlock();
+    stats.timeoutCnt = timeoutCnt;
+    stats.connectErrCnt = connectErrCnt;
+    for (int i = 0; i < SqlPoolStats::WAIT_BUCKETS; i ++)
+    {
+        stats.waitHist[i] = waitHist[i];
+    }
+    return stats;
+}
+
+// 按等待时间的二进制位数分桶
+void SqlConnPool::recordWait(int64_t us)
+{
+    int bucket = 0;
+    while (us > 0 && bucket < SqlPoolStats::WAIT_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket ++;
+    }
+    waitHist[bucket].fetch_add(1, memory_order_relaxed);
+}
+
+/*
+    维护线程，每隔一段时间：
+        关闭空闲超时且超过最少连接数的连接；
+        ping 距上次检查超过检查间隔的空闲连接（不重置空闲时间），断开的连接重建；
+        连接数不足最少连接数时补足；
+        定期输出连接池状态。
+*/
+void SqlConnPool::maintain()
+{
+    const int intervalMs = 1000;
+    int logElapsedMs = 0;
+    while (true)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += intervalMs / 1000;
+
+        // 取出需要检查的空闲连接，检查期间其他线程不会拿到它们
+        vector<SqlConn*> idle, expired;
+        mtxPool.lock();
+        if (!isClose)
+        {
+            condMaintain.timewait(mtxPool, deadline);
+        }
+        if (isClose)
+        {
+            mtxPool.unlock();
+            break;
+        }
+        // 空闲超时的连接关闭，空闲超过检查间隔的连接取出 ping，返回是否取出
+        auto take = [&](SqlConn* conn) {
+            if (totalConnCnt - (int)expired.size() > minConnCnt && conn->idleMs() >= idleTimeoutMs)
+            {
+                expired.push_back(conn);
+                return true;
+            }
+            if (conn->uncheckedMs() >= pingIntervalMs)
+            {
+                idle.push_back(conn);
+                return true;
+            }
+            return false;
+        };
+        for (auto it = connQue.begin(); it != connQue.end(); )
+        {
+            if (take(*it)) it = connQue.erase(it);
+            else ++ it;
+        }
+        // 线程独占模式的空闲连接在无锁栈中：全部取出检查，其余按原来的顺序放回
+        // （持有锁，其他线程此时不会因为栈暂时为空而新建连接）
+        if (threadAffine)
+        {
+            vector<SqlConn*> spare;
+            while (SqlConn* conn = spareConns.pop()) spare.push_back(conn);
+            for (auto it = spare.rbegin(); it != spare.rend(); ++ it)
+            {
+                if (!take(*it)) spareConns.push(*it);
+            }
+        }
+        totalConnCnt -= expired.size();
+        // 先占用补足的名额，保证总连接数不超过最大连接数
+        int lack = max(0, minConnCnt - totalConnCnt);
+        totalConnCnt += lack;
+        mtxPool.unlock();
+
+        for (SqlConn* conn : expired)
+        {
+            closeConn(conn);
+        }
+
+        // 健康检查，断开的连接重建
+        vector<SqlConn*> alive;
+        int failed = 0;
+        for (SqlConn* conn : idle)
+        {
+            if (mysql_ping(conn->get()) == 0)
+            {
+                conn->checked();
+                alive.push_back(conn);
+                continue;
+            }
+            LOG_WARN("SqlConnPool: connection lost, reconnecting");
+            MYSQL* sql = connectRaw();
+            if (sql)
+            {
+                conn->reset(sql);
+                alive.push_back(conn);
+            }
+            else
+            {
+                closeConn(conn);
+                failed ++;
+            }
+        }
+
+        // 补足最少连接数
+        for (int i = 0; i < lack; i ++)
+        {
+            SqlConn* newConn = connect();
+            if (newConn) alive.push_back(newConn);
+            else failed ++;
+        }
+
+        mtxPool.lock();
+        for (SqlConn* conn : alive)
+        {
+            putIdle(conn);
+        }
+        // 重建失败的连接不再占用名额
+        totalConnCnt -= failed;
+        mtxPool.unlock();
+        if (!alive.empty())
+        {
+            condFree.broadcast();
+        }
+
+        logElapsedMs += intervalMs;
+        if (logElapsedMs >= 60000)
+        {
+            logElapsedMs = 0;
+            SqlPoolStats stats = getStats();
+            LOG_INFO("SqlConnPool total:%d use:%d bound:%d free:%d waiters:%d timeouts:%llu wait p50:%lluus p99:%lluus",
+                     stats.totalConnCnt, stats.useConnCnt, stats.boundConnCnt, stats.freeConnCnt, stats.waiterCnt,
+                     (unsigned long long)stats.timeoutCnt,
+                     (unsigned long long)stats.waitPercentile(0.5),
+                     (unsigned long long)stats.waitPercentile(0.99));
+        }
+    }
 }
 
 SqlConnPool::~SqlConnPool()
@@ -101,18 +610,29 @@ SqlConnPool::~SqlConnPool()
 }
 
 // SqlConnect
-SqlConnect::SqlConnect(MYSQL** sql, SqlConnPool *sqlConnPool)
+SqlConnect::SqlConnect(SqlConn** conn, SqlConnPool *sqlConnPool)
 {
     assert(sqlConnPool);
-    *sql = sqlConnPool->getConn();
-    this->sql = *sql;
+    *conn = sqlConnPool->getConn();
+    this->conn = *conn;
     this->sqlConnPool = sqlConnPool;
 }
 
+SqlConnect::SqlConnect(SqlConn** conn, SQL_ROUTE route)
+{
+    *conn = SqlRouter::instance()->getConn(route, &this->sqlConnPool);
+    this->conn = *conn;
+}
+
+void SqlConnect::reportError()
+{
+    SqlRouter::instance()->reportError(this->sqlConnPool);
+}
+
 SqlConnect::~SqlConnect()
 {
-    if (this->sql)
+    if (this->conn)
     {
-        this->sqlConnPool->freeConn(this->sql);
+        this->sqlConnPool->freeConn(this->conn);
     }
 }
@@ -3,52 +3,151 @@
 
 #include <mysql/mysql.h>
 #include <string>
-#include <queue>
+#include <deque>
+#include <vector>
 #include <thread>
+#include <atomic>
+#include <chrono>
 #include "../lock/locker.h"
 #include <mutex>
 #include <semaphore.h>
 #include "../log/log.h"
+#include "sqlconn.h"
+#include "sqlconnstack.h"
 
 using namespace std;
 
+// 连接池的运行状态，用于调整连接数和等待时间
+struct SqlPoolStats
+{
+    static const int WAIT_BUCKETS = 24;
+
+    int totalConnCnt;     // 已建立的连接数
+    int useConnCnt;       // 正在使用的连接数（不包括线程独占的连接）
+    int boundConnCnt;     // 线程独占的连接数
+    int freeConnCnt;      // 空闲的连接数
+    int waiterCnt;        // 正在等待连接的线程数
+    uint64_t timeoutCnt;  // 等待超时的次数
+    uint64_t connectErrCnt; // 建立连接失败的次数
+    // 获取连接的等待时间直方图，第 i 个桶统计 [2^(i-1), 2^i) 微秒，第 0 个桶统计 0 微秒
+    uint64_t waitHist[WAIT_BUCKETS];
+
+    // 等待时间的分位数上界（微秒）
+    uint64_t waitPercentile(double p) const;
+};
+
+/*
+    弹性连接池
+        启动时并行建立 minConnCnt 个连接；
+        空闲连接不足时按需新建，最多 maxConnCnt 个；
+        超过 minConnCnt 的连接空闲 idleTimeoutMs 后关闭；
+        维护线程定期 ping 空闲连接，断开的连接重新建立；
+        getConn 最多等待 waitTimeoutMs，超时返回 nullptr，调用者可以返回 503。
+
+    线程独占模式（threadAffine）
+        调用过 bindThisThread 的线程（数据库线程池的工作线程）第一次获取连接后，
+        该连接就绑定到这个线程（thread_local），之后同一线程获取、归还连接都不需要任何同步；
+        其他线程（启动时的预热、偶尔访问数据库的线程）不绑定，用完即归还到无锁栈，
+        否则连接会被永远占在不再访问数据库的线程上，数据库线程反而取不到连接；
+        未绑定的空闲连接放在无锁栈中，同一线程同时需要第二个连接时从栈中取出，用完放回；
+        栈为空时才退回到加锁的路径（新建连接或等待）。
+        绑定的连接不经过维护线程，使用前空闲超过检查间隔时由所属线程 ping，重建失败时解除绑定并丢弃；
+        无锁栈中的空闲连接与普通模式一样由维护线程检查和回收。
+*/
 class SqlConnPool
 {
 public:
+    SqlConnPool();
+    ~SqlConnPool();
+
     void init(const char* host, int port,
               const char* user, const char* pwd,
-              const char* dbName, int maxConnCnt);
+              const char* dbName, int maxConnCnt,
+              int minConnCnt = 0, int waitTimeoutMs = -1,
+              int idleTimeoutMs = 60000, int pingIntervalMs = 30000,
+              bool threadAffine = false);
     
     void destroy();
 
+    // 默认的连接池（主库）
     static SqlConnPool *instance();
 
-    MYSQL *getConn();
-    void freeConn(MYSQL *conn);
+    // 获取连接，timeoutMs：-2 使用 init 时的等待时间，-1 一直等待，0 不等待
+    // 因为建立（或重建）连接失败而返回 nullptr 时，connectFailed 置为 true，区别于没有空闲连接
+    SqlConn *getConn(int timeoutMs = -2, bool* connectFailed = nullptr);
+    void freeConn(SqlConn *conn);
     int getFreeConnCnt();
+    // 线程独占模式下，允许当前线程在各个连接池中绑定连接（线程启动时调用）
+    static void bindThisThread();
+    SqlPoolStats getStats();
+
+    static const int MAX_POOLS = 16; // 线程独占模式下，每个线程最多绑定的连接池数量
 
 private:
-    SqlConnPool();
-    ~SqlConnPool();
+    MYSQL *connectRaw();             // 建立 MySQL 连接（不持有锁）
+    SqlConn *connect();              // 新建连接并分配槽位（不持有锁）
+    void closeConn(SqlConn *conn);   // 关闭连接并回收槽位（不持有锁）
+    bool checkAlive(SqlConn *conn);  // 空闲太久的连接使用前先 ping，断开则重建，重建失败返回 false
+    void dropConn(SqlConn *conn);    // 丢弃重建失败的连接：解除绑定，释放名额和槽位（不持有锁）
+    SqlConn *getSharedConn(int timeoutMs, bool* connectFailed);
+    void putIdle(SqlConn *conn);     // 放回空闲连接（持有锁）
+    void maintain();    // 维护线程：健康检查、回收空闲连接、补足最少连接数
+    void recordWait(int64_t us);
+
+    string host, user, pwd, dbName;
+    int port;
+
+    int minConnCnt;     // 最少保持的连接数
+    int maxConnCnt;     // 最多的连接数
+    int waitTimeoutMs;  // 获取连接的默认等待时间
+    int idleTimeoutMs;  // 多余的空闲连接的存活时间
+    int pingIntervalMs; // 空闲连接的健康检查间隔
+
+    bool threadAffine;  // 线程独占模式
+    int poolId;         // 线程独占模式下，thread_local 绑定表的下标
+    static atomic<int> poolCnt;
 
-    int useConnCnt;  // 最大的连接数
-    int freeConnCnt; // 空闲的用户数
+    int totalConnCnt; // 已建立（包括正在建立）的连接数
+    atomic<int> useConnCnt; // 正在使用的连接数
+    atomic<int> waiterCnt;  // 正在等待的线程数
+    bool isClose;
 
-    queue<MYSQL*> connQue;
-    mtx *mtxPool; // 互斥锁
-    sem *semFree; // 信号量
+    deque<SqlConn*> connQue;    // 空闲连接，队尾是最近归还的连接
+    SqlConnStack spareConns;    // 线程独占模式下的空闲连接（无锁）
+    vector<SqlConn*> boundConns; // 已绑定到线程的连接，关闭连接池时统一关闭
+    vector<int> freeSlots;      // 未使用的槽位
+    mtx mtxPool;        // 互斥锁
+    cond condFree;      // 有连接归还
+    cond condMaintain;  // 唤醒维护线程（关闭时）
+    thread maintainThread;
+
+    atomic<uint64_t> timeoutCnt;
+    atomic<uint64_t> connectErrCnt;
+    atomic<uint64_t> waitHist[SqlPoolStats::WAIT_BUCKETS];
 };
 
 
+// 语句类型：读可以发往副本，写只能发往主库（见 SqlRouter）
+enum SQL_ROUTE
+{
+    SQL_READ = 0,
+    SQL_WRITE
+};
+
 class SqlConnect
 {
 public:
-    SqlConnect(MYSQL** sql, SqlConnPool *sqlConnPool);
+    SqlConnect(SqlConn** conn, SqlConnPool *sqlConnPool);
+    // 由 SqlRouter 按语句类型选择数据库
+    SqlConnect(SqlConn** conn, SQL_ROUTE route);
     ~SqlConnect();
 
+    // 连接执行出错，暂时摘除该数据库
+    void reportError();
+
 private:
-    MYSQL *sql;
+    SqlConn *conn;
     SqlConnPool *sqlConnPool;
 };
 
-#endif
\ No newline at end of file
+#endif
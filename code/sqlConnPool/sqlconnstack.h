@@ -0,0 +1,75 @@
+/*
+    无锁的空闲连接栈（Treiber 栈）
+
+    每个连接在连接池中有固定的槽位（SqlConn::slot），栈内用槽位下标串成链表。
+    栈顶打包为 64 位：高 32 位是版本号，低 32 位是栈顶槽位下标 + 1（0 表示空栈）。
+    每次修改栈顶版本号加一，避免连接被取出又放回时 CAS 误判（ABA 问题）。
+*/
+#ifndef SQL_CONN_STACK_H
+#define SQL_CONN_STACK_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include "sqlconn.h"
+
+class SqlConnStack
+{
+public:
+    SqlConnStack() : capacity(0), top(0), count(0) {}
+
+    // 槽位数量等于连接池的最大连接数
+    void init(int capacity)
+    {
+        assert(capacity > 0);
+        this->capacity = capacity;
+        slots.reset(new SqlConn*[capacity]);
+        next.reset(new std::atomic<uint32_t>[capacity]);
+        for (int i = 0; i < capacity; i ++)
+        {
+            slots[i] = nullptr;
+            next[i] = 0;
+        }
+    }
+
+    void push(SqlConn* conn)
+    {
+        int i = conn->getSlot();
+        assert(i >= 0 && i < capacity);
+        slots[i] = conn;
+        uint64_t old = top.load(std::memory_order_relaxed);
+        uint64_t now;
+        do
+        {
+            next[i].store((uint32_t)old, std::memory_order_relaxed);
+            now = ((old >> 32) + 1) << 32 | (uint32_t)(i + 1);
+        } while (!top.compare_exchange_weak(old, now, std::memory_order_release, std::memory_order_relaxed));
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    SqlConn* pop()
+    {
+        uint64_t old = top.load(std::memory_order_acquire);
+        uint64_t now;
+        uint32_t i;
+        do
+        {
+            i = (uint32_t)old;
+            if (i == 0) return nullptr;
+            now = ((old >> 32) + 1) << 32 | next[i - 1].load(std::memory_order_relaxed);
+        } while (!top.compare_exchange_weak(old, now, std::memory_order_acquire, std::memory_order_acquire));
+        count.fetch_sub(1, std::memory_order_relaxed);
+        return slots[i - 1];
+    }
+
+    int size() const { return count.load(std::memory_order_relaxed); }
+
+private:
+    int capacity;
+    std::unique_ptr<SqlConn*[]> slots;                 // 槽位 -> 连接
+    std::unique_ptr<std::atomic<uint32_t>[]> next;     // 槽位 -> 下一个槽位下标 + 1
+    std::atomic<uint64_t> top;                         // 版本号 | 栈顶槽位下标 + 1
+    std::atomic<int> count;
+};
+
+#endif
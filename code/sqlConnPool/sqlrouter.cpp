@@ -0,0 +1,132 @@
+#include "sqlrouter.h"
+
+using namespace std;
+
+SqlRouter::SqlRouter()
+{
+    primary.pool = nullptr;
+    primary.downUntil = 0;
+    next = 0;
+}
+
+SqlRouter::~SqlRouter()
+{
+    destroy();
+}
+
+SqlRouter* SqlRouter::instance()
+{
+    static SqlRouter router;
+    return &router;
+}
+
+void SqlRouter::setPrimary(const string& name, SqlConnPool* pool)
+{
+    assert(pool);
+    primary.name = name;
+    primary.pool = pool;
+}
+
+void SqlRouter::addReplica(const string& name, unique_ptr<SqlConnPool> pool)
+{
+    assert(pool);
+    unique_ptr<Backend> backend(new Backend);
+    backend->name = name;
+    backend->pool = pool.get();
+    backend->downUntil = 0;
+    replicas.push_back(move(backend));
+    replicaPools.push_back(move(pool));
+}
+
+int64_t SqlRouter::nowMs()
+{
+    return chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SqlRouter::isUp(const Backend* backend, int64_t now)
+{
+    return backend->downUntil.load(memory_order_relaxed) <= now;
+}
+
+/*
+    读：从轮询起点开始，先不等待地尝试每个可用的副本；
+        建立连接失败的副本立即摘除，不再在它上面等待；
+        都没有空闲连接时，在第一个只是繁忙的副本上等待；
+        副本都不可用，退回到主库。
+    写：只使用主库。
+*/
+SqlConn* SqlRouter::getConn(SQL_ROUTE route, SqlConnPool** pool)
+{
+    assert(primary.pool && pool);
+    if (route == SQL_READ && !replicas.empty())
+    {
+        int64_t now = nowMs();
+        size_t n = replicas.size();
+        size_t start = next.fetch_add(1, memory_order_relaxed) % n;
+        Backend* first = nullptr;
+        bool connectFailed = false;
+        for (size_t i = 0; i < n; i ++)
+        {
+            Backend* backend = replicas[(start + i) % n].get();
+            if (!isUp(backend, now)) continue;
+            SqlConn* conn = backend->pool->getConn(0, &connectFailed);
+            if (conn)
+            {
+                *pool = backend->pool;
+                return conn;
+            }
+            if (connectFailed) markDown(backend);
+            else if (!first) first = backend;
+        }
+        if (first)
+        {
+            SqlConn* conn = first->pool->getConn(-2, &connectFailed);
+            if (conn)
+            {
+                *pool = first->pool;
+                return conn;
+            }
+            if (connectFailed) markDown(first);
+        }
+        LOG_WARN("SqlRouter: no replica available, fallback to primary");
+    }
+    *pool = primary.pool;
+    return primary.pool->getConn();
+}
+
+SqlRouter::Backend* SqlRouter::findBackend(SqlConnPool* pool)
+{
+    if (primary.pool == pool) return &primary;
+    for (auto& backend : replicas)
+    {
+        if (backend->pool == pool) return backend.get();
+    }
+    return nullptr;
+}
+
+void SqlRouter::reportError(SqlConnPool* pool)
+{
+    Backend* backend = findBackend(pool);
+    // 主库没有替代，不摘除
+    if (!backend || backend == &primary) return;
+    markDown(backend);
+}
+
+void SqlRouter::markDown(Backend* backend)
+{
+    backend->downUntil.store(nowMs() + DOWN_MS, memory_order_relaxed);
+    LOG_WARN("SqlRouter: replica %s down for %dms", backend->name.c_str(), DOWN_MS);
+}
+
+void SqlRouter::destroy()
+{
+    if (!primary.pool) return;
+    for (auto& pool : replicaPools)
+    {
+        pool->destroy();
+    }
+    primary.pool->destroy();
+    primary.pool = nullptr;
+    mysql_library_end();
+}
@@ -0,0 +1,63 @@
+#ifndef SQL_ROUTER_H
+#define SQL_ROUTER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "sqlconnpool.h"
+
+using namespace std;
+
+/*
+    多数据库路由
+        主库（primary）处理写，以及需要读到最新数据的读；
+        副本（replica）处理普通读，轮询分担负载；
+        某个副本执行出错或建立连接失败后暂时摘除（DOWN_MS），期间的读请求发往其他副本，副本都不可用时发往主库。
+
+    每个库有独立的连接池，只在启动时添加，之后只读，不需要加锁。
+*/
+class SqlRouter
+{
+public:
+    static SqlRouter* instance();
+
+    void setPrimary(const string& name, SqlConnPool* pool);  // 主库连接池由调用者管理
+    void addReplica(const string& name, unique_ptr<SqlConnPool> pool);
+
+    // 按语句类型选择数据库并获取连接，pool 返回连接所属的连接池
+    SqlConn* getConn(SQL_ROUTE route, SqlConnPool** pool);
+
+    // 连接执行出错，暂时摘除该数据库
+    void reportError(SqlConnPool* pool);
+
+    void destroy();
+
+    // 是否配置了主库（使用 MySQL 存储）
+    bool hasPrimary() const { return primary.pool != nullptr; }
+
+private:
+    SqlRouter();
+    ~SqlRouter();
+
+    static const int DOWN_MS = 5000;
+
+    struct Backend
+    {
+        string name;
+        SqlConnPool* pool;
+        atomic<int64_t> downUntil; // 摘除到期的时间（毫秒），0 表示可用
+    };
+
+    Backend* findBackend(SqlConnPool* pool);
+    void markDown(Backend* backend);
+    static bool isUp(const Backend* backend, int64_t now);
+    static int64_t nowMs();
+
+    Backend primary;
+    vector<unique_ptr<Backend>> replicas;
+    vector<unique_ptr<SqlConnPool>> replicaPools;
+    atomic<unsigned> next; // 轮询的起点
+};
+
+#endif
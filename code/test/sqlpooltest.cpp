@@ -0,0 +1,83 @@
+/*
+    线程独占模式下连接池的测试：启动时的预热不占用数据库线程的连接
+
+    与服务器相同：连接池最多 N 个连接，主线程先执行用户存储的预热（读取列长度、预热布隆过滤器），
+    再由 N 个调用了 bindThisThread 的线程同时反复取用、归还连接。
+    每个线程都必须取到连接（不超时），最后每个线程正好绑定一个连接。
+
+    用法：./sqlpooltest MySQL 主机 端口 用户名 密码 库名 [线程数]（不传时跳过）
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "../sqlConnPool/sqlconnpool.h"
+#include "../sqlConnPool/sqlrouter.h"
+#include "../userStore/mysqluserstore.h"
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { failures ++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+    } while (0)
+
+int main(int argc, char* argv[])
+{
+    if (argc < 6)
+    {
+        printf("sqlpooltest: skipped (pass host port user password db)\n");
+        return 0;
+    }
+    int threadCnt = argc > 6 ? atoi(argv[6]) : 4;
+    const int rounds = 200;
+
+    SqlConnPool* pool = SqlConnPool::instance();
+    pool->init(argv[1], atoi(argv[2]), argv[3], argv[4], argv[5], threadCnt, 0, 500, 60000, 30000, true);
+    SqlRouter::instance()->setPrimary("primary", pool);
+
+    // 预热在主线程中执行（与 WebServer 的构造函数相同），主线程之后不再访问数据库
+    {
+        MysqlUserStore store;
+        store.init(true, 32, 2);
+    }
+    // 偶尔访问数据库的其他线程
+    thread([] {
+        SqlConn* conn;
+        SqlConnect connect(&conn, SQL_READ);
+    }).join();
+
+    atomic<int> misses(0);
+    vector<thread> workers;
+    for (int t = 0; t < threadCnt; t ++)
+    {
+        workers.emplace_back([&] {
+            SqlConnPool::bindThisThread();
+            for (int i = 0; i < rounds; i ++)
+            {
+                SqlConn* conn = pool->getConn();
+                if (!conn) { misses ++; break; } // 一次超时就足以说明问题，不再等待
+                usleep(100); // 模拟一次查询
+                pool->freeConn(conn);
+            }
+        });
+    }
+    for (thread& worker : workers) worker.join();
+
+    SqlPoolStats stats = pool->getStats();
+    CHECK(misses == 0, "%d of %d threads could not get a connection", misses.load(), threadCnt);
+    CHECK(stats.timeoutCnt == 0, "%d getConn calls timed out", (int)stats.timeoutCnt);
+    CHECK(stats.boundConnCnt == threadCnt, "%d connections bound to %d threads", stats.boundConnCnt, threadCnt);
+    CHECK(stats.totalConnCnt <= threadCnt, "%d connections for %d threads", stats.totalConnCnt, threadCnt);
+    printf("sqlpooltest: %d threads, %d connections, %d bound, %d timeouts\n",
+           threadCnt, stats.totalConnCnt, stats.boundConnCnt, (int)stats.timeoutCnt);
+
+    SqlRouter::instance()->destroy();
+    printf("sqlpooltest: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+/*
+    MySQL 用户存储的测试：注册成功的用户一定可以登录
+
+    分别注册短密码、超过查询缓冲区（128 字节）的长密码和超长密码，
+    注册成功的用户用新的 MysqlUserStore（本地缓存为空，密码从数据库读取）登录，
+    正确的密码必须成功，错误的密码必须失败；超过列长度的密码可以在注册时被拒绝。
+    会在 user 表中留下带进程号和时间戳的测试用户。
+
+    用法：./userstoretest MySQL 主机 端口 用户名 密码 库名（不传时跳过）
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <string>
+
+#include "../userStore/mysqluserstore.h"
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { failures ++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+    } while (0)
+
+// 注册后用另一个存储实例登录，batch 为合并插入的批大小
+static void checkPassword(const string& name, const string& pwd, int batch)
+{
+    VERIFY_RESULT reg;
+    {
+        MysqlUserStore store;
+        store.init(true, batch, 2);
+        reg = store.registerUser(name, pwd);
+    }
+    CHECK(reg != VERIFY_BUSY, "register %s (password %d bytes): busy", name.c_str(), (int)pwd.size());
+    if (reg != VERIFY_SUCCESS)
+    {
+        printf("register %s (password %d bytes): rejected\n", name.c_str(), (int)pwd.size());
+        return;
+    }
+
+    MysqlUserStore store;
+    store.init(false);
+    VERIFY_RESULT ok = store.login(name, pwd);
+    VERIFY_RESULT wrong = store.login(name, pwd + "x");
+    VERIFY_RESULT prefix = store.login(name, pwd.substr(0, pwd.size() - 1));
+    CHECK(ok == VERIFY_SUCCESS, "login %s (password %d bytes): %d", name.c_str(), (int)pwd.size(), ok);
+    CHECK(wrong == VERIFY_FAILED, "login %s with a longer password: %d", name.c_str(), wrong);
+    CHECK(prefix == VERIFY_FAILED, "login %s with a shorter password: %d", name.c_str(), prefix);
+    printf("register %s (password %d bytes): ok\n", name.c_str(), (int)pwd.size());
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 6)
+    {
+        printf("userstoretest: skipped (pass host port user password db)\n");
+        return 0;
+    }
+    SqlConnPool::instance()->init(argv[1], atoi(argv[2]), argv[3], argv[4], argv[5], 4);
+    SqlRouter::instance()->setPrimary("primary", SqlConnPool::instance());
+
+    // 用户名不超过常见的 char(30)
+    string prefix = "t" + to_string(getpid() % 100000) + "_" + to_string(time(nullptr) % 100000) + "_";
+    int id = 0;
+    for (int batch : {0, 32})
+    {
+        checkPassword(prefix + to_string(id ++), "short", batch);
+        checkPassword(prefix + to_string(id ++), string(127, 'a'), batch);
+        checkPassword(prefix + to_string(id ++), string(128, 'b'), batch);
+        checkPassword(prefix + to_string(id ++), string(300, 'c'), batch);
+        checkPassword(prefix + to_string(id ++), string(5000, 'd'), batch);
+    }
+
+    SqlRouter::instance()->destroy();
+    printf("userstoretest: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
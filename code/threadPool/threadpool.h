@@ -2,7 +2,10 @@
 #define THREADPOOL_H
 
 #include "../lock/locker.h"
+#include "../metrics/metrics.h"
+#include "../metrics/alloctrack.h"
 #include <queue>
+#include <vector>
 #include <thread>
 #include <functional>
 #include <memory>
@@ -10,24 +13,44 @@
 
 using namespace std;
 
+/*
+    线程池
+        instance() 是处理 HTTP 请求的线程池；
+        也可以单独创建线程池，例如执行数据库操作的线程池，避免慢查询占满处理请求的线程。
+*/
 class ThreadPool
 {
 public:
+    ThreadPool() : threadNum(0), maxRequests(0), waitMetric(-1), shutdown(false) {}
+
+    ~ThreadPool()
+    {
+        mtxPool.lock();
+        shutdown = true; // 子线程自己退出
+        mtxPool.unlock();
+        condNotEmpty.broadcast();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
     static ThreadPool* instance()
     {
         static ThreadPool threadpool;
         return &threadpool;
     }
 
-    // 回调函数：从线程池的任务队列中选一个任务处理
-    static void callback(ThreadPool* pool)
+    // 回调函数：从线程池的任务队列中选一个任务处理，index 是工作线程的编号
+    static void callback(ThreadPool* pool, int index)
     {
+        if (pool->threadInit) pool->threadInit(index);
         while (true)
         {
             pool->mtxPool.lock();
             while (pool->tasks.empty() && !pool->shutdown)
             {
-                pool->condNotEmpty.wait(pool->mtxPool.get());
+                pool->condNotEmpty.wait(pool->mtxPool);
             }
 
             if (pool->shutdown)
@@ -37,38 +60,90 @@ public:
             }
             
             // 函数指针需要用move变成右值
-            auto task = move(pool->tasks.front());
+            Task task = move(pool->tasks.front());
             pool->tasks.pop();
             pool->mtxPool.unlock();
-            task(); // bind打包好的函数及其参数，可直接执行
+            // 记录任务在队列中的等待时间
+            if (task.enqueueNs)
+            {
+                Metrics::record((METRIC_HISTOGRAM)pool->waitMetric, Metrics::now() - task.enqueueNs);
+            }
+            if (Metrics::enabled.load(memory_order_relaxed))
+            {
+                // 累计执行任务的时间（只有本线程写入）
+                uint64_t start = Metrics::now();
+                task.fn(); // bind打包好的函数及其参数，可直接执行
+                atomic<uint64_t>& busy = pool->busyNs[index];
+                busy.store(busy.load(memory_order_relaxed) + Metrics::now() - start, memory_order_relaxed);
+            }
+            else
+            {
+                task.fn();
+            }
         }
     }
     
-    void init(int threadNum = 8, int maxRequests = 10000)
+    // waitMetric：记录任务排队时间的直方图，-1 表示不记录；name：锁竞争分析中锁的名称
+    // threadInit：每个工作线程开始处理任务前在该线程中调用一次，参数是线程的编号
+    void init(int threadNum = 8, int maxRequests = 10000, int waitMetric = -1, const char* name = "threadpool",
+              const function<void(int)>& threadInit = nullptr)
     {
+        this->threadInit = threadInit;
+        mtxPool.setName(name);
+        condNotEmpty.setName(name);
         this->threadNum = threadNum;
         this->maxRequests = maxRequests;
+        this->waitMetric = waitMetric;
         assert(threadNum > 0);
+        busyNs.reset(new atomic<uint64_t>[threadNum]);
+        for (int i = 0; i < threadNum; i ++) busyNs[i] = 0;
         // 初始化时开辟所有线程，无任务就阻塞
         for (int i = 0; i < threadNum; i ++)
         {
-            // 线程分离，主线程不用负责回收子线程资源
-            thread(callback, this).detach();
+            // 析构时回收子线程，保证子线程不会访问已销毁的线程池
+            workers.emplace_back(callback, this, i);
         }
     }
 
-    // 添加任务，传入方法和参数打包后的函数对象（&&表示右值引用）
+    // 添加任务，传入方法和参数打包后的函数对象（&&表示右值引用），队列已满时丢弃并返回 false
     template<typename F>
-    void addTask(F&& task)
+    bool addTask(F&& task)
     {
+        ALLOC_SCOPE(ALLOC_THREADPOOL);
+        uint64_t enqueueNs = (waitMetric >= 0 && Metrics::enabled) ? Metrics::now() : 0;
         mtxPool.lock();
         if ((int)tasks.size() < maxRequests)
         {
             // 利用forward进行完美转发，保持右值引用属性
-            tasks.emplace(forward<F>(task));
+            tasks.emplace(Task{forward<F>(task), enqueueNs});
+            mtxPool.unlock();
+            // 解锁后再通知：被唤醒的线程不会因为锁仍被持有而再次休眠
             condNotEmpty.signal();
+            return true;
         }
         mtxPool.unlock();
+        Metrics::add(CNT_TASK_DROPPED);
+        return false;
+    }
+
+    int getThreadNum() const { return threadNum; }
+
+    // 第 i 个工作线程（用于绑定 CPU）
+    thread& getThread(int i) { return workers[i]; }
+
+    // 第 i 个工作线程累计执行任务的时间（纳秒）
+    uint64_t getBusyNs(int i) const
+    {
+        return busyNs[i].load(memory_order_relaxed);
+    }
+
+    // 任务队列的长度
+    int queueSize()
+    {
+        mtxPool.lock();
+        int size = tasks.size();
+        mtxPool.unlock();
+        return size;
     }
 
 private:
@@ -76,19 +151,18 @@ private:
     cond condNotEmpty; // 条件变量
     int threadNum;     // 线程的数量
     int maxRequests;   // 最大连接数
+    int waitMetric;    // 排队时间的直方图
     bool shutdown;     // 是否关闭
-    // function<void>可代替函数指针，使用 bind 将函数指针与参数绑定
-    queue<function<void()>> tasks;
-
-    ThreadPool() {}
-
-    ~ThreadPool()
+    vector<thread> workers; // 工作线程
+    unique_ptr<atomic<uint64_t>[]> busyNs; // 各工作线程的忙碌时间
+    function<void(int)> threadInit;        // 工作线程的初始化
+    struct Task
     {
-        mtxPool.lock();
-        shutdown = true; // 子线程自己销毁
-        mtxPool.unlock();
-        condNotEmpty.broadcast();
-    }
+        // function<void>可代替函数指针，使用 bind 将函数指针与参数绑定
+        function<void()> fn;
+        uint64_t enqueueNs; // 入队时间，0 表示不记录
+    };
+    queue<Task> tasks;
 };
 
 #endif
\ No newline at end of file
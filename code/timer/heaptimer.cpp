@@ -1,4 +1,5 @@
 #include "heaptimer.h"
+#include "../metrics/alloctrack.h"
 
 /* 
     数组模拟堆
@@ -32,12 +33,13 @@ void HeapTimer::siftup(size_t i)
 {
     assert(i >= 0 && i < heap.size());
 
-    size_t j = (i - 1) / 2;
-    while (j >= 0 && heap[i] < heap[j]) 
+    // 下标是无符号数，到根节点时必须停下，不能再算 (0 - 1) / 2
+    while (i > 0)
     {
+        size_t j = (i - 1) / 2;
+        if (!(heap[i] < heap[j])) break;
         swapNode(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -51,7 +53,8 @@ void HeapTimer::siftdown(size_t i)
     {
         if (t + 1 < size && heap[t + 1] < heap[t]) t ++;
         if (heap[i] < heap[t]) break;
-        swap(heap[i], heap[t]);
+        // 交换时同步更新哈希表里的下标
+        swapNode(i, t);
         i = t;
         t = i * 2 + 1;
     }
@@ -59,6 +62,7 @@ void HeapTimer::siftdown(size_t i)
 
 void HeapTimer::add(int id, int timeout, const TimeoutCallBack& cb)
 {
+    ALLOC_SCOPE(ALLOC_TIMER);
     assert(id >= 0);
     size_t i;
     if (!ref.count(id))
@@ -118,8 +122,18 @@ void HeapTimer::tick()
         {
             break;
         }
-        node.cb();
+        // 先删除再回调，回调中可以重新添加同一编号的定时器
         pop();
+        if (!observer)
+        {
+            node.cb();
+            continue;
+        }
+        TimeStamp start = Clock::now();
+        node.cb();
+        TimeStamp end = Clock::now();
+        observer(node.id, std::chrono::duration_cast<std::chrono::nanoseconds>(start - node.expires).count(),
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
     }
 }
 
@@ -139,7 +153,7 @@ int HeapTimer::getNextTick()
 {
     // 处理堆顶计时器，若超时执行回调再删除
     tick();
-    size_t res = -1;
+    int64_t res = -1;
     if (!heap.empty())
     {
         // 计算现在堆顶的超时时间，到期时先唤醒一次 epoll，判断是否有新事件
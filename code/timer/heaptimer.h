@@ -15,6 +15,8 @@ typedef std::function<void()> TimeoutCallBack;
 typedef std::chrono::high_resolution_clock Clock;
 typedef std::chrono::milliseconds MS;
 typedef Clock::time_point TimeStamp;
+// 回调执行的观察者：定时器编号、相对到期时间的延迟（纳秒）、回调耗时（纳秒）
+typedef std::function<void(int, int64_t, int64_t)> TimerObserver;
 
 // 定时器结点
 struct TimerNode 
@@ -56,6 +58,12 @@ public:
     // 返回最近的到期时间
     int getNextTick();
 
+    // 定时器数量
+    size_t size() const { return heap.size(); }
+
+    // 设置后 tick 对每个回调计时（主循环监控使用）
+    void setObserver(const TimerObserver& observer) { this->observer = observer; }
+
 private:
     void del(size_t i);
     
@@ -70,6 +78,8 @@ private:
 
     // 记录每个定时器的下标
     std::unordered_map<int, size_t> ref;
+
+    TimerObserver observer;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,813 @@
+/*
+    loadgen：HTTP 压测工具
+
+    基于 epoll 的非阻塞客户端，每个线程一个 epoll 实例，管理自己的一组连接，线程之间不共享数据，
+    结束后再合并统计结果。
+
+    场景（-s）：
+        small  GET /index.html，静态小文件
+        large  GET /images/profile-image.jpg，大文件（可用 -u 换成视频等其他资源）
+        login  POST /login 表单登录（-U 指定用户名和密码，-S 携带服务器返回的会话 Cookie）
+    连接默认 keep-alive，-K 改为每个请求新建连接；-P 设置流水线深度，不等响应连续发出多个请求。
+
+    延迟与协调遗漏（coordinated omission）：
+        闭环压测时服务器一旦变慢，客户端也跟着少发请求，卡顿期间本该发出的请求根本没有被测到，
+        高分位延迟因此被严重低估。
+        -r 指定总请求速率时，每个请求都有计划发送时间，延迟从计划时间算起，连接被占用、
+        请求积压的时间也计入延迟；同时单独统计从实际发送算起的服务时间。
+        不指定 -r 时为闭环压测，按 HdrHistogram 的做法事后修正：以平均延迟为期望间隔，
+        为每个超过期望间隔的样本补上被遗漏的样本。
+
+    -o 把结果写成 JSON，便于比较服务器改动前后的多次运行。
+    -C 指定服务器进程号时，在测量开始和结束时读取它的 CPU 时间（/proc/<pid>/stat），
+    报告测量期间的 CPU 占用和每个请求消耗的 CPU 时间，用来比较忙轮询等用 CPU 换延迟的配置。
+
+    用法：loadgen [-H 地址] [-p 端口] [-c 连接数] [-t 线程数] [-d 秒] [-w 预热秒] [-r 请求/秒]
+                  [-s small|large|login] [-u 路径] [-K] [-P 深度] [-U 用户名:密码] [-S]
+                  [-o 结果.json] [-l 标签] [-C 服务器进程号]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+
+static uint64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+    延迟直方图（纳秒）
+
+    与 metrics 模块的直方图相同，按数量级（2 的幂）分段，但每段分为 128 个子桶，
+    相对误差小于 1%，p99.9 这样的高分位也足够精确。只由一个线程写入，不需要原子操作。
+*/
+class LatencyHistogram
+{
+public:
+    static const int SUB_BITS = 7;
+    static const int SUB_NUM = 1 << SUB_BITS;
+    static const int MAX_BITS = 42; // 最大记录 2^42 ns（约 73 分钟）
+    static const int BUCKET_NUM = (MAX_BITS - SUB_BITS + 1) * SUB_NUM;
+
+    LatencyHistogram(): buckets(BUCKET_NUM, 0), count(0), sum(0), maxValue(0) {}
+
+    void record(uint64_t value, uint64_t n = 1)
+    {
+        buckets[index(value)] += n;
+        count += n;
+        sum += (double)value * n;
+        if (value > maxValue) maxValue = value;
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (int i = 0; i < BUCKET_NUM; i ++) buckets[i] += other.buckets[i];
+        count += other.count;
+        sum += other.sum;
+        maxValue = max(maxValue, other.maxValue);
+    }
+
+    // 分位数（0~1），返回所在桶的上界，不超过最大值
+    uint64_t percentile(double p) const
+    {
+        if (count == 0) return 0;
+        uint64_t target = (uint64_t)ceil(p * count);
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_NUM; i ++)
+        {
+            seen += buckets[i];
+            if (seen >= target) return min(lowerBound(i + 1) - 1, maxValue);
+        }
+        return maxValue;
+    }
+
+    double mean() const { return count ? sum / count : 0; }
+    uint64_t getCount() const { return count; }
+    uint64_t getMax() const { return maxValue; }
+
+    /*
+        闭环压测的协调遗漏修正（同 HdrHistogram 的 copyCorrectedForCoordinatedOmission）：
+        延迟为 v 的样本说明这期间本应按期望间隔 e 继续发出请求，
+        补上延迟为 v - e、v - 2e …… 的样本，直到不超过 e
+    */
+    LatencyHistogram corrected(uint64_t expectedInterval) const
+    {
+        LatencyHistogram res;
+        for (int i = 0; i < BUCKET_NUM; i ++)
+        {
+            if (buckets[i] == 0) continue;
+            uint64_t value = min((lowerBound(i) + lowerBound(i + 1) - 1) / 2, maxValue);
+            res.record(value, buckets[i]);
+            if (expectedInterval == 0 || value <= expectedInterval) continue;
+            for (uint64_t missing = value - expectedInterval; missing >= expectedInterval; missing -= expectedInterval)
+            {
+                res.record(missing, buckets[i]);
+            }
+        }
+        res.maxValue = max(res.maxValue, maxValue);
+        return res;
+    }
+
+private:
+    static int index(uint64_t value)
+    {
+        if (value < (uint64_t)SUB_NUM) return (int)value;
+        int msb = 63 - __builtin_clzll(value);
+        if (msb >= MAX_BITS) return BUCKET_NUM - 1;
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_NUM + (int)((value >> shift) & (SUB_NUM - 1));
+    }
+
+    // 下标 i 的桶的下界
+    static uint64_t lowerBound(int i)
+    {
+        if (i < SUB_NUM) return i;
+        int shift = i / SUB_NUM - 1;
+        return (uint64_t)(SUB_NUM + i % SUB_NUM) << shift;
+    }
+
+    vector<uint64_t> buckets;
+    uint64_t count;
+    double sum;
+    uint64_t maxValue;
+};
+
+struct Options
+{
+    string host = "127.0.0.1";
+    int port = 8081;
+    int conns = 16;
+    int threads = 1;
+    int duration = 10;        // 测量时长（秒）
+    int warmup = 1;           // 预热时长（秒），期间的样本不计入结果
+    double rate = 0;          // 总请求速率（请求/秒），0 表示闭环压测
+    string scenario = "small";
+    string path;              // 为空时使用场景的默认路径
+    bool keepAlive = true;
+    int pipeline = 1;
+    string user = "loadgen";
+    string password = "loadgen";
+    bool useSession = false;
+    string output;
+    string label;
+    int serverPid = 0;        // 采样 CPU 时间的服务器进程，0 表示不采样
+};
+
+struct Result
+{
+    LatencyHistogram latency;    // 从计划发送时间算起（闭环压测时即实际发送时间）
+    LatencyHistogram service;    // 从实际发送时间算起
+    uint64_t requests = 0;       // 测量期间完成的请求
+    uint64_t bytes = 0;          // 测量期间收到的字节数
+    uint64_t non2xx = 0;         // 状态码不是 2xx 的响应
+    uint64_t connectErrors = 0;  // 连接失败
+    uint64_t readErrors = 0;     // 读写出错，或响应未完成时连接被关闭
+    uint64_t incomplete = 0;     // 结束时仍未完成（已发出或已到期未发出）的请求
+
+    void merge(const Result& other)
+    {
+        latency.merge(other.latency);
+        service.merge(other.service);
+        requests += other.requests;
+        bytes += other.bytes;
+        non2xx += other.non2xx;
+        connectErrors += other.connectErrors;
+        readErrors += other.readErrors;
+        incomplete += other.incomplete;
+    }
+};
+
+struct Connection
+{
+    int fd = -1;
+    bool connecting = false;
+    bool wantWrite = false;          // 是否监听 EPOLLOUT
+    string out;                      // 待发送的请求
+    size_t outOff = 0;
+    deque<pair<uint64_t, uint64_t>> inflight; // 已发出请求的计划发送时间、实际发送时间
+    string head;                     // 未解析完的响应头
+    bool inBody = false;
+    uint64_t bodyLeft = 0;
+    int status = 0;
+    bool closeAfter = false;         // 服务器要求关闭连接
+    uint64_t nextDue = 0;            // 限速模式下一个请求的计划发送时间
+    uint64_t retryAt = 0;            // 连接失败后的重连时间
+    string cookie;                   // 会话 Cookie
+};
+
+class Worker
+{
+public:
+    Worker(const Options& opt, const sockaddr_in& addr, int conns, uint64_t interval,
+           uint64_t start, uint64_t measureStart, uint64_t end):
+        opt(opt), addr(addr), conns(conns), interval(interval),
+        start(start), measureStart(measureStart), end(end) {}
+
+    void run();
+    const Result& getResult() const { return result; }
+
+private:
+    void openConn(Connection& c);
+    void closeConn(Connection& c);
+    void connectFailed(Connection& c, uint64_t now);
+    void fill(Connection& c, uint64_t now);
+    void flush(Connection& c);
+    void onReadable(Connection& c, uint64_t now);
+    bool parse(Connection& c, const char* data, size_t len, uint64_t now);
+    void onResponse(Connection& c, uint64_t now);
+    void onError(Connection& c);
+    void updateEvents(Connection& c, bool wantWrite);
+    string buildRequest(const Connection& c) const;
+
+    const Options& opt;
+    sockaddr_in addr;
+    int conns;
+    uint64_t interval; // 限速模式下每个连接的请求间隔（纳秒），0 表示闭环压测
+    uint64_t start, measureStart, end;
+
+    int epfd = -1;
+    vector<Connection> connections;
+    Result result;
+};
+
+static string scenarioPath(const Options& opt)
+{
+    if (!opt.path.empty()) return opt.path;
+    if (opt.scenario == "large") return "/images/profile-image.jpg";
+    if (opt.scenario == "login") return "/login";
+    return "/index.html";
+}
+
+string Worker::buildRequest(const Connection& c) const
+{
+    string req;
+    bool login = opt.scenario == "login";
+    req += login ? "POST " : "GET ";
+    req += scenarioPath(opt) + " HTTP/1.1\r\n";
+    req += "Host: " + opt.host + ":" + to_string(opt.port) + "\r\n";
+    req += opt.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    if (!c.cookie.empty())
+    {
+        req += "Cookie: sid=" + c.cookie + "\r\n";
+    }
+    if (login)
+    {
+        string body = "username=" + opt.user + "&password=" + opt.password;
+        req += "Content-Type: application/x-www-form-urlencoded\r\n";
+        req += "Content-Length: " + to_string(body.size()) + "\r\n\r\n";
+        req += body;
+    }
+    else
+    {
+        req += "\r\n";
+    }
+    return req;
+}
+
+void Worker::openConn(Connection& c)
+{
+    // 重连时保留计划发送时间和会话 Cookie
+    Connection fresh;
+    fresh.nextDue = c.nextDue;
+    fresh.cookie = c.cookie;
+    c = move(fresh);
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c.fd < 0)
+    {
+        connectFailed(c, monotonicNs());
+        return;
+    }
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c.fd, (const sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+    {
+        ::close(c.fd);
+        c.fd = -1;
+        connectFailed(c, monotonicNs());
+        return;
+    }
+    // 连接建立（可写）之前不发送请求
+    c.connecting = true;
+    c.wantWrite = true;
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    ev.data.u32 = &c - connections.data();
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c.fd, &ev);
+}
+
+// 连接失败的连接 10ms 后重连，避免服务器拒绝连接时空转
+void Worker::connectFailed(Connection& c, uint64_t now)
+{
+    result.connectErrors ++;
+    c.connecting = false;
+    c.retryAt = now + 10000000;
+}
+
+void Worker::closeConn(Connection& c)
+{
+    if (c.fd < 0) return;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+    ::close(c.fd);
+    c.fd = -1;
+}
+
+void Worker::updateEvents(Connection& c, bool wantWrite)
+{
+    if (c.wantWrite == wantWrite) return;
+    c.wantWrite = wantWrite;
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? EPOLLOUT : 0);
+    ev.data.u32 = &c - connections.data();
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+// 追加可以发出的请求：闭环压测时补满流水线，限速模式下只发出已到计划时间的请求
+void Worker::fill(Connection& c, uint64_t now)
+{
+    if (c.fd < 0 || c.connecting) return;
+    size_t depth = opt.keepAlive ? opt.pipeline : 1;
+    while (c.inflight.size() < depth)
+    {
+        uint64_t scheduled = now;
+        if (interval)
+        {
+            if (c.nextDue > now) break;
+            scheduled = c.nextDue;
+            c.nextDue += interval;
+        }
+        c.inflight.emplace_back(scheduled, now);
+        c.out += buildRequest(c);
+    }
+}
+
+void Worker::flush(Connection& c)
+{
+    while (c.fd >= 0 && c.outOff < c.out.size())
+    {
+        ssize_t n = send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            onError(c);
+            return;
+        }
+        c.outOff += n;
+    }
+    if (c.fd < 0) return;
+    if (c.outOff == c.out.size())
+    {
+        c.out.clear();
+        c.outOff = 0;
+    }
+    updateEvents(c, !c.out.empty());
+}
+
+// 连接出错或响应未完成时被关闭：已发出的请求计为错误，重新建立连接
+void Worker::onError(Connection& c)
+{
+    result.readErrors ++;
+    closeConn(c);
+    openConn(c);
+}
+
+void Worker::onReadable(Connection& c, uint64_t now)
+{
+    static thread_local char buf[65536];
+    while (c.fd >= 0)
+    {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0)
+        {
+            if (now >= measureStart) result.bytes += n;
+            if (!parse(c, buf, n, now)) return;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        // 对端关闭：响应之间的关闭（keep-alive 次数用完、超时）直接重连，不算错误
+        if (n == 0 && c.inflight.empty() && !c.inBody && c.head.empty())
+        {
+            closeConn(c);
+            openConn(c);
+        }
+        else
+        {
+            onError(c);
+        }
+        return;
+    }
+}
+
+// 解析响应，只保存响应头，响应体按 Content-length 跳过；返回 false 表示连接已经关闭或重建
+bool Worker::parse(Connection& c, const char* data, size_t len, uint64_t now)
+{
+    size_t pos = 0;
+    while (pos < len)
+    {
+        if (!c.inBody)
+        {
+            size_t before = c.head.size();
+            c.head.append(data + pos, len - pos);
+            size_t headEnd = c.head.find("\r\n\r\n", before >= 3 ? before - 3 : 0);
+            if (headEnd == string::npos)
+            {
+                if (c.head.size() > 65536)
+                {
+                    onError(c);
+                    return false;
+                }
+                return true;
+            }
+            pos += headEnd + 4 - before;
+            c.head.resize(headEnd + 4);
+            if (c.inflight.empty() || c.head.compare(0, 5, "HTTP/") != 0 || c.head.size() < 12)
+            {
+                onError(c);
+                return false;
+            }
+            const char* head = c.head.c_str();
+            c.status = atoi(head + 9);
+            const char* field = strcasestr(head, "\r\nContent-length:");
+            c.bodyLeft = field ? strtoull(field + 17, nullptr, 10) : 0;
+            c.closeAfter = strcasestr(head, "\r\nConnection: close") != nullptr;
+            if (opt.useSession && (field = strcasestr(head, "\r\nSet-Cookie: sid=")))
+            {
+                field += 18;
+                c.cookie.assign(field, strcspn(field, ";\r"));
+            }
+            c.head.clear();
+            c.inBody = true;
+        }
+        uint64_t take = min<uint64_t>(c.bodyLeft, len - pos);
+        c.bodyLeft -= take;
+        pos += take;
+        if (c.bodyLeft == 0)
+        {
+            c.inBody = false;
+            onResponse(c, now);
+            if (c.fd < 0 || c.connecting) return false;
+        }
+    }
+    return true;
+}
+
+void Worker::onResponse(Connection& c, uint64_t now)
+{
+    pair<uint64_t, uint64_t> req = c.inflight.front();
+    c.inflight.pop_front();
+    if (now >= measureStart && now <= end)
+    {
+        result.requests ++;
+        result.latency.record(now - req.first);
+        result.service.record(now - req.second);
+        if (c.status < 200 || c.status >= 300) result.non2xx ++;
+    }
+    if (!opt.keepAlive || c.closeAfter)
+    {
+        // 服务器关闭连接后，流水线中剩余的请求收不到响应
+        if (!c.inflight.empty()) result.readErrors ++;
+        closeConn(c);
+        openConn(c);
+        return;
+    }
+    if (!interval)
+    {
+        fill(c, now);
+        flush(c);
+    }
+}
+
+void Worker::run()
+{
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    connections.resize(conns);
+    for (int i = 0; i < conns; i ++)
+    {
+        // 限速模式下各连接的计划发送时间错开，避免同时发出
+        connections[i].nextDue = start + interval * i / conns;
+        openConn(connections[i]);
+    }
+
+    vector<epoll_event> events(conns + 1);
+    for (uint64_t now = monotonicNs(); now < end; now = monotonicNs())
+    {
+        int timeoutMs = 100;
+        if (interval)
+        {
+            for (Connection& c: connections)
+            {
+                if (c.fd < 0 || c.connecting || c.inflight.size() >= (size_t)opt.pipeline) continue;
+                int wait = c.nextDue > now ? (c.nextDue - now) / 1000000 : 0;
+                timeoutMs = min(timeoutMs, wait);
+            }
+        }
+        timeoutMs = min<uint64_t>(timeoutMs, (end - now) / 1000000 + 1);
+
+        int n = epoll_wait(epfd, events.data(), events.size(), timeoutMs);
+        now = monotonicNs();
+        for (int i = 0; i < n; i ++)
+        {
+            Connection& c = connections[events[i].data.u32];
+            if (c.fd < 0) continue;
+            uint32_t ev = events[i].events;
+            if (c.connecting)
+            {
+                if (!(ev & (EPOLLOUT | EPOLLERR | EPOLLHUP))) continue;
+                int err = 0;
+                socklen_t errLen = sizeof(err);
+                getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &errLen);
+                if (err || (ev & (EPOLLERR | EPOLLHUP)))
+                {
+                    closeConn(c);
+                    connectFailed(c, now);
+                    continue;
+                }
+                c.connecting = false;
+                fill(c, now);
+                flush(c);
+                continue;
+            }
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) onReadable(c, now);
+            if (c.fd >= 0 && !c.connecting && (ev & EPOLLOUT)) flush(c);
+        }
+
+        for (Connection& c: connections)
+        {
+            if (c.fd < 0)
+            {
+                if (now >= c.retryAt) openConn(c);
+                continue;
+            }
+            if (interval && !c.connecting)
+            {
+                fill(c, now);
+                flush(c);
+            }
+        }
+    }
+
+    // 结束时仍未完成的请求：已发出未响应的，以及限速模式下已到计划时间却没能发出的
+    for (Connection& c: connections)
+    {
+        result.incomplete += c.inflight.size();
+        if (interval && c.nextDue < end) result.incomplete += (end - c.nextDue) / interval;
+        closeConn(c);
+    }
+    ::close(epfd);
+}
+
+// 进程已使用的 CPU 时间（用户态 + 内核态，秒），读取失败返回 -1
+static double processCpuSeconds(int pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[1024];
+    bool ok = fgets(line, sizeof(line), fp) != nullptr;
+    fclose(fp);
+    // 进程名可能包含空格和括号，从最后一个 ')' 之后开始解析：状态为第 3 个字段，utime、stime 为第 14、15 个
+    const char* p = ok ? strrchr(line, ')') : nullptr;
+    unsigned long long utime, stime;
+    if (!p || sscanf(p + 1, " %*c %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %llu %llu", &utime, &stime) != 2) return -1;
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static void sleepUntil(uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+}
+
+static string jsonEscape(const string& s)
+{
+    string res;
+    for (char ch: s)
+    {
+        if (ch == '"' || ch == '\\') res += '\\';
+        if ((unsigned char)ch < 0x20) continue;
+        res += ch;
+    }
+    return res;
+}
+
+static const double PERCENTILES[] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+static const char* PERCENTILE_NAMES[] = {"p50", "p90", "p99", "p99.9", "p99.99"};
+
+static void printLatency(const char* name, const LatencyHistogram& h)
+{
+    printf("  %-10s %9.3f", name, h.mean() / 1e6);
+    for (double p: PERCENTILES) printf(" %9.3f", h.percentile(p) / 1e6);
+    printf(" %9.3f\n", h.getMax() / 1e6);
+}
+
+static void writeLatency(FILE* fp, const char* name, const LatencyHistogram& h)
+{
+    fprintf(fp, "  \"%s\": {\"count\": %llu, \"mean\": %.1f", name, (unsigned long long)h.getCount(), h.mean() / 1e3);
+    for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); i ++)
+    {
+        fprintf(fp, ", \"%s\": %.1f", PERCENTILE_NAMES[i], h.percentile(PERCENTILES[i]) / 1e3);
+    }
+    fprintf(fp, ", \"max\": %.1f}", h.getMax() / 1e3);
+}
+
+static bool writeJson(const Options& opt, const Result& res, const LatencyHistogram& latency, double seconds,
+                      double serverCpu)
+{
+    FILE* fp = fopen(opt.output.c_str(), "w");
+    if (!fp) return false;
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"label\": \"%s\",\n", jsonEscape(opt.label).c_str());
+    fprintf(fp, "  \"timestamp\": %ld,\n", (long)time(nullptr));
+    fprintf(fp, "  \"config\": {\"host\": \"%s\", \"port\": %d, \"scenario\": \"%s\", \"path\": \"%s\", "
+                "\"connections\": %d, \"threads\": %d, \"duration_s\": %d, \"warmup_s\": %d, "
+                "\"rate\": %.1f, \"keep_alive\": %s, \"pipeline\": %d, \"session\": %s},\n",
+            jsonEscape(opt.host).c_str(), opt.port, jsonEscape(opt.scenario).c_str(),
+            jsonEscape(scenarioPath(opt)).c_str(), opt.conns, opt.threads, opt.duration, opt.warmup,
+            opt.rate, opt.keepAlive ? "true" : "false", opt.pipeline, opt.useSession ? "true" : "false");
+    fprintf(fp, "  \"requests\": %llu,\n", (unsigned long long)res.requests);
+    fprintf(fp, "  \"throughput_rps\": %.1f,\n", res.requests / seconds);
+    fprintf(fp, "  \"transfer_bytes_per_s\": %.1f,\n", res.bytes / seconds);
+    fprintf(fp, "  \"non_2xx\": %llu,\n", (unsigned long long)res.non2xx);
+    fprintf(fp, "  \"errors\": {\"connect\": %llu, \"read\": %llu, \"incomplete\": %llu},\n",
+            (unsigned long long)res.connectErrors, (unsigned long long)res.readErrors,
+            (unsigned long long)res.incomplete);
+    fprintf(fp, "  \"coordinated_omission\": \"%s\",\n", opt.rate > 0 ? "scheduled" : "corrected");
+    if (serverCpu >= 0)
+    {
+        fprintf(fp, "  \"server_cpu\": {\"pid\": %d, \"utilization\": %.3f, \"us_per_request\": %.1f},\n",
+                opt.serverPid, serverCpu / seconds, res.requests ? serverCpu * 1e6 / res.requests : 0.0);
+    }
+    // 延迟单位：微秒
+    writeLatency(fp, "latency_us", latency);
+    fprintf(fp, ",\n");
+    writeLatency(fp, "service_time_us", res.service);
+    fprintf(fp, "\n}\n");
+    return fclose(fp) == 0;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-H host] [-p port] [-c connections] [-t threads] [-d seconds] [-w warmup_seconds]\n"
+            "          [-r requests_per_second] [-s small|large|login] [-u path] [-K] [-P depth]\n"
+            "          [-U user:password] [-S] [-o result.json] [-l label] [-C server_pid]\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    int ch;
+    while ((ch = getopt(argc, argv, "H:p:c:t:d:w:r:s:u:KP:U:So:l:C:")) != -1)
+    {
+        switch (ch)
+        {
+        case 'H': opt.host = optarg; break;
+        case 'p': opt.port = atoi(optarg); break;
+        case 'c': opt.conns = atoi(optarg); break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'd': opt.duration = atoi(optarg); break;
+        case 'w': opt.warmup = atoi(optarg); break;
+        case 'r': opt.rate = atof(optarg); break;
+        case 's': opt.scenario = optarg; break;
+        case 'u': opt.path = optarg; break;
+        case 'K': opt.keepAlive = false; break;
+        case 'P': opt.pipeline = atoi(optarg); break;
+        case 'U':
+        {
+            string arg = optarg;
+            size_t colon = arg.find(':');
+            opt.user = arg.substr(0, colon);
+            opt.password = colon == string::npos ? "" : arg.substr(colon + 1);
+            break;
+        }
+        case 'S': opt.useSession = true; break;
+        case 'o': opt.output = optarg; break;
+        case 'l': opt.label = optarg; break;
+        case 'C': opt.serverPid = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (opt.scenario != "small" && opt.scenario != "large" && opt.scenario != "login")
+    {
+        fprintf(stderr, "unknown scenario: %s\n", opt.scenario.c_str());
+        return 1;
+    }
+    if (opt.conns <= 0 || opt.threads <= 0 || opt.duration <= 0 || opt.warmup < 0 || opt.pipeline <= 0 || opt.rate < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    opt.threads = min(opt.threads, opt.conns);
+    if (!opt.keepAlive) opt.pipeline = 1;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1)
+    {
+        addrinfo hints = {}, *info = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(opt.host.c_str(), nullptr, &hints, &info) != 0 || !info)
+        {
+            fprintf(stderr, "cannot resolve %s\n", opt.host.c_str());
+            return 1;
+        }
+        addr.sin_addr = ((sockaddr_in*)info->ai_addr)->sin_addr;
+        freeaddrinfo(info);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // 每个连接的请求间隔：总速率平均分到各连接
+    uint64_t interval = opt.rate > 0 ? (uint64_t)(1e9 * opt.conns / opt.rate) : 0;
+    if (opt.rate > 0 && interval == 0) interval = 1;
+    uint64_t start = monotonicNs();
+    uint64_t measureStart = start + (uint64_t)opt.warmup * 1000000000;
+    uint64_t end = measureStart + (uint64_t)opt.duration * 1000000000;
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    for (int i = 0; i < opt.threads; i ++)
+    {
+        int conns = opt.conns / opt.threads + (i < opt.conns % opt.threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, addr, conns, interval, start, measureStart, end));
+    }
+    for (auto& worker: workers)
+    {
+        threads.emplace_back(&Worker::run, worker.get());
+    }
+    // 服务器在测量期间消耗的 CPU 时间
+    double serverCpu = -1;
+    if (opt.serverPid > 0)
+    {
+        sleepUntil(measureStart);
+        double cpuStart = processCpuSeconds(opt.serverPid);
+        sleepUntil(end);
+        double cpuEnd = processCpuSeconds(opt.serverPid);
+        if (cpuStart >= 0 && cpuEnd >= 0) serverCpu = cpuEnd - cpuStart;
+        else fprintf(stderr, "cannot read cpu time of pid %d\n", opt.serverPid);
+    }
+    Result res;
+    for (size_t i = 0; i < threads.size(); i ++)
+    {
+        threads[i].join();
+        res.merge(workers[i]->getResult());
+    }
+
+    // 限速模式的延迟已经从计划发送时间算起；闭环压测以平均延迟为期望间隔事后修正
+    LatencyHistogram latency = opt.rate > 0 ? res.latency : res.latency.corrected((uint64_t)res.service.mean());
+    double seconds = opt.duration;
+
+    printf("loadgen  %s:%d  %s %s  %d connections, %d threads, %s, pipeline %d\n",
+           opt.host.c_str(), opt.port, opt.scenario == "login" ? "POST" : "GET", scenarioPath(opt).c_str(),
+           opt.conns, opt.threads, opt.keepAlive ? "keep-alive" : "close", opt.pipeline);
+    if (opt.rate > 0) printf("duration %d s (warm-up %d s), rate %.0f req/s\n\n", opt.duration, opt.warmup, opt.rate);
+    else printf("duration %d s (warm-up %d s), closed loop\n\n", opt.duration, opt.warmup);
+    printf("requests   %12llu  %12.1f /s\n", (unsigned long long)res.requests, res.requests / seconds);
+    printf("transfer   %12.1f MB/s\n", res.bytes / seconds / (1 << 20));
+    printf("non-2xx    %12llu\n", (unsigned long long)res.non2xx);
+    printf("errors     connect %llu, read %llu, incomplete %llu\n\n",
+           (unsigned long long)res.connectErrors, (unsigned long long)res.readErrors,
+           (unsigned long long)res.incomplete);
+    if (serverCpu >= 0)
+    {
+        printf("server cpu %11.1f %%  %12.1f us/req\n\n", serverCpu / seconds * 100,
+               res.requests ? serverCpu * 1e6 / res.requests : 0.0);
+    }
+    printf("latency (ms)      mean       p50       p90       p99     p99.9    p99.99       max\n");
+    printLatency(opt.rate > 0 ? "scheduled" : "corrected", latency);
+    printLatency("service", res.service);
+
+    if (!opt.output.empty() && !writeJson(opt, res, latency, seconds, serverCpu))
+    {
+        fprintf(stderr, "cannot write %s\n", opt.output.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+    webserver-top：查看服务器的实时状态
+
+    只读映射服务器的共享内存统计段（/dev/shm/webserver.<端口>），不连接服务器的端口，
+    服务器过载、不再响应请求时仍然可以使用。
+
+    用法：webserver-top [-p 端口] [-i 刷新间隔（毫秒）] [-n 刷新次数] [-b]
+        -b：批处理模式，不清屏，每次输出一组，便于重定向到文件
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <string.h>
+
+#include "../metrics/statsshm.h"
+
+using namespace std;
+
+static uint64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void printBar(double ratio, int width)
+{
+    if (ratio < 0) ratio = 0;
+    if (ratio > 1) ratio = 1;
+    int n = (int)(ratio * width + 0.5);
+    putchar('[');
+    for (int i = 0; i < width; i ++) putchar(i < n ? '#' : ' ');
+    putchar(']');
+}
+
+static void show(const StatsSnapshot& cur, const StatsSnapshot* prev, int port, bool batch)
+{
+    if (!batch) printf("\033[H\033[2J");
+    double age = (monotonicNs() - cur.updateNs) / 1e6;
+    printf("webserver-top  port %d  pid %d  updated %.0f ms ago%s\n\n", port, cur.pid, age,
+           kill(cur.pid, 0) < 0 && errno == ESRCH ? "  (server exited)" :
+           age > cur.intervalMs * 10 ? "  (stale: server not updating)" : "");
+
+    printf("%-18s %12s\n", "connections", to_string(cur.values[STAT_CONNECTIONS]).c_str());
+    printf("%-18s %12s %12s\n", "queue length", to_string(cur.values[STAT_QUEUE_LENGTH]).c_str(),
+           ("sql " + to_string(cur.values[STAT_SQL_QUEUE_LENGTH])).c_str());
+    printf("%-18s %12s\n", "timers", to_string(cur.values[STAT_TIMER_SIZE]).c_str());
+    printf("%-18s %12s\n", "log queue", to_string(cur.values[STAT_LOG_QUEUE]).c_str());
+    printf("%-18s %12s %12s\n", "sql connections", ("free " + to_string(cur.values[STAT_SQL_FREE])).c_str(),
+           ("used " + to_string(cur.values[STAT_SQL_USED])).c_str());
+    printf("%-18s %12s\n", "sessions", to_string(cur.values[STAT_SESSIONS]).c_str());
+
+    // 累计值按两次快照的差计算速率
+    double sec = prev && cur.updateNs > prev->updateNs ? (cur.updateNs - prev->updateNs) / 1e9 : 0;
+    auto rate = [&](STAT_FIELD field) {
+        return sec > 0 ? (cur.values[field] - prev->values[field]) / sec : 0.0;
+    };
+    printf("\n%-18s %12.1f /s  total %llu\n", "accepted", rate(STAT_ACCEPTED),
+           (unsigned long long)cur.values[STAT_ACCEPTED]);
+    printf("%-18s %12.1f /s  total %llu\n", "requests", rate(STAT_REQUESTS),
+           (unsigned long long)cur.values[STAT_REQUESTS]);
+    printf("%-18s %12.1f KB/s\n", "written", rate(STAT_BYTES_WRITTEN) / 1024);
+    printf("%-18s %12.1f /s  total %llu\n", "5xx responses", rate(STAT_RESPONSE_5XX),
+           (unsigned long long)cur.values[STAT_RESPONSE_5XX]);
+
+    printf("\nworker busy\n");
+    int total = cur.workerCnt + cur.sqlWorkerCnt;
+    if (total > StatsShmData::MAX_WORKERS) total = StatsShmData::MAX_WORKERS;
+    for (int i = 0; i < total; i ++)
+    {
+        bool sql = i >= cur.workerCnt;
+        double busy = sec > 0 ? (cur.busyNs[i] - prev->busyNs[i]) / (sec * 1e9) : 0;
+        printf("  %-4s %3d ", sql ? "sql" : "http", sql ? i - cur.workerCnt : i);
+        printBar(busy, 40);
+        printf(" %5.1f%%\n", busy * 100);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    int port = 8081, intervalMs = 1000, count = -1;
+    bool batch = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:i:n:b")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': port = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        case 'n': count = atoi(optarg); break;
+        case 'b': batch = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-i interval_ms] [-n count] [-b]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (intervalMs <= 0) intervalMs = 1000;
+
+    StatsShm shm;
+    string name = StatsShm::nameOf(port);
+    if (!shm.open(name))
+    {
+        fprintf(stderr, "cannot open stats segment %s: is the server running on port %d?\n", name.c_str(), port);
+        return 1;
+    }
+
+    StatsSnapshot snapshots[2];
+    bool hasPrev = false;
+    int cur = 0;
+    for (int i = 0; count < 0 || i < count; i ++)
+    {
+        if (!shm.read(snapshots[cur]))
+        {
+            fprintf(stderr, "stats segment is being rewritten, retrying\n");
+        }
+        else
+        {
+            show(snapshots[cur], hasPrev ? &snapshots[cur ^ 1] : nullptr, port, batch);
+            hasPrev = true;
+            cur ^= 1;
+        }
+        if (count < 0 || i + 1 < count) usleep(intervalMs * 1000);
+    }
+    return 0;
+}
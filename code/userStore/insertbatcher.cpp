@@ -0,0 +1,56 @@
+#include "insertbatcher.h"
+#include "../metrics/alloctrack.h"
+
+using namespace std;
+
+InsertBatcher::InsertBatcher(FlushFunc flush, size_t maxBatch, int maxDelayMs):
+    flush(flush), maxBatch(maxBatch > 0 ? maxBatch : 1), maxDelay(maxDelayMs), leaderActive(false)
+{
+}
+
+int InsertBatcher::insert(const string& name, const string& pwd)
+{
+    ALLOC_SCOPE(ALLOC_USERSTORE);
+    Pending pending;
+    pending.name = name;
+    pending.pwd = pwd;
+    pending.result = -1;
+    pending.done = false;
+
+    unique_lock<mutex> locker(mtx);
+    queue.push_back(&pending);
+    // 唤醒正在收集的领导者（凑够一批可以提前写入）
+    if (queue.size() >= maxBatch) cond.notify_all();
+
+    while (!pending.done)
+    {
+        // 已有领导者，或者自己的请求已被取走（正在写入），等待
+        if (leaderActive || queue.empty())
+        {
+            cond.wait(locker);
+            continue;
+        }
+
+        // 成为领导者，收集一批请求
+        leaderActive = true;
+        cond.wait_for(locker, maxDelay, [this]{ return queue.size() >= maxBatch; });
+
+        size_t n = min(queue.size(), maxBatch);
+        vector<Pending*> batch(queue.begin(), queue.begin() + n);
+        queue.erase(queue.begin(), queue.begin() + n);
+        // 让出领导权，剩余的请求由其他线程继续收集
+        leaderActive = false;
+        cond.notify_all();
+
+        locker.unlock();
+        flush(batch);
+        locker.lock();
+
+        for (Pending* p : batch)
+        {
+            p->done = true;
+        }
+        cond.notify_all();
+    }
+    return pending.result;
+}
@@ -0,0 +1,55 @@
+#ifndef INSERTBATCHER_H
+#define INSERTBATCHER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+using namespace std;
+
+/*
+    注册插入的批处理（组提交）
+
+    注册请求调用 insert 后进入等待队列，队列中没有领导者时，当前线程成为领导者：
+        最多等待 maxDelayMs 毫秒，或者凑够 maxBatch 行，
+        取出一批请求，释放锁后调用 flush 一次写入（一个事务），
+        写完后设置每个请求的结果，唤醒对应的线程。
+    领导者取走一批后立即让出领导权，后来的请求由下一个领导者收集，和正在写入的批次并行。
+
+    不需要额外的线程：写入在领导者（数据库线程）上执行，使用它自己的连接，
+    等待中的线程不持有连接。每个请求最多额外等待 maxDelayMs 毫秒。
+*/
+class InsertBatcher
+{
+public:
+    struct Pending
+    {
+        string name;
+        string pwd;
+        int result; // flush 设置：1 成功，0 用户名已存在，-1 数据库错误
+        bool done;
+    };
+
+    typedef function<void(vector<Pending*>& batch)> FlushFunc;
+
+    InsertBatcher(FlushFunc flush, size_t maxBatch, int maxDelayMs);
+
+    // 插入一行，阻塞到所在批次写入完成，返回该行的结果
+    int insert(const string& name, const string& pwd);
+
+private:
+    FlushFunc flush;
+    size_t maxBatch;                    // 每批最多的行数
+    chrono::milliseconds maxDelay;      // 领导者收集请求的最长时间
+
+    mutex mtx;
+    condition_variable cond;
+    deque<Pending*> queue;              // 等待写入的请求
+    bool leaderActive;                  // 是否有领导者正在收集请求
+};
+
+#endif
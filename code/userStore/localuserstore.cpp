@@ -0,0 +1,184 @@
+#include "localuserstore.h"
+#include "../metrics/alloctrack.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace std;
+
+LocalUserStore::LocalUserStore()
+{
+    fd = -1;
+    syncOnWrite = true;
+    fileLen = 0;
+}
+
+LocalUserStore::~LocalUserStore()
+{
+    close();
+}
+
+bool LocalUserStore::open(const string& fileName, bool syncOnWrite)
+{
+    close();
+    fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR("LocalUserStore: open %s error: %s", fileName.c_str(), strerror(errno));
+        return false;
+    }
+    this->syncOnWrite = syncOnWrite;
+    if (!load())
+    {
+        close();
+        return false;
+    }
+    LOG_INFO("LocalUserStore: %s, %d users", fileName.c_str(), (int)index.size());
+    return true;
+}
+
+void LocalUserStore::close()
+{
+    if (fd < 0) return;
+    ::close(fd);
+    fd = -1;
+    fileLen = 0;
+    lock_guard<shared_timed_mutex> locker(indexMtx);
+    index.clear();
+}
+
+// FNV-1a，只用来发现写到一半的记录
+uint32_t LocalUserStore::checksum(const char* name, size_t nameLen, const char* pwd, size_t pwdLen)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < nameLen; i ++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    for (size_t i = 0; i < pwdLen; i ++)
+    {
+        hash = (hash ^ (unsigned char)pwd[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool LocalUserStore::load()
+{
+    ALLOC_SCOPE(ALLOC_USERSTORE);
+    struct stat st;
+    if (fstat(fd, &st) < 0) return false;
+
+    // 整个文件读入内存，顺序解析
+    vector<char> data(st.st_size);
+    size_t readLen = 0;
+    while (readLen < data.size())
+    {
+        ssize_t n = pread(fd, data.data() + readLen, data.size() - readLen, readLen);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        readLen += n;
+    }
+    if (readLen < data.size())
+    {
+        LOG_ERROR("LocalUserStore: read error: %s", strerror(errno));
+        return false;
+    }
+
+    lock_guard<shared_timed_mutex> locker(indexMtx);
+    index.clear();
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= data.size())
+    {
+        RecordHeader header;
+        memcpy(&header, data.data() + offset, sizeof(header));
+        size_t end = offset + sizeof(header) + header.nameLen + header.pwdLen;
+        if (end > data.size()) break;
+
+        const char* name = data.data() + offset + sizeof(header);
+        const char* pwd = name + header.nameLen;
+        if (checksum(name, header.nameLen, pwd, header.pwdLen) != header.checksum) break;
+
+        index[string(name, header.nameLen)] = string(pwd, header.pwdLen);
+        offset = end;
+    }
+
+    if (offset < data.size())
+    {
+        // 上次写到一半就崩溃了，丢弃不完整的尾部
+        LOG_WARN("LocalUserStore: truncate %d broken bytes", (int)(data.size() - offset));
+        if (ftruncate(fd, offset) < 0) return false;
+    }
+    fileLen = offset;
+    return true;
+}
+
+VERIFY_RESULT LocalUserStore::login(const string& name, const string& pwd)
+{
+    shared_lock<shared_timed_mutex> locker(indexMtx);
+    auto it = index.find(name);
+    if (it != index.end() && it->second == pwd)
+    {
+        LOG_DEBUG("UserVerify success!!");
+        return VERIFY_SUCCESS;
+    }
+    LOG_DEBUG("pwd error!");
+    return VERIFY_FAILED;
+}
+
+VERIFY_RESULT LocalUserStore::registerUser(const string& name, const string& pwd)
+{
+    ALLOC_SCOPE(ALLOC_USERSTORE);
+    if (name.size() > MAX_FIELD_LEN || pwd.size() > MAX_FIELD_LEN) return VERIFY_FAILED;
+
+    lock_guard<mutex> writeLocker(writeMtx);
+    if (fd < 0) return VERIFY_BUSY;
+    // 只有写者修改索引，持有写锁时可以直接查询
+    if (index.count(name))
+    {
+        LOG_DEBUG("user used!");
+        return VERIFY_FAILED;
+    }
+
+    // 记录拼接成一次写入
+    RecordHeader header;
+    header.nameLen = name.size();
+    header.pwdLen = pwd.size();
+    header.checksum = checksum(name.data(), name.size(), pwd.data(), pwd.size());
+    string record(reinterpret_cast<const char*>(&header), sizeof(header));
+    record += name;
+    record += pwd;
+
+    size_t written = 0;
+    while (written < record.size())
+    {
+        ssize_t n = pwrite(fd, record.data() + written, record.size() - written, fileLen + written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += n;
+    }
+    if (written < record.size() || (syncOnWrite && fdatasync(fd) < 0))
+    {
+        LOG_ERROR("LocalUserStore: write error: %s", strerror(errno));
+        // 撤销写了一半的记录；截断失败时下一次注册从 fileLen 覆盖写，或下次启动时由 load 截掉
+        if (ftruncate(fd, fileLen) < 0)
+        {
+            LOG_ERROR("LocalUserStore: truncate to %lld error: %s", (long long)fileLen, strerror(errno));
+        }
+        return VERIFY_BUSY;
+    }
+    fileLen += record.size();
+
+    lock_guard<shared_timed_mutex> locker(indexMtx);
+    index.emplace(name, pwd);
+    LOG_DEBUG("regirster!");
+    return VERIFY_SUCCESS;
+}
+
+size_t LocalUserStore::size()
+{
+    shared_lock<shared_timed_mutex> locker(indexMtx);
+    return index.size();
+}
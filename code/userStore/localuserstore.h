@@ -0,0 +1,64 @@
+#ifndef LOCALUSERSTORE_H
+#define LOCALUSERSTORE_H
+
+#include <string>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "userstore.h"
+#include "../log/log.h"
+
+using namespace std;
+
+/*
+    嵌入式用户存储
+        磁盘：只追加的日志文件，每条注册是一条记录
+              | nameLen(2) | pwdLen(2) | checksum(4) | name | pwd |
+        内存：用户名 -> 密码的哈希索引，启动时顺序扫描日志重建
+
+    并发：登录只读索引，持有读锁，多个线程可以同时查询；
+          注册由写锁串行化（单写者），先追加并落盘，成功后再更新索引，
+          因此索引中的用户一定已经写入磁盘。
+
+    崩溃恢复：写到一半的记录长度不足或校验和不匹配，启动时从这里截断。
+*/
+class LocalUserStore : public UserStore
+{
+public:
+    LocalUserStore();
+    ~LocalUserStore();
+
+    // 打开（或创建）日志文件并重建索引，syncOnWrite：每次注册后 fdatasync
+    bool open(const string& fileName, bool syncOnWrite = true);
+    void close();
+
+    VERIFY_RESULT login(const string& name, const string& pwd) override;
+    VERIFY_RESULT registerUser(const string& name, const string& pwd) override;
+
+    size_t size();
+
+private:
+    struct RecordHeader
+    {
+        uint16_t nameLen;
+        uint16_t pwdLen;
+        uint32_t checksum;
+    };
+
+    static const size_t MAX_FIELD_LEN = 65535;
+
+    bool load();  // 扫描日志重建索引，截断损坏的尾部
+    static uint32_t checksum(const char* name, size_t nameLen, const char* pwd, size_t pwdLen);
+
+    int fd;           // 日志文件
+    bool syncOnWrite; // 注册后是否落盘
+    off_t fileLen;    // 已写入的有效长度（只由写者修改）
+
+    mutex writeMtx;                       // 单写者
+    shared_timed_mutex indexMtx;          // 索引的读写锁
+    unordered_map<string, string> index;  // 用户名 -> 密码
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include "mysqluserstore.h"
+#include "../metrics/alloctrack.h"
+
+#include <strings.h>
+
+using namespace std;
+
+MysqlUserStore::MysqlUserStore(size_t cacheCapacity, int cacheTtlMs, size_t bloomCapacity):
+    userCache(cacheCapacity, cacheTtlMs), userBloom(bloomCapacity), bloomReady(false),
+    maxNameLen(0), maxPwdLen(0)
+{
+}
+
+void MysqlUserStore::init(bool useBloom, int insertBatch, int insertDelayMs)
+{
+    loadColumnLimits();
+    if (useBloom) { warmBloom(); }
+    if (insertBatch > 1)
+    {
+        insertBatcher.reset(new InsertBatcher(
+            [this](vector<InsertBatcher::Pending*>& batch) { flushInserts(batch); },
+            insertBatch, insertDelayMs));
+    }
+}
+
+// 预处理语句编号及 SQL，缓存在每个连接上（见 SqlConn）
+enum USER_STMT
+{
+    STMT_QUERY_USER = 0,
+    STMT_INSERT_USER,
+    STMT_INSERT_BATCH // 多行插入，2、4、8、16、32 行各一条语句，编号依次递增
+};
+
+// 多行插入语句的最大行数（2 的幂），更大的批次拆成多条语句，在同一个事务中执行
+static const int MAX_BATCH_STMT_ROWS = 1 << (SqlConn::MAX_STMTS - STMT_INSERT_BATCH - 1);
+
+static const char* USER_STMT_SQL[] =
+{
+    "SELECT password FROM user WHERE username = ? LIMIT 1",
+    "INSERT INTO user(username, password) VALUES(?, ?)"
+};
+
+// 绑定字符串类型的参数
+static void bindString(MYSQL_BIND& bind, const string& str, unsigned long& len)
+{
+    memset(&bind, 0, sizeof(bind));
+    len = str.size();
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = const_cast<char*>(str.data());
+    bind.buffer_length = len;
+    bind.length = &len;
+}
+
+/*
+    查询用户的密码
+    返回 1：用户存在，0：用户不存在，-1：数据库错误
+*/
+int MysqlUserStore::queryPassword(SqlConn* conn, const string& name, string& pwd)
+{
+    MYSQL_STMT* stmt = conn->stmt(STMT_QUERY_USER, USER_STMT_SQL[STMT_QUERY_USER]);
+    if (!stmt) return -1;
+
+    MYSQL_BIND param[1];
+    unsigned long nameLen;
+    bindString(param[0], name, nameLen);
+
+    // 二进制结果绑定，直接写入本地缓冲区
+    char buffer[128];
+    unsigned long len = 0;
+    my_bool isNull = 0, error = 0;
+    MYSQL_BIND result[1];
+    memset(result, 0, sizeof(result));
+    result[0].buffer_type = MYSQL_TYPE_STRING;
+    result[0].buffer = buffer;
+    result[0].buffer_length = sizeof(buffer);
+    result[0].length = &len;
+    result[0].is_null = &isNull;
+    result[0].error = &error;
+
+    if (mysql_stmt_bind_param(stmt, param) || mysql_stmt_execute(stmt)
+        || mysql_stmt_bind_result(stmt, result) || mysql_stmt_store_result(stmt))
+    {
+        LOG_ERROR("Query user error: %s", mysql_stmt_error(stmt));
+        conn->closeStmt(STMT_QUERY_USER); // 下次重新 prepare
+        return -1;
+    }
+
+    int ret = mysql_stmt_fetch(stmt);
+    int found = 0;
+    if (ret == 0 && !isNull)
+    {
+        pwd.assign(buffer, len);
+        found = 1;
+    }
+    else if (ret == MYSQL_DATA_TRUNCATED && !isNull)
+    {
+        // 密码超过本地缓冲区，len 是实际长度，按实际长度重新读取这一列
+        pwd.assign(len, '\0');
+        MYSQL_BIND column;
+        memset(&column, 0, sizeof(column));
+        column.buffer_type = MYSQL_TYPE_STRING;
+        column.buffer = &pwd[0];
+        column.buffer_length = len;
+        column.length = &len;
+        if (mysql_stmt_fetch_column(stmt, &column, 0, 0))
+        {
+            LOG_ERROR("Query user error: %s", mysql_stmt_error(stmt));
+            mysql_stmt_free_result(stmt);
+            return -1;
+        }
+        found = 1;
+    }
+    mysql_stmt_free_result(stmt);
+    return found;
+}
+
+// 唯一键冲突的错误码（mysqld_error.h 中的 ER_DUP_ENTRY）
+static const unsigned int DUP_ENTRY_ERRNO = 1062;
+
+/*
+    插入新用户
+    返回 1：成功，0：用户名已存在（唯一键冲突），-1：数据库错误
+*/
+int MysqlUserStore::insertUser(SqlConn* conn, const string& name, const string& pwd)
+{
+    MYSQL_STMT* stmt = conn->stmt(STMT_INSERT_USER, USER_STMT_SQL[STMT_INSERT_USER]);
+    if (!stmt) return -1;
+
+    MYSQL_BIND param[2];
+    unsigned long nameLen, pwdLen;
+    bindString(param[0], name, nameLen);
+    bindString(param[1], pwd, pwdLen);
+
+    if (mysql_stmt_bind_param(stmt, param) || mysql_stmt_execute(stmt))
+    {
+        if (mysql_stmt_errno(stmt) == DUP_ENTRY_ERRNO) return 0;
+        LOG_ERROR("Insert user error: %s", mysql_stmt_error(stmt));
+        conn->closeStmt(STMT_INSERT_USER);
+        return -1;
+    }
+    return 1;
+}
+
+// 生成 rows 行的插入语句
+static string batchInsertSql(int rows)
+{
+    string sql = "INSERT INTO user(username, password) VALUES(?, ?)";
+    for (int i = 1; i < rows; i ++)
+    {
+        sql += ",(?, ?)";
+    }
+    return sql;
+}
+
+/*
+    一条语句插入 batch[begin, begin + rows)，rows 为 2 的幂
+    返回值同 insertUser，任意一行重名时整条语句都不生效，返回 0
+*/
+int MysqlUserStore::insertUsers(SqlConn* conn, vector<InsertBatcher::Pending*>& batch, size_t begin, int rows)
+{
+    if (rows == 1) return insertUser(conn, batch[begin]->name, batch[begin]->pwd);
+
+    int id = STMT_INSERT_BATCH;
+    for (int n = 2; n < rows; n <<= 1) id ++;
+    MYSQL_STMT* stmt = conn->stmt(id, batchInsertSql(rows).c_str());
+    if (!stmt) return -1;
+
+    vector<MYSQL_BIND> param(rows * 2);
+    vector<unsigned long> lens(rows * 2);
+    for (int i = 0; i < rows; i ++)
+    {
+        bindString(param[i * 2], batch[begin + i]->name, lens[i * 2]);
+        bindString(param[i * 2 + 1], batch[begin + i]->pwd, lens[i * 2 + 1]);
+    }
+
+    if (mysql_stmt_bind_param(stmt, param.data()) || mysql_stmt_execute(stmt))
+    {
+        if (mysql_stmt_errno(stmt) == DUP_ENTRY_ERRNO) return 0;
+        LOG_ERROR("Insert users error: %s", mysql_stmt_error(stmt));
+        conn->closeStmt(id);
+        return -1;
+    }
+    return 1;
+}
+
+/*
+    写入一批注册请求（由 InsertBatcher 的领导者调用）
+    整批在一个事务中提交，数据库只需要一次落盘：
+        按 2 的幂拆成若干条多行插入语句；
+        某条语句有重名时，语句本身回滚，改为逐行插入，得到每一行的结果；
+        出错时整个事务回滚，这一批都返回错误。
+*/
+void MysqlUserStore::flushInserts(vector<InsertBatcher::Pending*>& batch)
+{
+    SqlConn* conn;
+    SqlConnect connect(&conn, SQL_WRITE);
+    if (!conn || !conn->get()) return; // 结果保持 -1
+
+    MYSQL* sql = conn->get();
+    if (batch.size() == 1)
+    {
+        batch[0]->result = insertUser(conn, batch[0]->name, batch[0]->pwd);
+        return;
+    }
+    if (mysql_autocommit(sql, 0))
+    {
+        LOG_ERROR("Insert batch error: %s", mysql_error(sql));
+        return;
+    }
+
+    bool ok = true;
+    size_t begin = 0;
+    while (ok && begin < batch.size())
+    {
+        int rows = 1;
+        while (rows * 2 <= MAX_BATCH_STMT_ROWS && begin + rows * 2 <= batch.size()) rows <<= 1;
+
+        int ret = insertUsers(conn, batch, begin, rows);
+        if (ret == 0 && rows > 1)
+        {
+            // 有重名，逐行插入
+            for (int i = 0; ok && i < rows; i ++)
+            {
+                InsertBatcher::Pending* p = batch[begin + i];
+                p->result = insertUser(conn, p->name, p->pwd);
+                ok = p->result >= 0;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < rows; i ++) batch[begin + i]->result = ret;
+            ok = ret >= 0;
+        }
+        begin += rows;
+    }
+
+    if (!ok || mysql_commit(sql))
+    {
+        LOG_ERROR("Insert batch of %d rolled back: %s", (int)batch.size(), mysql_error(sql));
+        mysql_rollback(sql);
+        for (InsertBatcher::Pending* p : batch) p->result = -1;
+    }
+    mysql_autocommit(sql, 1);
+    LOG_DEBUG("Insert batch of %d", (int)batch.size());
+}
+
+/*
+    读取 user 表 username、password 列的长度，注册时拒绝超长的用户名和密码
+    （否则严格模式下插入出错，非严格模式下被截断，注册成功后再也无法登录）。
+    列长度按字符计，这里按字节比较，多字节字符的上限偏保守；读取失败时不检查长度。
+*/
+void MysqlUserStore::loadColumnLimits()
+{
+    SqlConn* conn;
+    SqlConnect connect(&conn, SQL_WRITE);
+    MYSQL_RES* res = nullptr;
+    if (!conn || !conn->get() || mysql_query(conn->get(),
+            "SELECT COLUMN_NAME, CHARACTER_MAXIMUM_LENGTH FROM information_schema.COLUMNS "
+            "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'user'")
+        || !(res = mysql_store_result(conn->get())))
+    {
+        LOG_WARN("UserStore: column lengths unknown, register does not check lengths");
+        return;
+    }
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)))
+    {
+        if (!row[0] || !row[1]) continue;
+        if (strcasecmp(row[0], "username") == 0) maxNameLen = strtoul(row[1], nullptr, 10);
+        else if (strcasecmp(row[0], "password") == 0) maxPwdLen = strtoul(row[1], nullptr, 10);
+    }
+    mysql_free_result(res);
+    LOG_INFO("UserStore: username up to %d, password up to %d characters", (int)maxNameLen, (int)maxPwdLen);
+}
+
+// 读取所有用户名，预热布隆过滤器；失败时不使用过滤器
+void MysqlUserStore::warmBloom()
+{
+    ALLOC_SCOPE(ALLOC_USERSTORE);
+    SqlConn* conn;
+    SqlConnect connect(&conn, SQL_WRITE);
+    MYSQL_RES* res = nullptr;
+    if (!conn || !conn->get() || mysql_query(conn->get(), "SELECT username FROM user")
+        || !(res = mysql_use_result(conn->get())))
+    {
+        LOG_WARN("UserBloom: warm up failed, register always queries first");
+        return;
+    }
+    // 逐行读取，不把整张表缓存到客户端
+    size_t cnt = 0;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)))
+    {
+        unsigned long* lengths = mysql_fetch_lengths(res);
+        if (!row[0] || !lengths) continue;
+        userBloom.add(string(row[0], lengths[0]));
+        cnt ++;
+    }
+    bool ok = mysql_errno(conn->get()) == 0;
+    mysql_free_result(res);
+    if (!ok)
+    {
+        LOG_WARN("UserBloom: warm up interrupted, register always queries first");
+        return;
+    }
+    bloomReady = true;
+    LOG_INFO("UserBloom: %d users, %d bits, %d hashes",
+             (int)cnt, (int)userBloom.bitSize(), userBloom.hashSize());
+}
+
+VERIFY_RESULT MysqlUserStore::login(const string &name, const string &pwd)
+{
+    ALLOC_SCOPE(ALLOC_USERSTORE);
+    // 登录先查缓存，命中时不需要从连接池取连接
+    string password;
+    if (userCache.get(name, password))
+    {
+        LOG_DEBUG("UserCache hit!");
+        return pwd == password ? VERIFY_SUCCESS : VERIFY_FAILED;
+    }
+
+    // 登录只读，可以发往副本；副本执行出错时摘除，换一个库重试一次
+    int found = -1;
+    for (int attempt = 0; attempt < 2 && found < 0; attempt ++)
+    {
+        SqlConn* conn;
+        // RAII机制，析构时归还连接；等待超时说明连接池繁忙
+        SqlConnect connect(&conn, SQL_READ);
+        if (!conn || !conn->get()) { return VERIFY_BUSY; }
+
+        found = queryPassword(conn, name, password);
+        if (found < 0) { connect.reportError(); }
+    }
+    if (found < 0) { return VERIFY_BUSY; }
+
+    if (found) { userCache.put(name, password); }
+    if (found && pwd == password) 
+    {
+        LOG_DEBUG("UserVerify success!!");
+        return VERIFY_SUCCESS;
+    }
+    LOG_DEBUG("pwd error!");
+    return VERIFY_FAILED;
+}
+
+// 注册：查询和插入都在主库上执行，避免副本延迟导致重复注册
+VERIFY_RESULT MysqlUserStore::registerUser(const string &name, const string &pwd)
+{
+    ALLOC_SCOPE(ALLOC_USERSTORE);
+    // 超过列长度的用户名、密码无法完整保存
+    if ((maxNameLen > 0 && name.size() > maxNameLen) || (maxPwdLen > 0 && pwd.size() > maxPwdLen))
+    {
+        LOG_DEBUG("Register: username or password too long");
+        return VERIFY_FAILED;
+    }
+    // 布隆过滤器判断用户名一定不存在时，跳过查询，由唯一键保证插入不会重复
+    bool query = !bloomReady || userBloom.mayContain(name);
+    int ret = -1;
+    // 过滤器排除且合并插入时不需要连接（由批次的提交者取用），不占用主库连接
+    if (query || !insertBatcher)
+    {
+        SqlConn* conn;
+        SqlConnect connect(&conn, SQL_WRITE);
+        if (!conn || !conn->get()) { return VERIFY_BUSY; }
+
+        if (query)
+        {
+            // 查找用户是否存在
+            string password;
+            int found = queryPassword(conn, name, password);
+            if (found < 0) { return VERIFY_BUSY; }
+            if (found) 
+            {
+                LOG_DEBUG("user used!");
+                return VERIFY_FAILED;
+            }
+        }
+
+        /* 用户名未被使用，继续注册 */
+        LOG_DEBUG("regirster!");
+        // 批量插入时先归还连接，再等待所在批次写入
+        if (!insertBatcher) { ret = insertUser(conn, name, pwd); }
+    }
+    if (insertBatcher) { ret = insertBatcher->insert(name, pwd); }
+    // 数据库出错与查询出错一样按繁忙处理，不是用户名已被使用
+    if (ret < 0)
+    {
+        LOG_DEBUG("Insert error!");
+        return VERIFY_BUSY;
+    }
+    if (ret == 0)
+    {
+        LOG_DEBUG("user used!");
+        // 其他进程注册的用户名不在过滤器中，补上
+        userBloom.add(name);
+        return VERIFY_FAILED;
+    }
+    userBloom.add(name);
+    // 注册成功，缓存中该用户名的旧记录失效
+    userCache.erase(name);
+    return VERIFY_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#ifndef MYSQLUSERSTORE_H
+#define MYSQLUSERSTORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mysql/mysql.h>
+
+#include "userstore.h"
+#include "insertbatcher.h"
+#include "../cache/lrucache.h"
+#include "../cache/bloomfilter.h"
+#include "../log/log.h"
+#include "../sqlConnPool/sqlconnpool.h"
+#include "../sqlConnPool/sqlrouter.h"
+
+using namespace std;
+
+/*
+    MySQL 用户存储
+        登录：先查本地缓存，未命中时通过 SqlRouter 发往只读副本，副本出错时换一个库重试；
+        注册：查询和插入都在主库上执行。
+              启动时从主库读取全部用户名预热布隆过滤器，过滤器判断一定不存在的用户名跳过查询，
+              直接插入，依靠 username 上的唯一键发现并发注册或其他进程注册的重名。
+              插入可以由 InsertBatcher 合并，几毫秒内的注册用一个事务写入。
+              超过表中列长度的用户名、密码在注册时拒绝，登录时按密码的实际长度读取。
+    连接池由 WebServer 初始化，这里只取用连接。
+*/
+class MysqlUserStore : public UserStore
+{
+public:
+    // 缓存的最大用户数及有效期（毫秒），布隆过滤器的预期用户数
+    MysqlUserStore(size_t cacheCapacity = 65536, int cacheTtlMs = 5 * 60 * 1000,
+                   size_t bloomCapacity = 1 << 20);
+    ~MysqlUserStore() = default;
+
+    // 连接池初始化之后调用，useBloom：预热布隆过滤器（要求 username 上有唯一键）
+    // insertBatch：每批最多插入的行数，不大于 1 时不合并；insertDelayMs：收集一批的最长时间
+    void init(bool useBloom, int insertBatch = 0, int insertDelayMs = 0);
+
+    VERIFY_RESULT login(const string& name, const string& pwd) override;
+    VERIFY_RESULT registerUser(const string& name, const string& pwd) override;
+
+private:
+    static int queryPassword(SqlConn* conn, const string& name, string& pwd);
+    static int insertUser(SqlConn* conn, const string& name, const string& pwd);
+    static int insertUsers(SqlConn* conn, vector<InsertBatcher::Pending*>& batch, size_t begin, int rows);
+    void flushInserts(vector<InsertBatcher::Pending*>& batch);
+    void warmBloom();
+    void loadColumnLimits();
+
+    LruCache<string, string> userCache; // 用户名 -> 密码，登录时先查缓存
+    BloomFilter userBloom;              // 已存在的用户名，注册时判断是否需要查询
+    bool bloomReady;                    // 预热成功后才使用过滤器（只在 init 中修改）
+    unique_ptr<InsertBatcher> insertBatcher; // 为空时每个注册单独插入
+    size_t maxNameLen;                  // user 表用户名、密码列的长度，0 表示未知，不检查（只在 init 中修改）
+    size_t maxPwdLen;
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+    用户存储接口
+
+    登录、注册只依赖这个接口，后端在启动时由配置选择：
+        MysqlUserStore：用户表保存在 MySQL（主库 + 只读副本），登录结果缓存在本地 LRU；
+        LocalUserStore：嵌入式存储，磁盘上一个只追加的日志文件，内存中一张哈希索引，
+                        不需要网络往返，适合只用到登录、注册功能的部署。
+
+    接口在数据库线程中调用，实现需要保证线程安全。
+*/
+#ifndef USERSTORE_H
+#define USERSTORE_H
+
+#include <string>
+
+// 用户验证的结果
+enum VERIFY_RESULT
+{
+    VERIFY_SUCCESS = 0, // 登录或注册成功
+    VERIFY_FAILED,      // 密码错误、用户名已被使用等
+    VERIFY_BUSY         // 存储繁忙或不可用
+};
+
+// 用户存储的后端
+enum USER_STORE_TYPE
+{
+    USER_STORE_MYSQL = 0,
+    USER_STORE_LOCAL
+};
+
+class UserStore
+{
+public:
+    virtual ~UserStore() = default;
+
+    // 验证用户名和密码
+    virtual VERIFY_RESULT login(const std::string& name, const std::string& pwd) = 0;
+
+    // 注册新用户，用户名已被使用时返回 VERIFY_FAILED
+    virtual VERIFY_RESULT registerUser(const std::string& name, const std::string& pwd) = 0;
+};
+
+#endif